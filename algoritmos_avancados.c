@@ -6,69 +6,968 @@
  - Exploração interativa: e (esquerda), d (direita), s (sair)
  - Ao final: listar pistas coletadas e pedir acusação
  - Verifica se ao menos 2 pistas apontam para o acusado
+ - Índice invertido palavra -> pistas (busca textual para editores de caso)
+ - Índice reverso suspeito -> pistas/salas, mantido junto com a tabela hash
+ - Filtro de Bloom em blocos na frente da tabela (consultas negativas rápidas)
+ - Esboços count-min de popularidade de salas e pistas entre sessões
+ - Mapa de calor exato do caso carregado (contadores por thread + mesclagem)
+ - Exportação colunar das sessões concluídas e varredura analítica
+ - Consultas com filtros e agrupamento sobre as sessões arquivadas
+ - Réplicas somente leitura da tabela hash por nó NUMA
+ - Tabela hash compacta: entradas densas em ordem de inserção + índice de slots 8/16/32 bits
+ - Textos curtos embutidos (nomes e pistas), longos numa arena, com hash guardado
+ - Crescimento do índice com migração incremental
+ - Remoção de pistas: BST de pistas balanceada (AVL) e remoção direta nas listas da tabela
+ - Pools de salas e pistas em regiões de 2 MB, opcionalmente em páginas grandes
+ - Modo pré-fork: o mapa e a tabela são montados uma vez e compartilhados (copy-on-write)
+ - Compressão LZ em blocos, própria, para arquivos de sessões e de casos
+ - Diário de eventos da sessão gravado por uma thread própria, em lotes (o jogo não espera o disco)
+ - WAL das pistas coletadas (registros com CRC32, commit em grupo) e recuperação após queda
+ - Arquivo de casos em disco: B+tree (jogador, pista) em páginas de 4 KB com buffer pool (relógio)
+ - Catálogo com muitos casos: carga sob demanda, cache LRU com limite de memória e contagem de referências
+ - Índice global pista/suspeito -> (caso, sala) sobre o catálogo, com ocorrências em varints delta
+ - Busca de pistas tolerante a erros de digitação: trigramas + distância de edição (Myers)
+ - Fatos dos casos (exoneração, álibi, "um destes") e dedução de quem ainda pode ser culpado
+ - Grafo bipartido suspeito–pista em CSR: graus, componentes e pistas identificadoras, em paralelo
+ - Tabela de distâncias (16 bits) de cada sala à pista mais próxima de cada suspeito: dica em uma leitura
+ - Rotas alternativas entre salas (k menores caminhos, Yen) no mapa com passagens além de e/d
+
+ Compilação: gcc -O2 -pthread algoritmos_avancados.c -o detective
+
+ Uso:
+   ./detective                    jogo interativo
+   ./detective --buscar "termos"      lista as pistas que contêm todas as palavras
+   ./detective --evidencias "nome"    lista as pistas e salas que apontam para o suspeito
+   ./detective --estatisticas arq     joga e acumula visitas/coletas no arquivo de esboços
+   ./detective --populares arq        salas e pistas mais frequentes no arquivo
+   ./detective --mapa-calor arq.csv   joga e exporta contagens exatas de visitas/coletas
+   ./detective --exportar-sessao arq  joga e acrescenta a sessão ao arquivo colunar
+   ./detective --diario arq           joga e registra cada movimento e o veredicto no diário
+   ./detective --wal arq              joga com as pistas coletadas no WAL (recupera a sessão interrompida)
+   ./detective --bench-wal arq T N    T threads gravam N pistas cada no WAL com commit em grupo
+   ./detective --arquivo-casos arq [--jogador nome]  joga e arquiva as pistas coletadas pelo jogador
+   ./detective --historico arq [jogador]  pistas arquivadas (por jogador, em ordem alfabética)
+   ./detective [modo] --catalogo arq --caso nome  usa um caso do catálogo no lugar da mansão fixa
+   ./detective --casos arq            lista os casos do catálogo
+   ./detective --bench-catalogo arq S limiteKb  S sessões em 4 threads sobre o cache de casos
+   ./detective --indexar-catalogo arq indice  monta o índice global de pistas e suspeitos do catálogo
+   ./detective --onde-aparece indice "texto"  casos (e salas) onde a pista ou o suspeito aparece
+   ./detective --dica "pista" [k]     pistas a até k edições do texto digitado e seus suspeitos
+   ./detective --bench-dica N         N pistas sintéticas: busca por trigramas x varredura completa
+   ./detective --deduzir "p1;p2"      suspeitos possíveis e certos com os fatos dessas pistas (use com --catalogo)
+   ./detective --bench-deducao N      caso sintético com N suspeitos: tempo de cada dedução
+   ./detective --grafo                graus, componentes e pistas identificadoras do caso (use com --catalogo)
+   ./detective --bench-grafo N [T]    grafo sintético com N pistas, analisado com 1 e com T threads
+   ./detective --proximas "sala"      distância da sala à pista mais próxima de cada suspeito
+   ./detective --bench-proximas N     mapa sintético de N salas: tabela de distâncias x busca por consulta
+   ./detective --rotas origem destino [k] [--evitar sala]... [--via-pista]
+                                      as k melhores rotas (opcionalmente passando por uma sala com pista)
+   ./detective --bench-rotas N [k]    mapa sintético de N salas: Yen com estado reaproveitado x completo
+   ./detective --replicar-numa        copia a tabela pista -> suspeito para cada nó NUMA
+   ./detective [modo] --retirar "pista"  retira a pista do caso antes (pode repetir)
+   ./detective --analisar-sessoes arq resumo de acusações, veredictos e visitas gravados
+   ./detective --consultar arq [--coletou p] [--contra s] [--acusou s] [--visitou sala]
+               [--veredicto culpado|insuficiente|sem] [--agrupar suspeito|sala]
+   ./detective --mesclar-estatisticas destino origem...  soma esboços de outros processos
+   ./detective --paginas-grandes      salas e pistas em páginas de 2 MB (se o sistema tiver)
+   ./detective --bench-paginas N      percorre árvores de N salas/pistas com e sem páginas grandes
+   ./detective --prefork N roteiros   N processos jogam as sessões do arquivo ("ed;Carlos" por linha)
+   ./detective --comprimir origem destino    comprime um arquivo (formato DQZ1) e mede a velocidade
+   ./detective --descomprimir origem destino
+   ./detective --autoteste            confere tabela hash, arquivo de sessões e DQZ1 (sai com 1 se algo falhar)
 */
 
+#define _GNU_SOURCE   /* clock_gettime e demais chamadas POSIX usadas pelas ferramentas */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #define MAX_NOME 64
 #define MAX_PISTA 128
-#define HASH_SIZE 101  /* primo razoável para tabela pequena */
+#define TEXTO_CURTO 16         /* textos de até 15 bytes ficam dentro do próprio Texto */
+#define ARENA_BLOCO 4096       /* bytes por bloco das arenas de texto */
+#define REGIAO_POOL (2u << 20) /* bytes por região dos pools de nós: uma página grande */
+#define CABECALHO_REGIAO 64    /* início da região reservado ao cabeçalho (uma linha de cache) */
+#define INDICE_INICIAL 16      /* slots iniciais do índice da tabela (potência de 2) */
+#define REHASH_PASSOS 4        /* entradas levadas ao índice novo a cada inserção/remoção */
+#define SEGMENTO_BITS 10       /* entradas da tabela alocadas em segmentos de 1 << SEGMENTO_BITS */
+#define SEGMENTO_ENTRADAS (1u << SEGMENTO_BITS)
+#define MAX_TERMO 32
+#define MAX_TERMOS_CONSULTA 8
+#define MAX_SUGESTOES 5            /* pistas sugeridas por --dica */
+#define TRIGRAMAS_PENDENTES 64     /* pistas fora das postagens toleradas antes de reconstruir */
+#define BLOOM_K 6                  /* bits por chave no filtro de Bloom */
+#define BLOOM_CHAVES_POR_BLOCO 48  /* ~10 bits por chave em blocos de 512 bits */
+#define CMS_PROFUNDIDADE 4         /* linhas do esboço count-min */
+#define CMS_LARGURA 1024           /* contadores por linha (potência de 2) */
+#define CMS_MAGICO "DQF1"
+#define MAX_CANDIDATOS 4096        /* nomes avaliados em listarMaisFrequentes */
+#define LINHA_CACHE 64
+#define MAX_SHARDS 64              /* fragmentos próprios no mapa de calor; threads além disso dividem um comum */
+#define SESSOES_MAGICO "DQS2"
+#define SESSOES_MAGICO_V1 "DQS1"   /* formato antigo, sem lotes: ainda lido (inteiro) */
+#define SESSOES_POR_LOTE 65536     /* sessões por lote do arquivo: a unidade de leitura das consultas */
+#define COLUNA_ACUSADO 1
+#define COLUNA_VEREDICTO 2
+#define COLUNA_PISTAS 4
+#define COLUNA_CAMINHO 8
+#define COLUNAS_TODAS 15
+#define LZ_MAGICO "DQZ1"
+#define DIARIO_LOTE 65536          /* capacidade inicial de cada buffer do diário */
+#define WAL_CABECALHO 8            /* tamanho (4 bytes) + CRC32 (4 bytes) de cada registro */
+#define WAL_PISTA 1                /* tipo de registro: pista coletada */
+#define PAGINA_ARQUIVO 4096        /* nó da B+tree do arquivo de casos */
+#define ARQUIVO_MAGICO "DQB1"
+#define QUADROS_ARQUIVO 64         /* páginas mantidas em memória pelo buffer pool */
+#define MAX_NIVEIS_ARQUIVO 32      /* altura máxima aceita: mais que isso é ciclo num arquivo corrompido */
+#define MAX_CHAVE_ARQUIVO (MAX_NOME + MAX_PISTA)  /* jogador, '\0', pista */
+#define MAX_CAMPOS_CATALOGO 6      /* campos de uma linha do catálogo ("tipo|...") */
+#define THREADS_CATALOGO 4
+#define INDICE_GLOBAL_MAGICO "DQI1"
+#define TERMO_PISTA 0
+#define TERMO_SUSPEITO 1
+#define MAX_SUSPEITOS_DEDUCAO 512  /* suspeitos de um caso no motor de dedução */
+#define PALAVRAS_DEDUCAO (MAX_SUSPEITOS_DEDUCAO / 64)
+#define BALDES_GRAU 33             /* histograma de graus: 0, 1, 2-3, 4-7, ... */
+#define VERTICES_POR_THREAD 65536  /* fatia mínima dos kernels do grafo antes de abrir outra thread */
+#define DISTANCIA_INFINITA UINT16_MAX        /* nenhuma pista do suspeito alcançável */
+#define DISTANCIA_MAXIMA (UINT16_MAX - 1)    /* teto: distâncias maiores ficam nele */
+#define MAX_ROTAS 16                /* rotas por consulta de --rotas */
+#define LZ_BLOCO (1u << 20)        /* bytes de entrada por bloco comprimido */
+#define LZ_JANELA 65535            /* distância máxima de uma repetição (2 bytes) */
+#define LZ_MIN_REPETICAO 4
+#define LZ_BITS_HASH 14            /* entradas da tabela de candidatos: 2^14 */
+#define LZ_FIM_LITERAIS 5          /* últimos bytes do bloco são sempre literais */
+#define LZ_MARGEM_REPETICAO 12     /* nenhuma repetição começa tão perto do fim */
+
+/* Resultado da fase de julgamento */
+#define VEREDICTO_INSUFICIENTE 0
+#define VEREDICTO_CULPADO 1
+#define VEREDICTO_SEM_ACUSACAO 2
+
+/* Tipos de fato de um caso */
+#define FATO_EXONERA 0              /* o suspeito é inocente */
+#define FATO_ALIBI 1                /* o suspeito é inocente se a testemunha for */
+#define FATO_UM_DE 2                /* o culpado está no conjunto */
+
+/* Agrupamento do resultado de uma consulta */
+#define AGRUPAR_NADA 0
+#define AGRUPAR_SUSPEITO 1          /* por suspeito acusado */
+#define AGRUPAR_SALA 2              /* por sala visitada */
+#define SESSOES_POR_THREAD 65536    /* fatia mínima antes de abrir outra thread */
+#define MAX_THREADS_CONSULTA 16
+#define MAX_NOS_NUMA 64
 
 /* ---------------------------
    Estruturas
    --------------------------- */
 
+/* Texto imutável de 24 bytes: até TEXTO_CURTO-1 bytes ficam embutidos, os
+   maiores apontam para uma arena. Tamanho e hash são calculados uma única vez. */
+typedef struct texto {
+    union {
+        char curto[TEXTO_CURTO];
+        const char *longo;
+    } u;
+    uint32_t tam;
+    uint32_t hash;             /* (uint32_t) hash_string(texto) */
+} Texto;
+
+/* Blocos encadeados onde vão os textos longos; liberados todos de uma vez */
+typedef struct blocoArena {
+    struct blocoArena *prox;
+    size_t usado, cap;
+    char dados[];
+} BlocoArena;
+
+typedef struct arena {
+    BlocoArena *blocos;
+} Arena;
+
+/* De onde veio a memória de uma região do pool */
+enum { PAGINAS_HUGETLB, PAGINAS_THP, PAGINAS_PEQUENAS, PAGINAS_MALLOC, N_ORIGENS_PAGINAS };
+
+/* Cabeçalho no início de cada região de REGIAO_POOL bytes */
+typedef struct regiaoPool {
+    struct regiaoPool *prox;
+    int origem;                /* PAGINAS_* */
+} RegiaoPool;
+
+/* Pool de nós de tamanho fixo em regiões de 2 MB (não é thread-safe).
+   Com paginasGrandes, cada região tenta MAP_HUGETLB, depois madvise(MADV_HUGEPAGE),
+   e por fim páginas comuns: a árvore inteira cabe em poucas entradas de TLB. */
+typedef struct poolNos {
+    size_t tamNo;
+    int paginasGrandes;
+    RegiaoPool *regioes;
+    char *livre;               /* próximo nó nunca usado da região atual */
+    size_t restante;           /* bytes livres a partir de 'livre' */
+    void *devolvidos;          /* lista de nós liberados (o 1º ponteiro do nó encadeia) */
+    int nRegioes[N_ORIGENS_PAGINAS];
+} PoolNos;
+
 /* Nó da árvore binária das salas */
 typedef struct sala {
-    char nome[MAX_NOME];
-    char pista[MAX_PISTA]; /* pista associada à sala (pode ser vazia) */
+    int id;                /* posição em pré-ordem (numerarSalas), -1 antes disso */
+    Texto nome;
+    Texto pista;           /* pista associada à sala (pode ser vazia) */
     struct sala *esquerda;
     struct sala *direita;
 } Sala;
 
-/* Nó da BST que guarda as pistas coletadas */
+/* Nó da BST que guarda as pistas coletadas (balanceada como AVL) */
 typedef struct pistaNode {
-    char pista[MAX_PISTA];
+    Texto pista;
+    int altura;            /* folha = 1 */
     struct pistaNode *esq;
     struct pistaNode *dir;
 } PistaNode;
 
-/* Entrada para tabela hash (encadeamento separado) */
+/* Sala em que uma pista aparece (lista usada pelo índice reverso) */
+typedef struct salaRef {
+    const Sala *sala;
+    struct salaRef *prox;
+} SalaRef;
+
+/* Entrada da tabela hash; fica no vetor denso da tabela, em ordem de inserção.
+   Uma entrada removida vira buraco (idSuspeito == -1) até a próxima migração passar por ela. */
 typedef struct hashEntry {
-    char pista[MAX_PISTA];     /* chave */
-    char suspeito[MAX_NOME];   /* valor */
-    struct hashEntry *prox;
+    Texto pista;               /* chave; pista.hash é o hash usado no índice e no filtro */
+    Texto suspeito;            /* valor */
+    int id;                    /* ordem de inserção na tabela (0, 1, 2, ...) */
+    int idSuspeito;            /* posição do suspeito no índice reverso */
+    int posNoSuspeito;         /* limite superior da posição na lista do suspeito */
+    SalaRef *salas;            /* salas que guardam a pista (vincularSalas) */
 } HashEntry;
 
+/* Suspeito no índice reverso: entradas da tabela que o apontam */
+typedef struct suspeitoIndice {
+    char nome[MAX_NOME];
+    int *pistas;               /* posições no vetor de entradas, em ordem de inserção */
+    int nPistas, capPistas;
+} SuspeitoIndice;
+
+/* Filtro de Bloom em blocos de 64 bytes: cada chave toca um único bloco,
+   então uma consulta negativa custa uma linha de cache. Cresce junto com a
+   tabela: o filtro novo é preenchido durante a migração do índice. */
+typedef struct filtroBloom {
+    uint64_t (*blocos)[8];     /* nBlocos blocos de 512 bits, alinhados em 64 */
+    uint32_t nBlocos;          /* potência de 2 */
+    size_t nChaves;
+} FiltroBloom;
+
+/* Índice de endereçamento aberto (sondagem linear): cada slot guarda a posição+1
+   de uma entrada no vetor denso, 0 = livre. A largura do slot acompanha o tamanho. */
+typedef struct indiceSlots {
+    void *slots;
+    size_t nSlots;             /* potência de 2 */
+    int largura;               /* bytes por slot: 1, 2 ou 4 */
+} IndiceSlots;
+
+/* Tabela hash pista -> suspeito com índice reverso suspeito -> pistas.
+   As entradas ficam num vetor denso em ordem de inserção, alocado em segmentos de
+   tamanho fixo (crescer nunca copia as entradas); o índice só guarda posições.
+   Ao crescer, o índice antigo continua válido e as entradas são levadas ao novo
+   aos poucos (REHASH_PASSOS por operação), sem pausa de rehash; a mesma migração
+   fecha os buracos das remoções, empurrando as entradas vivas para a frente. */
+typedef struct tabelaHash {
+    HashEntry **segmentos;     /* vetor denso; [0, nUsadas) inclui os buracos de remoções */
+    size_t nSegmentos, capSegmentos;
+    size_t nEntradas;          /* entradas vivas */
+    size_t nUsadas;
+    IndiceSlots indice;        /* índice atual */
+    IndiceSlots antigo;        /* índice anterior enquanto migra (slots == NULL fora disso) */
+    size_t migradas;           /* entradas [0, migradas) já estão no índice atual */
+    size_t destino;            /* [0, destino) já compactadas; próxima posição livre */
+    size_t limiteMigracao;     /* entradas existentes quando a migração começou */
+    FiltroBloom filtro;        /* rejeita pistas desconhecidas antes de sondar o índice */
+    FiltroBloom filtroNovo;    /* filtro do índice novo, preenchido junto com a migração */
+    SuspeitoIndice *suspeitos; /* id do suspeito = posição no vetor */
+    int nSuspeitos, capSuspeitos;
+    int proximoId;             /* id da próxima pista inserida */
+    Arena textos;              /* pistas e suspeitos longos das entradas */
+    struct tabelaHash **replicas; /* cópias somente leitura, uma por nó NUMA (ou NULL) */
+    int nReplicas;
+    int *noDaCpu;              /* nó NUMA de cada CPU, para rotear as consultas */
+    int nCpus;
+    struct indiceTrigramas *trigramas; /* busca aproximada das pistas: montado na carga e
+                                          mantido nas inserções e remoções (ou NULL) */
+} TabelaHash;
+
+/* Percorre as entradas da tabela em ordem de inserção */
+typedef struct iteradorTabela {
+    const TabelaHash *tabela;
+    size_t pos;
+} IteradorTabela;
+
+/* Termo do índice invertido: ids das pistas que contêm a palavra,
+   em ordem crescente, codificados como delta + varint */
+typedef struct termoIndice {
+    char termo[MAX_TERMO];
+    unsigned char *postagens;
+    size_t tamBytes;
+    int qtd;               /* quantidade de ids na lista */
+} TermoIndice;
+
+/* Índice invertido palavra -> pistas */
+typedef struct indiceInvertido {
+    char **pistas;         /* texto de cada pista; o id é a posição no vetor */
+    int nPistas;
+    TermoIndice *termos;   /* ordenado por termo (busca binária) */
+    int nTermos;
+} IndiceInvertido;
+
+/* Índice de trigramas das pistas normalizadas (minúsculas, espaços simples e um espaço
+   em cada ponta). Postagens em CSR: as pistas com trigramas[i] são
+   ids[inicio[i] .. inicio[i+1]), em ordem crescente. Pistas acrescentadas depois da
+   montagem (ids >= nIndexados) são conferidas uma a uma até a próxima reconstrução;
+   ids esquecidos (pista removida) ficam com texto NULL e a busca os pula. */
+typedef struct indiceTrigramas {
+    char **pistas;              /* texto original; o id é a posição */
+    char **normalizadas;
+    int nPistas, capPistas;
+    int nIndexados;             /* pistas [0, nIndexados) estão nas postagens */
+    uint32_t *trigramas;        /* 3 bytes por trigrama, ordenados */
+    uint32_t *inicio;
+    int *ids;
+    int nTrigramas;
+} IndiceTrigramas;
+
+/* Pista sugerida pela busca aproximada */
+typedef struct sugestaoPista {
+    int id;
+    int distancia;
+} SugestaoPista;
+
+/* Esboço count-min: memória fixa, atualizado sem trava por várias threads.
+   Superestima (nunca subestima) a frequência de uma chave. */
+typedef struct esbocoFrequencia {
+    _Atomic uint32_t cont[CMS_PROFUNDIDADE][CMS_LARGURA];
+    _Atomic uint64_t total;
+} EsbocoFrequencia;
+
+/* Popularidade acumulada de salas e pistas em todas as sessões */
+typedef struct estatisticas {
+    EsbocoFrequencia visitasSalas;
+    EsbocoFrequencia coletasPistas;
+} Estatisticas;
+
+/* Fragmento de contadores de uma thread; cada vetor começa numa linha de cache
+   própria, então threads diferentes nunca disputam a mesma linha */
+typedef struct shardContadores {
+    _Atomic uint64_t *visitas;  /* por id de sala */
+    _Atomic uint64_t *coletas;  /* por id de pista */
+    uint64_t dono;              /* id da thread dona (0 = fragmento comum, incremento atômico) */
+} ShardContadores;
+
+/* Contagem exata de visitas/coletas do caso carregado (mapa de calor) */
+typedef struct mapaCalor {
+    int nSalas, nPistas;
+    ShardContadores shards[MAX_SHARDS];
+    _Atomic int nShards;
+    ShardContadores comum;        /* threads além de MAX_SHARDS dividem este (criado sob 'trava') */
+    _Atomic int temComum;
+    uint64_t geracao;             /* única por mapa: invalida caches de threads de mapas já liberados */
+    uint64_t *visitas, *coletas;  /* último retrato mesclado (protegido por 'trava') */
+    pthread_mutex_t trava;
+    pthread_cond_t sinal;
+    pthread_t mesclador;
+    int ativo;
+    unsigned intervaloMs;
+} MapaCalor;
+
+/* Sessão em andamento: caminho percorrido, pistas (na ordem da coleta) e julgamento */
+typedef struct registroSessao {
+    const char **salas;         /* nomes apontam para as salas do mapa */
+    int nSalas, capSalas;
+    const char **pistas;
+    int nPistas, capPistas;
+    char acusado[MAX_NOME];     /* vazio = sem acusação */
+    int veredicto;              /* VEREDICTO_* */
+} RegistroSessao;
+
+/* Dicionário de uma coluna: o valor gravado é a posição do nome */
+typedef struct dicionario {
+    char **nomes;
+    int n, cap;
+} Dicionario;
+
+/* Sessões concluídas em colunas; as listas por sessão (caminho, pistas)
+   são fatias [inicio[s], inicio[s+1]) de um vetor único */
+typedef struct tabelaSessoes {
+    Dicionario dicSalas, dicPistas, dicSuspeitos;
+    int nSessoes, capSessoes;
+    uint32_t *inicioCaminho;
+    int32_t *caminho;
+    size_t nCaminho;
+    int capCaminho;
+    uint32_t *inicioPistas;
+    int32_t *pistas;
+    size_t nPistas;
+    int capPistas;
+    int32_t *acusado;           /* id em dicSuspeitos, -1 = ninguém */
+    uint8_t *veredicto;
+} TabelaSessoes;
+
+/* Consulta sobre sessões arquivadas (campos NULL / -1 = sem filtro) */
+typedef struct consultaSessoes {
+    const char *coletou;        /* pista coletada na sessão */
+    const char *contra;         /* coletou alguma pista que aponta para este suspeito */
+    const char *acusou;         /* suspeito acusado */
+    const char *visitou;        /* sala visitada */
+    int veredicto;              /* VEREDICTO_* */
+    int agrupar;                /* AGRUPAR_* */
+} ConsultaSessoes;
+
+/* Diário de eventos: o jogo acrescenta linhas no buffer ativo e a thread escritora
+   troca os dois buffers e grava o lote cheio com um write() e um fdatasync() */
+typedef struct diario {
+    int fd;
+    char *lotes[2];
+    size_t usado[2], cap[2];
+    int ativo;                  /* buffer que recebe eventos */
+    pthread_mutex_t trava;
+    pthread_cond_t temEventos;
+    pthread_t escritor;
+    int encerrar, erro;
+    unsigned long long eventos, gravacoes;
+} Diario;
+
+/* Log de escrita antecipada das pistas coletadas. Registros pendentes ficam em memória;
+   quem confirma espera até o lote que contém o seu registro passar pelo fdatasync().
+   Posições (lsn) são deslocamentos em bytes no arquivo. */
+typedef struct wal {
+    int fd;
+    char *pendente;
+    size_t nPendente, capPendente;
+    uint64_t lsnFinal;          /* fim do último registro anexado */
+    uint64_t lsnDuravel;        /* tudo antes disto já está no disco */
+    int gravando;               /* há um líder fazendo write + fdatasync */
+    int erro;
+    pthread_mutex_t trava;
+    pthread_cond_t confirmado;
+    unsigned long long registros, sincronizacoes;
+} Wal;
+
+/* Página em memória do arquivo de casos; 'referencia' é o bit do algoritmo do relógio */
+typedef struct quadro {
+    uint32_t pagina;
+    int fixado;                 /* usuários atuais; quadro fixado não é despejado */
+    uint8_t usado, sujo, referencia;
+    unsigned char *dados;       /* PAGINA_ARQUIVO bytes alinhados à página */
+} Quadro;
+
+/* Arquivo de casos: B+tree com chave (jogador, pista) e valor = partidas em que o
+   jogador coletou a pista. Página 0 é o cabeçalho; as demais são nós. */
+typedef struct arquivoCasos {
+    int fd;
+    uint32_t raiz, nPaginas;
+    Quadro *quadros;
+    int nQuadros, ponteiro;     /* ponteiro = posição do relógio */
+    int erro;
+    int escrita;                /* aberto para gravar (trava exclusiva) ou só para ler */
+    int corrompido;             /* achou página inválida: nada mais é gravado */
+    unsigned long long leituras, escritas, acertos;
+} ArquivoCasos;
+
+/* Posição de uma varredura: folha atual e próxima célula dela */
+typedef struct cursorArquivo {
+    ArquivoCasos *arquivo;
+    uint32_t pagina;
+    int pos;
+    uint32_t folhas;            /* folhas visitadas: passar de nPaginas é ciclo */
+} CursorArquivo;
+
+/* Conjunto de suspeitos (bit i = suspeito de id i na base de fatos) */
+typedef struct conjSuspeitos {
+    uint64_t w[PALAVRAS_DEDUCAO];
+} ConjSuspeitos;
+
+/* Fato que passa a valer quando a pista é coletada (pista vazia = vale desde o início) */
+typedef struct fatoCaso {
+    char pista[MAX_PISTA];
+    int tipo;                   /* FATO_* */
+    int suspeito, testemunha;   /* ids na base; testemunha só no álibi */
+    ConjSuspeitos conjunto;     /* FATO_UM_DE */
+} FatoCaso;
+
+/* Fatos de um caso e os suspeitos que eles citam (mais os da tabela) */
+typedef struct baseFatos {
+    FatoCaso *fatos;
+    int nFatos, capFatos;
+    char (*suspeitos)[MAX_NOME]; /* id do suspeito = posição */
+    int nSuspeitos, capSuspeitos;
+    int maxCulpados;            /* culpados no máximo (padrão 1) */
+} BaseFatos;
+
+/* Resultado de deduzirSuspeitos() */
+typedef struct deducao {
+    int consistente;            /* 0 se os fatos ativos se contradizem */
+    ConjSuspeitos possiveis;    /* culpados em ao menos uma solução */
+    ConjSuspeitos certos;       /* culpados em todas as soluções */
+    unsigned long long nos;     /* nós visitados pela busca */
+} Deducao;
+
+/* Grafo bipartido de evidências em CSR: vértices [0, nSuspeitos) são suspeitos e
+   [nSuspeitos, nVertices) pistas; cada ligação aparece nas listas das duas pontas */
+typedef struct grafoEvidencias {
+    int nSuspeitos, nPistas, nVertices;
+    long long nArestas;         /* ligações distintas */
+    long long *inicio;          /* vizinhos de v: vizinhos[inicio[v] .. inicio[v+1]) */
+    int *vizinhos;
+    const char **nomes;         /* por vértice (NULL no grafo sintético) */
+} GrafoEvidencias;
+
+/* Resultado de analisarGrafo() */
+typedef struct analiseGrafo {
+    long long histSuspeitos[BALDES_GRAU], histPistas[BALDES_GRAU];
+    long long grauMaxSuspeito, grauMaxPista;
+    uint8_t *identifica;        /* por pista: liga a um único suspeito */
+    int *identificadoras;       /* por suspeito: pistas que só apontam para ele */
+    long long nIdentificadoras;
+    atomic_int *rotulo;         /* por vértice: menor vértice do componente */
+    atomic_int *tamanho;        /* por vértice-rótulo: vértices do componente */
+    int nComponentes, maiorComponente, rodadas, nThreads;
+} AnaliseGrafo;
+
+/* Distância (em salas) de cada sala até a pista mais próxima de cada suspeito */
+typedef struct tabelaDistancias {
+    int nSalas, nSuspeitos;     /* suspeitos: posições do índice reverso da tabela */
+    const Sala **salas;         /* por id (numerarSalas) */
+    int (*vizinhos)[3];         /* pai, esquerda e direita de cada sala (-1 = nenhuma) */
+    uint16_t *dist;             /* dist[suspeito * nSalas + sala] */
+} TabelaDistancias;
+
+/* Passagem entre duas salas além das ligações da árvore (mão dupla) */
+typedef struct passagem {
+    const Sala *a, *b;
+    int custo;
+} Passagem;
+
+/* Mapa geral das salas em CSR: arestas de v em [inicio[v], inicio[v+1]) */
+typedef struct mapaSalas {
+    int nSalas, nArestas;       /* arestas dirigidas: cada ligação conta duas vezes */
+    const Sala **salas;         /* por id */
+    uint8_t *temPista;
+    int *inicio, *destino, *custo;
+} MapaSalas;
+
+/* Rota: nós da busca (sala + camada * nSalas) e a aresta que sai de cada um */
+typedef struct rota {
+    int *nos, *arestas;
+    int n, custo;
+    int desvio;                 /* posição do nó de desvio que a gerou */
+} Rota;
+
+/* Estado de buscarRotas(), reaproveitado em todas as buscas de uma consulta e entre
+   consultas: marcas com carimbo em vez de vetores zerados a cada busca, e as
+   distâncias até o destino, calculadas uma vez, guiando cada busca de desvio */
+typedef struct buscaRotas {
+    const MapaSalas *mapa;
+    int *dist, *pai, *arestaPai;
+    int *potencial;             /* distância exata até o destino sem bloqueios (A*) */
+    uint32_t *visto, carimbo;
+    uint32_t *noBloqueado, *arestaBloqueada, bloqueio;
+    long long *heap;
+    int nHeap, capHeap;
+    const uint8_t *evitar;
+    int exigirPista, completo;
+    unsigned long long nBuscas, nosFechados;
+} BuscaRotas;
+
+/* Caso do catálogo. Descarregado, guarda só o nome e o trecho do arquivo com a
+   descrição; carregado, tem mapa, tabela e arena próprios. */
+typedef struct caso {
+    char nome[MAX_NOME];
+    long inicio, fim;           /* bytes [inicio, fim) do arquivo do catálogo */
+    int carregado, invalido;    /* invalido: a descrição já falhou uma vez */
+    Sala *raiz;
+    int nSalas;
+    TabelaHash tabela;
+    Arena textos;               /* textos longos das salas deste caso */
+    BaseFatos fatos;
+    Passagem *passagens;
+    int nPassagens, capPassagens;
+    size_t bytes;               /* memória estimada enquanto carregado */
+    int referencias;            /* sessões usando o caso */
+    struct caso *anterior, *proximo;  /* fila LRU dos carregados sem referências */
+} Caso;
+
+/* Catálogo: casos ordenados por nome e um cache dos carregados limitado em bytes.
+   Só casos sem referências entram na fila LRU e podem ser descarregados. */
+typedef struct catalogo {
+    FILE *arquivo;
+    Caso *casos;
+    int nCasos;
+    Caso lru;                   /* sentinela: proximo = mais recente, anterior = mais antigo */
+    size_t limiteBytes, bytesCarregados, picoBytes;
+    pthread_mutex_t trava;
+    unsigned long long acertos, carregamentos, descartes;
+} Catalogo;
+
+/* Termo do índice global com suas ocorrências (caso, sala) codificadas em varints:
+   delta do caso e, em seguida, a sala (delta da anterior quando o caso se repete) */
+typedef struct termoGlobal {
+    int tipo;                   /* TERMO_PISTA ou TERMO_SUSPEITO */
+    const char *texto;
+    uint32_t nOcorrencias;
+    const unsigned char *ocorrencias;
+    size_t nBytes;
+} TermoGlobal;
+
+/* Índice global carregado: termos ordenados por (tipo, texto) para busca binária */
+typedef struct indiceGlobal {
+    unsigned char *dados;       /* arquivo descomprimido; as ocorrências apontam para cá */
+    char **casos;               /* nome de cada caso, pela posição no catálogo */
+    int nCasos;
+    TermoGlobal *termos;
+    int nTermos;
+    Arena textos;
+} IndiceGlobal;
+
+/* Estado opcional que acompanha uma sessão de exploração (campos podem ser NULL) */
+typedef struct contextoSessao {
+    TabelaHash *tabela;         /* resolve o id das pistas coletadas */
+    Estatisticas *estatisticas;
+    MapaCalor *mapaCalor;
+    RegistroSessao *registro;
+    Diario *diario;
+    Wal *wal;                   /* pistas coletadas ficam duráveis antes de seguir */
+    const BaseFatos *fatos;     /* dedução a cada pista e no veredicto */
+    const TabelaDistancias *distancias; /* opção (p) do menu */
+} ContextoSessao;
+
 /* ---------------------------
    Protótipos (documentados)
    --------------------------- */
 
+/* criarTexto() – copia s (até max-1 bytes) para um Texto; textos longos vão para a arena. */
+Texto criarTexto(Arena *a, const char *s, size_t max);
+
+/* textoStr() – conteúdo do Texto, terminado em '\0'. */
+static inline const char* textoStr(const Texto *t) {
+    return t->tam < TEXTO_CURTO ? t->u.curto : t->u.longo;
+}
+
+/* liberarArena() – devolve todos os blocos da arena. */
+void liberarArena(Arena *a);
+
 /* criarSala() – cria dinamicamente um cômodo. */
 Sala* criarSala(const char *nome, const char *pista);
 
+/* criarSalaNaArena() – como criarSala(), com os textos longos na arena dada. */
+Sala* criarSalaNaArena(Arena *a, const char *nome, const char *pista);
+
+/* liberarSalas() – devolve ao pool todas as salas do mapa. */
+void liberarSalas(Sala *raiz);
+
+/* usarPaginasGrandes() – salas e pistas criadas daqui em diante vêm de páginas de 2 MB. */
+void usarPaginasGrandes(int ativar);
+
+/* executarBenchPaginas() – mede percursos em árvores de n salas e n pistas, com e sem páginas grandes. */
+void executarBenchPaginas(long n);
+
+/* executarRoteiro() – sessão sem terminal: segue os movimentos (e/d) e acusa; retorna VEREDICTO_*. */
+int executarRoteiro(const Sala *raiz, TabelaHash *tabela, const char *movimentos, const char *acusado);
+
+/* executarPrefork() – distribui as sessões do arquivo de roteiros entre nProcessos filhos. */
+int executarPrefork(const Sala *raiz, TabelaHash *tabela, int nProcessos, const char *arquivo);
+
 /* explorarSalas() – navega pela árvore e ativa o sistema de pistas. */
-void explorarSalas(Sala *raiz, PistaNode **raizPistas);
+void explorarSalas(Sala *raiz, PistaNode **raizPistas, ContextoSessao *ctx);
 
 /* inserirPista() / adicionarPista() – insere a pista coletada na árvore de pistas. */
-PistaNode* inserirPista(PistaNode *raiz, const char *pista);
+PistaNode* inserirPista(PistaNode *raiz, const Texto *pista);
+
+/* removerPista() – retira uma pista da árvore de pistas coletadas, mantendo o balanceamento. */
+PistaNode* removerPista(PistaNode *raiz, const char *pista);
+
+/* inicializarTabelaHash() – prepara uma tabela vazia. */
+void inicializarTabelaHash(TabelaHash *tabela);
 
 /* inserirNaHash() – insere associação pista/suspeito na tabela hash. */
-void inserirNaHash(HashEntry *tabela[], const char *pista, const char *suspeito);
+void inserirNaHash(TabelaHash *tabela, const char *pista, const char *suspeito);
+
+/* removerDaHash() – remove a associação de uma pista; retorna 1 se existia. */
+int removerDaHash(TabelaHash *tabela, const char *pista);
+
+/* retirarPista() – moderação: tira a pista da tabela, das salas e das pistas já coletadas. */
+int retirarPista(TabelaHash *tabela, Sala *raizSalas, PistaNode **raizPistas, const char *pista);
 
 /* encontrarSuspeito() – consulta o suspeito correspondente a uma pista. */
-const char* encontrarSuspeito(HashEntry *tabela[], const char *pista);
+const char* encontrarSuspeito(TabelaHash *tabela, const char *pista);
+
+/* buscarEntrada() – entrada da tabela para uma pista (ou NULL); vale até a próxima alteração. */
+HashEntry* buscarEntrada(TabelaHash *tabela, const char *pista);
+
+/* buscarEntradaTexto() – como buscarEntrada(), usando o hash já guardado no Texto. */
+HashEntry* buscarEntradaTexto(TabelaHash *tabela, const Texto *pista);
+
+/* concluirMigracao() – termina um crescimento em andamento (antes de leituras concorrentes). */
+void concluirMigracao(TabelaHash *tabela);
+
+/* iniciarIterador() / proximaEntrada() – percorre as entradas em ordem de inserção; NULL ao final. */
+void iniciarIterador(IteradorTabela *it, const TabelaHash *tabela);
+HashEntry* proximaEntrada(IteradorTabela *it);
+
+/* entradaEm() – entrada na posição pos do vetor denso (as do índice reverso, por exemplo). */
+static inline HashEntry* entradaEm(const TabelaHash *tabela, size_t pos) {
+    return &tabela->segmentos[pos >> SEGMENTO_BITS][pos & (SEGMENTO_ENTRADAS - 1)];
+}
+
+/* replicarTabelaPorNo() – cópia local da tabela em cada nó NUMA; retorna quantas réplicas. */
+int replicarTabelaPorNo(TabelaHash *tabela);
+
+/* buscarSuspeitoIndice() – entrada do índice reverso para um suspeito (ou NULL). */
+const SuspeitoIndice* buscarSuspeitoIndice(const TabelaHash *tabela, const char *suspeito);
+
+/* vincularSalas() – registra, em cada pista da tabela, as salas que a guardam. */
+void vincularSalas(TabelaHash *tabela, const Sala *raiz);
 
 /* verificarSuspeitoFinal() – conduz à fase de julgamento final. */
-void verificarSuspeitoFinal(PistaNode *raizPistas, HashEntry *tabela[]);
+void verificarSuspeitoFinal(PistaNode *raizPistas, TabelaHash *tabela, ContextoSessao *ctx);
+
+/* executarBusca() – modo de edição: imprime as pistas que contêm todas as palavras. */
+void executarBusca(TabelaHash *tabela, const char *consulta);
+
+/* listarEvidencias() – imprime as pistas (e salas) que apontam para um suspeito. */
+void listarEvidencias(const TabelaHash *tabela, const char *suspeito);
+
+/* construirIndiceInvertido() – indexa as palavras de todas as pistas da tabela hash. */
+void construirIndiceInvertido(IndiceInvertido *ind, TabelaHash *tabela);
+
+/* buscarPistasPorPalavras() – ids das pistas que contêm todas as palavras da consulta. */
+int buscarPistasPorPalavras(const IndiceInvertido *ind, const char *consulta, int *resultado, int max);
+
+void liberarIndiceInvertido(IndiceInvertido *ind);
+
+/* Busca aproximada: os trigramas da consulta geram os candidatos e a distância de
+   edição (Myers, bit a bit) confirma. buscarPistasAproximadas() retorna quantas pistas
+   ficam a até maxDist edições (as max primeiras, por distância, vão para res). */
+void construirIndiceTrigramas(IndiceTrigramas *ind, const char *const *pistas, int n);
+void acrescentarPistaTrigramas(IndiceTrigramas *ind, const char *pista);
+void esquecerPistaTrigramas(IndiceTrigramas *ind, int id);
+int buscarPistasAproximadas(const IndiceTrigramas *ind, const char *consulta, int maxDist,
+                            SugestaoPista *res, int max);
+int distanciaEdicao(const char *a, const char *b, int limite);
+void liberarIndiceTrigramas(IndiceTrigramas *ind);
+
+/* montarTrigramasDaTabela() – índice de trigramas das pistas da tabela (id = id da
+   entrada), mantido depois por inserções e remoções. Monta-se na carga, antes de a
+   tabela ser compartilhada: as dicas só o leem. */
+void montarTrigramasDaTabela(TabelaHash *tabela);
+
+/* Dedução sobre os fatos do caso: adicionarFato() retorna 0 para fato inválido (tipo
+   desconhecido, campos faltando ou mais de MAX_SUSPEITOS_DEDUCAO suspeitos);
+   deduzirSuspeitos() considera só os fatos das pistas coletadas. */
+void iniciarBaseFatos(BaseFatos *b);
+int registrarSuspeitoFato(BaseFatos *b, const char *nome);
+int buscarSuspeitoFato(const BaseFatos *b, const char *nome);
+int adicionarFato(BaseFatos *b, const char *pista, const char *tipo, const char *suspeito, const char *testemunha);
+void deduzirSuspeitos(const BaseFatos *b, const PistaNode *coletadas, Deducao *d);
+void exibirDeducao(const BaseFatos *b, const Deducao *d);
+void liberarBaseFatos(BaseFatos *b);
+
+/* Grafo de evidências: construirGrafo() recebe pares (suspeito, pista) sem repetição;
+   montarGrafoDoCaso() liga cada pista ao seu suspeito e aos citados pelos seus fatos.
+   analisarGrafo() roda os kernels em fatias de vértices, em paralelo. */
+void construirGrafo(GrafoEvidencias *g, int nSuspeitos, int nPistas, const int *arestas, long long nArestas);
+void montarGrafoDoCaso(GrafoEvidencias *g, TabelaHash *tabela, const BaseFatos *fatos);
+void analisarGrafo(const GrafoEvidencias *g, AnaliseGrafo *a, int threads);
+void exibirAnaliseGrafo(const GrafoEvidencias *g, const AnaliseGrafo *a);
+void liberarAnaliseGrafo(AnaliseGrafo *a);
+void liberarGrafo(GrafoEvidencias *g);
+
+/* Distâncias até as pistas: construirDistancias() precisa das salas numeradas e
+   vinculadas à tabela; depois, cada consulta é uma leitura. */
+void construirDistancias(TabelaDistancias *t, const Sala *raiz, int nSalas, const TabelaHash *tabela);
+static inline uint16_t distanciaPista(const TabelaDistancias *t, int suspeito, int sala) {
+    return t->dist[(size_t) suspeito * t->nSalas + sala];
+}
+int proximoPassoPista(const TabelaDistancias *t, int suspeito, int sala);
+void exibirPistasProximas(const TabelaDistancias *t, const TabelaHash *tabela, int sala);
+void liberarDistancias(TabelaDistancias *t);
+
+/* Rotas: montarMapaSalas() junta a árvore e as passagens; buscarRotas() devolve até k
+   rotas sem repetir sala (exceto o retorno ao buscar uma pista), em ordem de custo,
+   evitando as salas marcadas em evitar (NULL = nenhuma). */
+void montarMapaSalas(MapaSalas *m, const Sala *raiz, int nSalas, const Passagem *passagens, int nPassagens);
+void iniciarBuscaRotas(BuscaRotas *b, const MapaSalas *m);
+int buscarRotas(BuscaRotas *b, int origem, int destino, int k, const uint8_t *evitar, int exigirPista, Rota *rotas);
+void exibirRotas(const MapaSalas *m, const Rota *rotas, int n);
+void liberarRota(Rota *r);
+void liberarBuscaRotas(BuscaRotas *b);
+void liberarMapaSalas(MapaSalas *m);
+
+/* Esboços de frequência: registro sem trava, estimativa, mescla e persistência. */
+Estatisticas* criarEstatisticas(void);
+void registrarNoEsboco(EsbocoFrequencia *e, const char *chave);
+uint32_t estimarFrequencia(const EsbocoFrequencia *e, const char *chave);
+void mesclarEsbocos(EsbocoFrequencia *destino, const EsbocoFrequencia *origem);
+int salvarEstatisticas(const Estatisticas *est, const char *arquivo);
+int carregarEstatisticas(Estatisticas *est, const char *arquivo);
+void listarMaisFrequentes(const EsbocoFrequencia *e, const char *candidatos[], int n, int k);
+
+/* exibirPopulares() – salas e pistas mais frequentes segundo as estatísticas. */
+void exibirPopulares(const Estatisticas *est, const Sala *raiz, const TabelaHash *tabela);
+
+/* numerarSalas() – atribui ids em pré-ordem às salas; retorna a quantidade. */
+int numerarSalas(Sala *raiz);
+
+/* Mapa de calor: contadores exatos por thread, mesclados em segundo plano. */
+MapaCalor* criarMapaCalor(int nSalas, int nPistas, unsigned intervaloMs);
+void registrarVisita(MapaCalor *m, int idSala);
+void registrarColeta(MapaCalor *m, int idPista);
+void mesclarMapaCalor(MapaCalor *m);
+int exportarMapaCalor(MapaCalor *m, const char *arquivo, const Sala *raiz, const TabelaHash *tabela);
+void liberarMapaCalor(MapaCalor *m);
+
+/* Diário assíncrono: abrirDiario() retorna NULL se o arquivo não abrir; fecharDiario()
+   grava o que faltar e espera a thread escritora. */
+Diario* abrirDiario(const char *arquivo);
+void registrarEventoDiario(Diario *d, const char *tipo, const char *sala, const char *detalhe);
+void fecharDiario(Diario *d);
+
+/* WAL das pistas: anexarWal() devolve o lsn do registro; confirmarWal() espera ele estar
+   no disco (um fdatasync atende todos os que esperam). reaplicarWal() reinsere as pistas
+   válidas e corta o arquivo no primeiro registro incompleto ou corrompido. */
+uint32_t crc32Bytes(const void *dados, size_t n);
+Wal* abrirWal(const char *arquivo);
+uint64_t anexarWal(Wal *w, const char *pista);
+int confirmarWal(Wal *w, uint64_t lsn);
+int reaplicarWal(const char *arquivo, TabelaHash *tabela, PistaNode **raizPistas);
+void fecharWal(Wal *w, int descartar);
+
+/* Arquivo de casos (B+tree em disco). abrirArquivoCasos() trava o arquivo (exclusivo
+   para escrita, compartilhado para leitura), cria-o só se for para escrita e retorna
+   NULL se ele não existir ou for inválido; arquivarPista() soma uma partida ao par
+   (jogador, pista); o cursor percorre as chaves a partir do jogador (NULL = início) em
+   ordem de strcmp, a mesma de exibirPistas(). */
+ArquivoCasos* abrirArquivoCasos(const char *arquivo, int nQuadros, int escrita);
+int arquivarPista(ArquivoCasos *a, const char *jogador, const char *pista);
+void posicionarCursor(ArquivoCasos *a, const char *jogador, CursorArquivo *c);
+int proximoNoCursor(CursorArquivo *c, char jogador[MAX_NOME], char pista[MAX_PISTA], uint32_t *vezes);
+int fecharArquivoCasos(ArquivoCasos *a);
+
+/* listarHistorico() – imprime as pistas arquivadas do jogador (NULL = todos). */
+void listarHistorico(ArquivoCasos *a, const char *jogador);
+
+/* Catálogo de casos. Formato do arquivo, uma linha por item ('#' comenta):
+     caso|nome
+     sala|nome|pista|sala-pai|e ou d     (a primeira sala, sem pai, é a entrada)
+     mapa|pista|suspeito
+     fato|pista|exonera|suspeito       fato|pista|alibi|suspeito|testemunha
+     fato|pista|um_de|A;B;C            culpados|K   (padrão: um culpado)
+     passagem|sala|sala[|custo]        ligação extra entre salas já declaradas
+   obterCaso() carrega o caso se preciso e o fixa (NULL se não existe ou é inválido);
+   soltarCaso() libera a referência. Casos soltos saem do cache, do menos recente
+   para o mais recente, quando a memória passa de limiteBytes. */
+Catalogo* abrirCatalogo(const char *arquivo, size_t limiteBytes);
+Caso* obterCaso(Catalogo *cat, const char *nome);
+void soltarCaso(Catalogo *cat, Caso *c);
+void fecharCatalogo(Catalogo *cat);
+
+/* Índice global do catálogo: construirIndiceGlobal() carrega cada caso uma vez (pelo
+   cache) e grava o índice; carregarIndiceGlobal() retorna 0 se o arquivo for inválido;
+   buscarTermoGlobal() acha a pista ou o suspeito (NULL se não aparece em nenhum caso). */
+int construirIndiceGlobal(Catalogo *cat, const char *arquivo);
+int carregarIndiceGlobal(IndiceGlobal *ind, const char *arquivo);
+const TermoGlobal* buscarTermoGlobal(const IndiceGlobal *ind, int tipo, const char *texto);
+void liberarIndiceGlobal(IndiceGlobal *ind);
+
+/* Registro colunar de sessões: gravação, leitura e varredura analítica. */
+void registrarPassoSessao(RegistroSessao *r, const Sala *sala);
+void liberarRegistroSessao(RegistroSessao *r);
+void anexarSessao(TabelaSessoes *ts, const RegistroSessao *r);
+int salvarSessoes(const TabelaSessoes *ts, const char *arquivo);
+int carregarSessoes(TabelaSessoes *ts, const char *arquivo);
+/* acrescentarSessao() – grava a sessão no fim do arquivo, como um lote novo (1 = gravada,
+   0 = erro de gravação, -1 = arquivo existente ilegível: nada é gravado). */
+int acrescentarSessao(const char *arquivo, const RegistroSessao *r);
+int filtrarFaixa(const TabelaSessoes *ts, int inicio, int fim, int32_t acusado, int veredicto, uint8_t *mascara);
+int filtrarSessoes(const TabelaSessoes *ts, int32_t acusado, int veredicto, uint8_t *mascara);
+void analisarSessoes(const TabelaSessoes *ts);
+void liberarTabelaSessoes(TabelaSessoes *ts);
+
+/* executarConsulta() – filtra e agrupa as sessões do arquivo, lendo-o lote a lote;
+   retorna o total encontrado (-1 se o arquivo for ilegível). */
+long long executarConsulta(const char *arquivo, const ConsultaSessoes *c, const TabelaHash *tabela);
+
+/* comprimirBloco() – comprime n bytes (LZ) em dst; retorna o tamanho comprimido. */
+size_t comprimirBloco(const unsigned char *src, size_t n, unsigned char *dst);
+
+/* descomprimirBloco() – desfaz comprimirBloco() em dst (até cap bytes); -1 se inválido. */
+long descomprimirBloco(const unsigned char *src, size_t n, unsigned char *dst, size_t cap);
+
+/* executarCompressao() – grava origem em destino como contêiner DQZ1 (ou o desfaz). */
+int executarCompressao(const char *origem, const char *destino, int descomprimir);
+
+/* arquivarPistasColetadas() – soma esta partida às pistas do jogador no arquivo de casos. */
+void arquivarPistasColetadas(ArquivoCasos *a, const char *jogador, const PistaNode *raiz);
+
+/* executarOndeAparece() – casos e salas onde o texto aparece como suspeito e como pista. */
+void executarOndeAparece(const char *arquivoIndice, const char *texto);
+
+/* executarDica() – sugere as pistas da tabela mais próximas do texto digitado (k edições; -1 = automático). */
+void executarDica(TabelaHash *tabela, const char *texto, int k);
+
+/* executarBenchDica() – n pistas sintéticas; consultas com erros pelo índice e por varredura completa. */
+void executarBenchDica(int n);
+
+/* executarDeducao() – suspeitos possíveis e certos com as pistas da lista ("p1;p2"). */
+void executarDeducao(const BaseFatos *b, const char *pistas);
+
+/* executarBenchDeducao() – caso sintético com n suspeitos; mede a dedução a cada pista coletada. */
+void executarBenchDeducao(int n);
+
+/* executarBenchGrafo() – grafo sintético de n pistas; compara a análise com 1 e com nThreads threads. */
+void executarBenchGrafo(long n, int nThreads);
+
+/* executarProximas() – pistas mais próximas da sala, pelo nome. */
+void executarProximas(const Sala *raiz, int nSalas, const TabelaHash *tabela, const char *sala);
+
+/* executarBenchProximas() – mapa sintético de n salas; tabela de distâncias x BFS a cada consulta. */
+void executarBenchProximas(long n);
+
+/* executarRotas() – as k melhores rotas entre duas salas, pelos nomes. */
+void executarRotas(const MapaSalas *m, const char *origem, const char *destino, int k,
+                   const char *const *evitar, int nEvitar, int exigirPista);
+
+/* executarBenchRotas() – mapa sintético de n salas com passagens; Yen com e sem reaproveitamento. */
+void executarBenchRotas(long n, int k);
+
+/* listarCasos() – nomes dos casos do catálogo (sem carregá-los). */
+void listarCasos(const char *arquivo);
+
+/* executarBenchCatalogo() – sessões em THREADS_CATALOGO threads, com casos sorteados
+   (os primeiros mais populares), sobre um cache limitado a limiteBytes. */
+void executarBenchCatalogo(const char *arquivo, long sessoes, size_t limiteBytes);
+
+/* executarBenchWal() – nThreads gravam n pistas cada, confirmando uma a uma, e mede o commit em grupo. */
+void executarBenchWal(const char *arquivo, int nThreads, long n);
+
+/* executarAutoteste() – confere tabela hash, arquivo de sessões e DQZ1; retorna 1 se tudo passou. */
+int executarAutoteste(void);
 
 /* Funções utilitárias */
 void exibirPistas(PistaNode *raiz);
 void liberarPistas(PistaNode *raiz);
-void liberarTabelaHash(HashEntry *tabela[]);
+void liberarTabelaHash(TabelaHash *tabela);
 unsigned long hash_string(const char *s);
 void strip_newline(char *s);
 void limparEntradaRestante(void);
@@ -77,50 +976,261 @@ void limparEntradaRestante(void);
    Implementação
    --------------------------- */
 
-/* criarSala() – cria dinamicamente um cômodo. */
-Sala* criarSala(const char *nome, const char *pista) {
-    Sala *s = (Sala*) malloc(sizeof(Sala));
-    if (!s) {
-        fprintf(stderr, "Erro de alocacao de memoria para sala.\n");
-        exit(EXIT_FAILURE);
+/* Textos longos das salas e das pistas coletadas; vivem até o fim do programa */
+static Arena arenaJogo;
+
+/* ---------------------------
+   Pools de nós (páginas grandes)
+   --------------------------- */
+
+static PoolNos poolSalas = { sizeof(Sala), 0, NULL, NULL, 0, NULL, {0} };
+static PoolNos poolPistas = { sizeof(PistaNode), 0, NULL, NULL, 0, NULL, {0} };
+
+/* Uma região de REGIAO_POOL bytes; *origem diz como ela foi obtida */
+static void* mapearRegiao(int paginasGrandes, int *origem) {
+    void *p;
+#ifdef MAP_HUGETLB
+    if (paginasGrandes) {
+        p = mmap(NULL, REGIAO_POOL, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) { *origem = PAGINAS_HUGETLB; return p; }
     }
-    strncpy(s->nome, nome, MAX_NOME-1);
-    s->nome[MAX_NOME-1] = '\0';
-    if (pista != NULL && pista[0] != '\0') {
-        strncpy(s->pista, pista, MAX_PISTA-1);
-        s->pista[MAX_PISTA-1] = '\0';
-    } else {
-        s->pista[0] = '\0';
+#endif
+    /* sem páginas reservadas: mapeia o dobro e recorta 2 MB alinhados, que é o que
+       o kernel consegue promover a página grande transparente */
+    char *q = (char*) mmap(NULL, 2 * (size_t) REGIAO_POOL, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (q == MAP_FAILED) {
+        *origem = PAGINAS_MALLOC;
+        return aligned_alloc(64, REGIAO_POOL);
+    }
+    char *ini = (char*) (((uintptr_t) q + REGIAO_POOL - 1) & ~(uintptr_t) (REGIAO_POOL - 1));
+    if (ini > q) munmap(q, ini - q);
+    munmap(ini + REGIAO_POOL, q + REGIAO_POOL - ini);
+    p = ini;
+    *origem = PAGINAS_PEQUENAS;
+#ifdef MADV_HUGEPAGE
+    if (paginasGrandes && madvise(p, REGIAO_POOL, MADV_HUGEPAGE) == 0) *origem = PAGINAS_THP;
+#endif
+#ifdef MADV_NOHUGEPAGE
+    /* sem a opção, fica de fato em páginas de 4 KB mesmo com THP "always" */
+    if (!paginasGrandes) madvise(p, REGIAO_POOL, MADV_NOHUGEPAGE);
+#endif
+    return p;
+}
+
+static void* alocarNo(PoolNos *pool) {
+    if (pool->devolvidos) {
+        void *n = pool->devolvidos;
+        pool->devolvidos = *(void**) n;
+        return n;
+    }
+    if (pool->restante < pool->tamNo) {
+        int origem;
+        RegiaoPool *r = (RegiaoPool*) mapearRegiao(pool->paginasGrandes, &origem);
+        if (!r) { fprintf(stderr, "Erro de alocacao pool.\n"); exit(EXIT_FAILURE); }
+        r->prox = pool->regioes;
+        r->origem = origem;
+        pool->regioes = r;
+        pool->nRegioes[origem]++;
+        pool->livre = (char*) r + CABECALHO_REGIAO;
+        pool->restante = REGIAO_POOL - CABECALHO_REGIAO;
+    }
+    void *n = pool->livre;
+    pool->livre += pool->tamNo;
+    pool->restante -= pool->tamNo;
+    return n;
+}
+
+static void devolverNo(PoolNos *pool, void *n) {
+    *(void**) n = pool->devolvidos;
+    pool->devolvidos = n;
+}
+
+/* Desfaz todas as regiões; os nós do pool deixam de valer */
+static void liberarPool(PoolNos *pool) {
+    while (pool->regioes) {
+        RegiaoPool *r = pool->regioes;
+        pool->regioes = r->prox;
+        if (r->origem == PAGINAS_MALLOC) free(r);
+        else munmap(r, REGIAO_POOL);
+    }
+    pool->livre = NULL;
+    pool->restante = 0;
+    pool->devolvidos = NULL;
+    memset(pool->nRegioes, 0, sizeof(pool->nRegioes));
+}
+
+/* usarPaginasGrandes() – salas e pistas criadas daqui em diante vêm de páginas de 2 MB.
+   Regiões já mapeadas continuam como estão. */
+void usarPaginasGrandes(int ativar) {
+    poolSalas.paginasGrandes = poolPistas.paginasGrandes = ativar;
+}
+
+static char* reservarNaArena(Arena *a, size_t n) {
+    BlocoArena *b = a->blocos;
+    if (!b || b->cap - b->usado < n) {
+        size_t cap = n > ARENA_BLOCO ? n : ARENA_BLOCO;
+        b = (BlocoArena*) malloc(sizeof(BlocoArena) + cap);
+        if (!b) { fprintf(stderr, "Erro de alocacao arena.\n"); exit(EXIT_FAILURE); }
+        b->prox = a->blocos;
+        b->usado = 0;
+        b->cap = cap;
+        a->blocos = b;
+    }
+    char *p = b->dados + b->usado;
+    b->usado += n;
+    return p;
+}
+
+/* Texto com os n primeiros bytes de s, cujo hash o chamador já conhece */
+static Texto montarTexto(Arena *a, const char *s, size_t n, uint32_t hash) {
+    Texto t;
+    char *dst = n < TEXTO_CURTO ? t.u.curto : reservarNaArena(a, n + 1);
+    if (n) memcpy(dst, s, n);
+    dst[n] = '\0';
+    if (n >= TEXTO_CURTO) t.u.longo = dst;
+    t.tam = (uint32_t) n;
+    t.hash = hash;
+    return t;
+}
+
+/* criarTexto() – copia s (até max-1 bytes) para um Texto; textos longos vão para a arena.
+   O hash é o da cópia (já truncada), então bate com hash_string do texto guardado.
+*/
+Texto criarTexto(Arena *a, const char *s, size_t max) {
+    char buf[MAX_PISTA];
+    size_t n = s ? strlen(s) : 0;
+    if (n > max - 1) n = max - 1;
+    if (n < sizeof(buf)) {
+        memcpy(buf, s ? s : "", n);
+        buf[n] = '\0';
+        return montarTexto(a, buf, n, (uint32_t) hash_string(buf));
+    }
+    Texto t = montarTexto(a, s, n, 0);
+    t.hash = (uint32_t) hash_string(t.u.longo);
+    return t;
+}
+
+void liberarArena(Arena *a) {
+    while (a->blocos) {
+        BlocoArena *b = a->blocos;
+        a->blocos = b->prox;
+        free(b);
     }
+}
+
+/* criarSala() – cria dinamicamente um cômodo. */
+Sala* criarSala(const char *nome, const char *pista) {
+    return criarSalaNaArena(&arenaJogo, nome, pista);
+}
+
+Sala* criarSalaNaArena(Arena *a, const char *nome, const char *pista) {
+    Sala *s = (Sala*) alocarNo(&poolSalas);
+    s->id = -1;
+    s->nome = criarTexto(a, nome, MAX_NOME);
+    s->pista = criarTexto(a, pista, MAX_PISTA); /* NULL vira pista vazia */
     s->esquerda = s->direita = NULL;
     return s;
 }
 
+/* liberarSalas() – devolve ao pool todas as salas do mapa. */
+void liberarSalas(Sala *raiz) {
+    if (!raiz) return;
+    liberarSalas(raiz->esquerda);
+    liberarSalas(raiz->direita);
+    devolverNo(&poolSalas, raiz);
+}
+
+static int alturaPista(const PistaNode *n) {
+    return n ? n->altura : 0;
+}
+
+static void atualizarAltura(PistaNode *n) {
+    int ae = alturaPista(n->esq), ad = alturaPista(n->dir);
+    n->altura = (ae > ad ? ae : ad) + 1;
+}
+
+static PistaNode* rotacionarDireita(PistaNode *n) {
+    PistaNode *e = n->esq;
+    n->esq = e->dir;
+    e->dir = n;
+    atualizarAltura(n);
+    atualizarAltura(e);
+    return e;
+}
+
+static PistaNode* rotacionarEsquerda(PistaNode *n) {
+    PistaNode *d = n->dir;
+    n->dir = d->esq;
+    d->esq = n;
+    atualizarAltura(n);
+    atualizarAltura(d);
+    return d;
+}
+
+/* Restaura |altura(esq) - altura(dir)| <= 1 após uma inserção ou remoção abaixo de n */
+static PistaNode* balancearPista(PistaNode *n) {
+    atualizarAltura(n);
+    int fator = alturaPista(n->esq) - alturaPista(n->dir);
+    if (fator > 1) {
+        if (alturaPista(n->esq->esq) < alturaPista(n->esq->dir)) n->esq = rotacionarEsquerda(n->esq);
+        return rotacionarDireita(n);
+    }
+    if (fator < -1) {
+        if (alturaPista(n->dir->dir) < alturaPista(n->dir->esq)) n->dir = rotacionarDireita(n->dir);
+        return rotacionarEsquerda(n);
+    }
+    return n;
+}
+
 /* inserirPista() / adicionarPista() – insere a pista coletada na árvore de pistas.
    Não insere duplicatas idênticas (compara strings).
 */
-PistaNode* inserirPista(PistaNode *raiz, const char *pista) {
-    if (pista == NULL || pista[0] == '\0') return raiz;
+PistaNode* inserirPista(PistaNode *raiz, const Texto *pista) {
+    if (pista == NULL || pista->tam == 0) return raiz;
     if (raiz == NULL) {
-        PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-        if (!n) { fprintf(stderr, "Erro de alocacao BST.\n"); exit(EXIT_FAILURE); }
-        strncpy(n->pista, pista, MAX_PISTA-1);
-        n->pista[MAX_PISTA-1] = '\0';
+        PistaNode *n = (PistaNode*) alocarNo(&poolPistas);
+        n->pista = *pista; /* texto longo continua na arena de quem o criou */
+        n->altura = 1;
         n->esq = n->dir = NULL;
         return n;
     }
-    int cmp = strcmp(pista, raiz->pista);
+    int cmp = strcmp(textoStr(pista), textoStr(&raiz->pista));
     if (cmp < 0) raiz->esq = inserirPista(raiz->esq, pista);
     else if (cmp > 0) raiz->dir = inserirPista(raiz->dir, pista);
-    /* se igual, não insere duplicata */
-    return raiz;
+    else return raiz; /* se igual, não insere duplicata */
+    return balancearPista(raiz);
+}
+
+/* removerPista() – retira uma pista da árvore de pistas coletadas, mantendo o balanceamento.
+   Um nó com dois filhos recebe a pista do sucessor, que é removido da subárvore direita.
+*/
+PistaNode* removerPista(PistaNode *raiz, const char *pista) {
+    if (!raiz || !pista) return raiz;
+    int cmp = strcmp(pista, textoStr(&raiz->pista));
+    if (cmp < 0) {
+        raiz->esq = removerPista(raiz->esq, pista);
+    } else if (cmp > 0) {
+        raiz->dir = removerPista(raiz->dir, pista);
+    } else if (raiz->esq && raiz->dir) {
+        const PistaNode *suc = raiz->dir;
+        while (suc->esq) suc = suc->esq;
+        raiz->pista = suc->pista;
+        raiz->dir = removerPista(raiz->dir, textoStr(&suc->pista));
+    } else {
+        PistaNode *filho = raiz->esq ? raiz->esq : raiz->dir;
+        devolverNo(&poolPistas, raiz);
+        return filho;
+    }
+    return balancearPista(raiz);
 }
 
 /* Percorre e imprime pistas em ordem alfabética */
 void exibirPistas(PistaNode *raiz) {
     if (!raiz) return;
     exibirPistas(raiz->esq);
-    printf(" - %s\n", raiz->pista);
+    printf(" - %s\n", textoStr(&raiz->pista));
     exibirPistas(raiz->dir);
 }
 
@@ -129,7 +1239,7 @@ void liberarPistas(PistaNode *raiz) {
     if (!raiz) return;
     liberarPistas(raiz->esq);
     liberarPistas(raiz->dir);
-    free(raiz);
+    devolverNo(&poolPistas, raiz);
 }
 
 /* Hash simples: soma ponderada e módulo */
@@ -141,54 +1251,4762 @@ unsigned long hash_string(const char *s) {
     return h;
 }
 
-/* inserirNaHash() – insere associação pista/suspeito na tabela hash. */
-void inserirNaHash(HashEntry *tabela[], const char *pista, const char *suspeito) {
-    if (!pista || !suspeito) return;
-    unsigned long h = hash_string(pista) % HASH_SIZE;
-    /* verificar duplicata de chave: se existir, sobrescreve o suspeito */
-    HashEntry *at = tabela[h];
-    while (at) {
-        if (strcmp(at->pista, pista) == 0) {
-            strncpy(at->suspeito, suspeito, MAX_NOME-1);
-            at->suspeito[MAX_NOME-1] = '\0';
-            return;
+/* ---------------------------
+   Filtro de Bloom em blocos (frente da tabela hash)
+   --------------------------- */
+
+/* Mistura final (murmur3 fmix64): espalha os bits do djb2 antes de usá-los no filtro */
+static uint64_t misturarHash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Bloco e bits da chave: o bloco vem da metade alta de x, os BLOOM_K bits
+   (9 bits cada, 0..511) de uma segunda mistura. Todos caem na mesma linha de cache. */
+static uint64_t* blocoBloom(const FiltroBloom *f, unsigned long h, uint64_t *bits) {
+    uint64_t x = misturarHash((uint64_t) h);
+    uint64_t y = x * 0x9E3779B97F4A7C15ULL;
+    *bits = y;
+    return f->blocos[(uint32_t) (x >> 32) & (f->nBlocos - 1)];
+}
+
+static void inserirNoFiltro(FiltroBloom *f, unsigned long h) {
+    uint64_t y;
+    uint64_t *bloco = blocoBloom(f, h, &y);
+    for (int k = 0; k < BLOOM_K; ++k) {
+        unsigned int pos = (unsigned int) (y >> (9 * k)) & 511u;
+        bloco[pos >> 6] |= 1ULL << (pos & 63);
+    }
+    f->nChaves++;
+}
+
+/* 0 = certamente ausente; 1 = talvez presente (consultar a tabela) */
+static int talvezNoFiltro(const FiltroBloom *f, unsigned long h) {
+    uint64_t y;
+    const uint64_t *bloco = blocoBloom(f, h, &y);
+    for (int k = 0; k < BLOOM_K; ++k) {
+        unsigned int pos = (unsigned int) (y >> (9 * k)) & 511u;
+        if (!(bloco[pos >> 6] & (1ULL << (pos & 63)))) return 0;
+    }
+    return 1;
+}
+
+static void alocarFiltro(FiltroBloom *f, uint32_t nBlocos) {
+    f->blocos = (uint64_t (*)[8]) aligned_alloc(64, (size_t) nBlocos * 64);
+    if (!f->blocos) { fprintf(stderr, "Erro de alocacao filtro.\n"); exit(EXIT_FAILURE); }
+    memset(f->blocos, 0, (size_t) nBlocos * 64);
+    f->nBlocos = nBlocos;
+    f->nChaves = 0;
+}
+
+/* Filtro dimensionado para um índice com nSlots slots: uma chave por slot é 1,5x a
+   carga máxima (2/3), então não enche enquanto o índice seguinte é migrado. */
+static void dimensionarFiltro(FiltroBloom *f, size_t nSlots) {
+    size_t chaves = nSlots;
+    uint32_t n = 1;
+    while ((size_t) n * BLOOM_CHAVES_POR_BLOCO < chaves) n *= 2;
+    alocarFiltro(f, n);
+}
+
+/* ---------------------------
+   Réplicas da tabela por nó NUMA
+   --------------------------- */
+
+/* Lê uma lista de CPUs no formato do sysfs ("0-3,8-11"); retorna quantos ids leu. */
+static int lerListaCpus(const char *caminho, cpu_set_t *cpus, int *maiorId) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) return 0;
+    char linha[4096];
+    int n = 0;
+    CPU_ZERO(cpus);
+    if (fgets(linha, sizeof(linha), f)) {
+        char *p = linha;
+        while (*p && *p != '\n') {
+            char *fim;
+            long a = strtol(p, &fim, 10), b = a;
+            if (fim == p) break;
+            if (*fim == '-') b = strtol(fim + 1, &fim, 10);
+            for (long c = a; c <= b && c < CPU_SETSIZE; ++c) {
+                CPU_SET((int) c, cpus);
+                if (c > *maiorId) *maiorId = (int) c;
+                n++;
+            }
+            p = *fim == ',' ? fim + 1 : fim;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+static void descartarReplicas(TabelaHash *tabela) {
+    for (int i = 0; i < tabela->nReplicas; ++i) {
+        liberarTabelaHash(tabela->replicas[i]);
+        free(tabela->replicas[i]);
+    }
+    free(tabela->replicas);
+    free(tabela->noDaCpu);
+    tabela->replicas = NULL;
+    tabela->nReplicas = 0;
+    tabela->noDaCpu = NULL;
+    tabela->nCpus = 0;
+}
+
+static void descartarTrigramas(TabelaHash *tabela) {
+    if (!tabela->trigramas) return;
+    liberarIndiceTrigramas(tabela->trigramas);
+    free(tabela->trigramas);
+    tabela->trigramas = NULL;
+}
+
+/* Copia pistas, suspeitos, ids e salas de 'origem' em 'destino' (já inicializada).
+   Os SalaRef são alocados de novo pela thread que monta a réplica: ficam no nó dela. */
+static void copiarEntradas(TabelaHash *destino, const TabelaHash *origem) {
+    IteradorTabela it;
+    iniciarIterador(&it, origem);
+    for (const HashEntry *at; (at = proximaEntrada(&it)); ) {
+        inserirNaHash(destino, textoStr(&at->pista), textoStr(&at->suspeito));
+        HashEntry *copia = buscarEntradaTexto(destino, &at->pista);
+        copia->id = at->id;
+        SalaRef **fim = &copia->salas;
+        for (const SalaRef *r = at->salas; r; r = r->prox) {
+            SalaRef *novo = (SalaRef*) malloc(sizeof(SalaRef));
+            if (!novo) { fprintf(stderr, "Erro de alocacao replica.\n"); exit(EXIT_FAILURE); }
+            novo->sala = r->sala;
+            novo->prox = NULL;
+            *fim = novo;
+            fim = &novo->prox;
+        }
+    }
+    destino->proximoId = origem->proximoId;
+    concluirMigracao(destino); /* réplicas são lidas por várias threads: nada pode migrar depois */
+}
+
+typedef struct tarefaReplica {
+    const TabelaHash *origem;
+    TabelaHash *replica;
+    cpu_set_t cpus;
+} TarefaReplica;
+
+/* Roda fixada nas CPUs do nó: pela política de primeiro toque, as páginas
+   da réplica (entradas, filtro, índice) ficam na memória local do nó. */
+static void* construirReplica(void *arg) {
+    TarefaReplica *t = (TarefaReplica*) arg;
+    sched_setaffinity(0, sizeof(cpu_set_t), &t->cpus);
+    TabelaHash *r = (TabelaHash*) malloc(sizeof(TabelaHash));
+    if (!r) { fprintf(stderr, "Erro de alocacao replica.\n"); exit(EXIT_FAILURE); }
+    inicializarTabelaHash(r);
+    copiarEntradas(r, t->origem);
+    t->replica = r;
+    return NULL;
+}
+
+/* criarReplicas() – uma réplica por nó, construída por uma thread presa às CPUs do nó. */
+static int criarReplicas(TabelaHash *tabela, int nNos, const cpu_set_t *cpusDoNo, int maiorCpu) {
+    descartarReplicas(tabela);
+    TarefaReplica *tarefas = (TarefaReplica*) calloc(nNos, sizeof(TarefaReplica));
+    pthread_t *threads = (pthread_t*) calloc(nNos, sizeof(pthread_t));
+    tabela->noDaCpu = (int*) malloc((maiorCpu + 1) * sizeof(int));
+    if (!tarefas || !threads || !tabela->noDaCpu) { fprintf(stderr, "Erro de alocacao replica.\n"); exit(EXIT_FAILURE); }
+    tabela->nCpus = maiorCpu + 1;
+    for (int c = 0; c <= maiorCpu; ++c) {
+        tabela->noDaCpu[c] = 0;
+        for (int no = 0; no < nNos; ++no)
+            if (CPU_ISSET(c, &cpusDoNo[no])) { tabela->noDaCpu[c] = no; break; }
+    }
+    for (int no = 0; no < nNos; ++no) {
+        tarefas[no].origem = tabela;
+        tarefas[no].cpus = cpusDoNo[no];
+        if (pthread_create(&threads[no], NULL, construirReplica, &tarefas[no]) != 0) {
+            fprintf(stderr, "Erro ao criar thread de replica.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    tabela->replicas = (TabelaHash**) malloc(nNos * sizeof(TabelaHash*));
+    if (!tabela->replicas) { fprintf(stderr, "Erro de alocacao replica.\n"); exit(EXIT_FAILURE); }
+    for (int no = 0; no < nNos; ++no) {
+        pthread_join(threads[no], NULL);
+        tabela->replicas[no] = tarefas[no].replica;
+    }
+    tabela->nReplicas = nNos;
+    free(tarefas);
+    free(threads);
+    return nNos;
+}
+
+/* replicarTabelaPorNo() – copia a tabela (somente leitura a partir daqui) para cada
+   nó NUMA da máquina. As consultas passam a usar a réplica do nó da thread.
+   Retorna o número de réplicas (0 em máquinas de um só nó ou sem sysfs).
+*/
+int replicarTabelaPorNo(TabelaHash *tabela) {
+    cpu_set_t cpusDoNo[MAX_NOS_NUMA];
+    int nNos = 0, maiorCpu = 0;
+    char caminho[128];
+    for (int no = 0; no < MAX_NOS_NUMA; ++no) {
+        snprintf(caminho, sizeof(caminho), "/sys/devices/system/node/node%d/cpulist", no);
+        CPU_ZERO(&cpusDoNo[no]);
+        if (lerListaCpus(caminho, &cpusDoNo[no], &maiorCpu) > 0) nNos = no + 1;
+    }
+    if (nNos <= 1) return 0;
+    concluirMigracao(tabela); /* as threads das réplicas leem a origem ao mesmo tempo */
+    return criarReplicas(tabela, nNos, cpusDoNo, maiorCpu);
+}
+
+/* Nó da thread atual, descoberto uma vez por thread */
+static _Thread_local int noDaThread = -1;
+
+static const TabelaHash* replicaLocal(const TabelaHash *tabela) {
+    if (noDaThread < 0) {
+        int cpu = sched_getcpu();
+        noDaThread = (cpu >= 0 && cpu < tabela->nCpus) ? tabela->noDaCpu[cpu] : 0;
+    }
+    return tabela->replicas[noDaThread < tabela->nReplicas ? noDaThread : 0];
+}
+
+/* Índice vazio com nSlots slots; slots de 8 bits enquanto as posições couberem */
+static void alocarIndice(IndiceSlots *ind, size_t nSlots) {
+    ind->nSlots = nSlots;
+    ind->largura = nSlots <= 256 ? 1 : nSlots <= 65536 ? 2 : 4;
+    ind->slots = calloc(nSlots, ind->largura);
+    if (!ind->slots) { fprintf(stderr, "Erro de alocacao hash.\n"); exit(EXIT_FAILURE); }
+}
+
+static uint32_t lerSlot(const IndiceSlots *ind, size_t i) {
+    switch (ind->largura) {
+    case 1:  return ((const uint8_t*) ind->slots)[i];
+    case 2:  return ((const uint16_t*) ind->slots)[i];
+    default: return ((const uint32_t*) ind->slots)[i];
+    }
+}
+
+static void gravarSlot(IndiceSlots *ind, size_t i, uint32_t v) {
+    switch (ind->largura) {
+    case 1:  ((uint8_t*) ind->slots)[i] = (uint8_t) v; break;
+    case 2:  ((uint16_t*) ind->slots)[i] = (uint16_t) v; break;
+    default: ((uint32_t*) ind->slots)[i] = v; break;
+    }
+}
+
+/* Slot inicial da sondagem: djb2 tem bits baixos fracos, então mistura antes */
+static size_t slotInicial(const IndiceSlots *ind, uint32_t h) {
+    return (size_t) misturarHash((uint64_t) h) & (ind->nSlots - 1);
+}
+
+/* Slot com a chave, ou o slot livre onde a sondagem parou (lerSlot == 0) */
+static size_t sondar(const IndiceSlots *ind, const TabelaHash *tabela, uint32_t hc, const char *pista) {
+    size_t mascara = ind->nSlots - 1;
+    for (size_t i = slotInicial(ind, hc); ; i = (i + 1) & mascara) {
+        uint32_t v = lerSlot(ind, i);
+        if (v == 0) return i;
+        const HashEntry *e = entradaEm(tabela, v - 1);
+        if (e->pista.hash == hc && strcmp(textoStr(&e->pista), pista) == 0) return i;
+    }
+}
+
+/* Registra uma posição cuja chave ainda não está no índice */
+static void inserirNoIndice(IndiceSlots *ind, uint32_t hc, size_t pos) {
+    size_t mascara = ind->nSlots - 1, i = slotInicial(ind, hc);
+    while (lerSlot(ind, i) != 0) i = (i + 1) & mascara;
+    gravarSlot(ind, i, (uint32_t) (pos + 1));
+}
+
+/* Esvazia o slot i puxando para trás as entradas seguintes da sequência de sondagem,
+   para que nenhuma busca precise de marcador de remoção */
+static void removerDoIndice(IndiceSlots *ind, size_t i, const TabelaHash *tabela) {
+    size_t mascara = ind->nSlots - 1;
+    for (size_t j = (i + 1) & mascara; ; j = (j + 1) & mascara) {
+        uint32_t v = lerSlot(ind, j);
+        if (v == 0) break;
+        size_t k = slotInicial(ind, entradaEm(tabela, v - 1)->pista.hash);
+        /* a entrada em j só pode ocupar i se i estiver entre k e j (circularmente) */
+        if (((j - k) & mascara) >= ((j - i) & mascara)) {
+            gravarSlot(ind, i, v);
+            i = j;
+        }
+    }
+    gravarSlot(ind, i, 0);
+}
+
+/* inicializarTabelaHash() – prepara uma tabela vazia. */
+void inicializarTabelaHash(TabelaHash *tabela) {
+    tabela->segmentos = NULL;
+    tabela->nSegmentos = tabela->capSegmentos = 0;
+    tabela->nEntradas = tabela->nUsadas = 0;
+    alocarIndice(&tabela->indice, INDICE_INICIAL);
+    memset(&tabela->antigo, 0, sizeof(IndiceSlots));
+    tabela->migradas = tabela->destino = tabela->limiteMigracao = 0;
+    dimensionarFiltro(&tabela->filtro, tabela->indice.nSlots);
+    memset(&tabela->filtroNovo, 0, sizeof(FiltroBloom));
+    tabela->suspeitos = NULL;
+    tabela->nSuspeitos = tabela->capSuspeitos = 0;
+    tabela->proximoId = 0;
+    tabela->textos.blocos = NULL;
+    tabela->replicas = NULL;
+    tabela->nReplicas = 0;
+    tabela->noDaCpu = NULL;
+    tabela->nCpus = 0;
+    tabela->trigramas = NULL;
+}
+
+/* nomes do índice reverso são guardados truncados em MAX_NOME-1 bytes; inserção e
+   consulta comparam pelo mesmo prefixo para que a mesma chave dê sempre o mesmo suspeito */
+static int mesmoSuspeito(const char *nome, const char *suspeito) {
+    return strncmp(nome, suspeito, MAX_NOME-1) == 0;
+}
+
+/* id do suspeito no índice reverso; cria a entrada se ainda não existir */
+static int obterIdSuspeito(TabelaHash *tabela, const char *suspeito) {
+    for (int i = 0; i < tabela->nSuspeitos; ++i)
+        if (mesmoSuspeito(tabela->suspeitos[i].nome, suspeito)) return i;
+    if (tabela->nSuspeitos == tabela->capSuspeitos) {
+        tabela->capSuspeitos = tabela->capSuspeitos ? tabela->capSuspeitos * 2 : 8;
+        tabela->suspeitos = (SuspeitoIndice*) realloc(tabela->suspeitos,
+                                                      tabela->capSuspeitos * sizeof(SuspeitoIndice));
+        if (!tabela->suspeitos) { fprintf(stderr, "Erro de alocacao indice reverso.\n"); exit(EXIT_FAILURE); }
+    }
+    SuspeitoIndice *si = &tabela->suspeitos[tabela->nSuspeitos];
+    strncpy(si->nome, suspeito, MAX_NOME-1);
+    si->nome[MAX_NOME-1] = '\0';
+    si->pistas = NULL;
+    si->nPistas = si->capPistas = 0;
+    return tabela->nSuspeitos++;
+}
+
+/* põe a entrada da posição 'pos' no fim da lista do suspeito 'id' */
+static void adicionarAoSuspeito(TabelaHash *tabela, int id, size_t pos) {
+    SuspeitoIndice *si = &tabela->suspeitos[id];
+    if (si->nPistas == si->capPistas) {
+        si->capPistas = si->capPistas ? si->capPistas * 2 : 4;
+        si->pistas = (int*) realloc(si->pistas, si->capPistas * sizeof(int));
+        if (!si->pistas) { fprintf(stderr, "Erro de alocacao indice reverso.\n"); exit(EXIT_FAILURE); }
+    }
+    entradaEm(tabela, pos)->posNoSuspeito = si->nPistas;
+    si->pistas[si->nPistas++] = (int) pos;
+}
+
+/* Índice da entrada da posição 'pos' na lista do suspeito. Remoções só puxam as
+   seguintes para trás, então ela está em posNoSuspeito ou antes: basta descer. */
+static int indiceNoSuspeito(const SuspeitoIndice *si, const HashEntry *e, size_t pos) {
+    int i = e->posNoSuspeito < si->nPistas ? e->posNoSuspeito : si->nPistas - 1;
+    while (si->pistas[i] != (int) pos) i--;
+    return i;
+}
+
+/* retira a entrada da lista do seu suspeito mantendo a ordem de inserção */
+static void removerDoSuspeito(TabelaHash *tabela, const HashEntry *e, size_t pos) {
+    SuspeitoIndice *si = &tabela->suspeitos[e->idSuspeito];
+    int i = indiceNoSuspeito(si, e, pos);
+    memmove(&si->pistas[i], &si->pistas[i+1], (si->nPistas - i - 1) * sizeof(int));
+    si->nPistas--;
+}
+
+/* iniciarIterador() / proximaEntrada() – percorre as entradas em ordem de inserção; NULL ao final.
+   É uma varredura linear do vetor denso, pulando buracos. A tabela não pode ser
+   alterada durante o percurso. */
+void iniciarIterador(IteradorTabela *it, const TabelaHash *tabela) {
+    it->tabela = tabela;
+    it->pos = 0;
+}
+
+HashEntry* proximaEntrada(IteradorTabela *it) {
+    const TabelaHash *t = it->tabela;
+    while (it->pos < t->nUsadas) {
+        HashEntry *e = entradaEm(t, it->pos++);
+        if (e->idSuspeito >= 0) return e;
+    }
+    return NULL;
+}
+
+/* Leva a entrada viva de 'de' para a posição livre 'para' (< de), acertando o
+   índice reverso; 'de' vira buraco */
+static void moverEntrada(TabelaHash *tabela, size_t de, size_t para) {
+    HashEntry *e = entradaEm(tabela, de), *n = entradaEm(tabela, para);
+    SuspeitoIndice *si = &tabela->suspeitos[e->idSuspeito];
+    int i = indiceNoSuspeito(si, e, de);
+    si->pistas[i] = (int) para;
+    *n = *e;
+    n->posNoSuspeito = i;
+    e->idSuspeito = -1;
+    e->salas = NULL;
+}
+
+/* Avança a migração em até 'passos' posições do vetor denso. Cada entrada viva vai
+   para a próxima posição livre (fechando os buracos) e passa a constar do índice
+   novo; as inseridas depois do início já estão nele e só têm o slot corrigido.
+   Ao final o índice antigo é liberado, o filtro novo assume e os segmentos que
+   sobraram vazios são devolvidos. */
+static void migrarPassos(TabelaHash *tabela, int passos) {
+    while (tabela->antigo.slots && passos-- > 0) {
+        if (tabela->migradas == tabela->nUsadas) {
+            free(tabela->antigo.slots);
+            memset(&tabela->antigo, 0, sizeof(IndiceSlots));
+            tabela->nUsadas = tabela->destino;
+            tabela->migradas = tabela->destino = tabela->limiteMigracao = 0;
+            free(tabela->filtro.blocos);
+            tabela->filtro = tabela->filtroNovo;
+            memset(&tabela->filtroNovo, 0, sizeof(FiltroBloom));
+            size_t segs = (tabela->nUsadas + SEGMENTO_ENTRADAS - 1) >> SEGMENTO_BITS;
+            while (tabela->nSegmentos > segs) free(tabela->segmentos[--tabela->nSegmentos]);
+            break;
+        }
+        size_t de = tabela->migradas++;
+        const HashEntry *e = entradaEm(tabela, de);
+        if (e->idSuspeito < 0) continue;
+        size_t para = tabela->destino++;
+        if (de < tabela->limiteMigracao) {
+            if (para != de) moverEntrada(tabela, de, para);
+            inserirNoIndice(&tabela->indice, e->pista.hash, para);
+            inserirNoFiltro(&tabela->filtroNovo, e->pista.hash);
+        } else if (para != de) {
+            size_t slot = sondar(&tabela->indice, tabela, e->pista.hash, textoStr(&e->pista));
+            moverEntrada(tabela, de, para);
+            gravarSlot(&tabela->indice, slot, (uint32_t) (para + 1));
+        }
+    }
+}
+
+/* concluirMigracao() – termina um crescimento em andamento (antes de leituras concorrentes). */
+void concluirMigracao(TabelaHash *tabela) {
+    while (tabela->antigo.slots) migrarPassos(tabela, 64);
+}
+
+/* Passa a registrar as posições num índice novo com 'nSlots' slots; o atual vira o
+   antigo. Com o mesmo tamanho, a migração serve só para compactar. */
+static void iniciarMigracao(TabelaHash *tabela, size_t nSlots) {
+    tabela->antigo = tabela->indice;
+    alocarIndice(&tabela->indice, nSlots);
+    tabela->migradas = tabela->destino = 0;
+    tabela->limiteMigracao = tabela->nUsadas;
+    dimensionarFiltro(&tabela->filtroNovo, tabela->indice.nSlots);
+}
+
+/* Procura a chave no índice atual e, se ainda não migrada, no antigo;
+   devolve a posição + 1 no vetor denso (0 = ausente). No antigo só valem as
+   posições que a migração ainda não alcançou e que não viraram buraco. */
+static uint32_t posicaoNaTabela(const TabelaHash *tabela, uint32_t hc, const char *pista) {
+    uint32_t v = lerSlot(&tabela->indice, sondar(&tabela->indice, tabela, hc, pista));
+    if (v == 0 && tabela->antigo.slots) {
+        v = lerSlot(&tabela->antigo, sondar(&tabela->antigo, tabela, hc, pista));
+        if (v && (v - 1 < tabela->migradas || entradaEm(tabela, v - 1)->idSuspeito < 0)) v = 0;
+    }
+    return v;
+}
+
+static HashEntry* procurarNaTabela(const TabelaHash *tabela, uint32_t hc, const char *pista) {
+    uint32_t v = posicaoNaTabela(tabela, hc, pista);
+    return v ? entradaEm(tabela, v - 1) : NULL;
+}
+
+/* Chave de uma pista na tabela: as maiores que MAX_PISTA-1 bytes são guardadas
+   truncadas, então inserção, busca e remoção passam todas por aqui. Devolve a própria
+   pista quando ela cabe; senão, a cópia truncada em 'buf'. */
+static const char* chaveDaPista(const char *pista, char buf[MAX_PISTA]) {
+    if (memchr(pista, '\0', MAX_PISTA)) return pista;
+    memcpy(buf, pista, MAX_PISTA - 1);
+    buf[MAX_PISTA - 1] = '\0';
+    return buf;
+}
+
+/* inserirNaHash() – insere associação pista/suspeito na tabela hash.
+   O índice reverso é atualizado junto: ao sobrescrever o suspeito de uma pista,
+   a entrada sai da lista do suspeito antigo e entra na do novo.
+   A entrada nova vai para o fim do vetor denso; quando o índice passa de 2/3
+   ocupado, ele dobra e é migrado aos poucos.
+*/
+void inserirNaHash(TabelaHash *tabela, const char *pista, const char *suspeito) {
+    if (!pista || !suspeito) return;
+    if (tabela->replicas) descartarReplicas(tabela); /* réplicas só valem para a tabela congelada */
+    migrarPassos(tabela, REHASH_PASSOS);
+    char buf[MAX_PISTA];
+    const char *chave = chaveDaPista(pista, buf);
+    size_t tam = strlen(chave);
+    uint32_t hc = (uint32_t) hash_string(chave);
+    int id = obterIdSuspeito(tabela, suspeito);
+    /* verificar duplicata de chave: se existir, sobrescreve o suspeito */
+    uint32_t v = posicaoNaTabela(tabela, hc, chave);
+    if (v) {
+        HashEntry *at = entradaEm(tabela, v - 1);
+        if (at->idSuspeito != id) {
+            removerDoSuspeito(tabela, at, v - 1);
+            at->idSuspeito = id;
+            adicionarAoSuspeito(tabela, id, v - 1);
+            at->suspeito = criarTexto(&tabela->textos, suspeito, MAX_NOME);
+        }
+        return;
+    }
+    /* acrescentar ao fim do vetor denso; cheio, ganha mais um segmento */
+    if (tabela->nUsadas == tabela->nSegmentos * SEGMENTO_ENTRADAS) {
+        if (tabela->nSegmentos == tabela->capSegmentos) {
+            tabela->capSegmentos = tabela->capSegmentos ? tabela->capSegmentos * 2 : 4;
+            tabela->segmentos = (HashEntry**) realloc(tabela->segmentos, tabela->capSegmentos * sizeof(HashEntry*));
+            if (!tabela->segmentos) { fprintf(stderr, "Erro de alocacao hash.\n"); exit(EXIT_FAILURE); }
+        }
+        HashEntry *seg = (HashEntry*) malloc(SEGMENTO_ENTRADAS * sizeof(HashEntry));
+        if (!seg) { fprintf(stderr, "Erro de alocacao hash.\n"); exit(EXIT_FAILURE); }
+        tabela->segmentos[tabela->nSegmentos++] = seg;
+    }
+    size_t pos = tabela->nUsadas++;
+    HashEntry *novo = entradaEm(tabela, pos);
+    novo->pista = montarTexto(&tabela->textos, chave, tam, hc);
+    novo->suspeito = criarTexto(&tabela->textos, suspeito, MAX_NOME);
+    novo->id = tabela->proximoId++;
+    novo->idSuspeito = id;
+    novo->salas = NULL;
+    inserirNoIndice(&tabela->indice, hc, pos);
+    tabela->nEntradas++;
+    adicionarAoSuspeito(tabela, id, pos);
+
+    inserirNoFiltro(&tabela->filtro, hc);
+    if (tabela->antigo.slots) inserirNoFiltro(&tabela->filtroNovo, hc);
+    if (tabela->trigramas) acrescentarPistaTrigramas(tabela->trigramas, chave);
+
+    /* posições também limitam a largura dos slots, então conta os buracos;
+       se menos de 1/3 está viva, compactar no mesmo tamanho basta */
+    size_t nSlots = tabela->indice.nSlots;
+    if (!tabela->antigo.slots && tabela->nUsadas * 3 > nSlots * 2)
+        iniciarMigracao(tabela, tabela->nEntradas * 3 > nSlots ? nSlots * 2 : nSlots);
+}
+
+/* buscarEntrada() – entrada da tabela para uma pista (ou NULL).
+   Com réplicas NUMA, a consulta vai para a cópia do nó da thread chamadora.
+   O filtro de Bloom descarta a maioria das pistas inexistentes sem tocar no índice.
+   O ponteiro deixa de valer na próxima inserção ou remoção (a entrada pode ser movida).
+   A consulta não altera a tabela, nem durante uma migração; réplicas NUMA e
+   leitores concorrentes ainda pedem concluirMigracao() antes, para sondar um índice só.
+*/
+static HashEntry* buscarComHash(TabelaHash *tabela, uint32_t hc, const char *pista) {
+    if (tabela->replicas) tabela = (TabelaHash*) replicaLocal(tabela);
+    if (!talvezNoFiltro(&tabela->filtro, hc)) return NULL;
+    return procurarNaTabela(tabela, hc, pista);
+}
+
+HashEntry* buscarEntrada(TabelaHash *tabela, const char *pista) {
+    if (!pista) return NULL;
+    char buf[MAX_PISTA];
+    const char *chave = chaveDaPista(pista, buf);
+    return buscarComHash(tabela, (uint32_t) hash_string(chave), chave);
+}
+
+/* buscarEntradaTexto() – como buscarEntrada(), usando o hash já guardado no Texto. */
+HashEntry* buscarEntradaTexto(TabelaHash *tabela, const Texto *pista) {
+    return buscarComHash(tabela, pista->hash, textoStr(pista));
+}
+
+/* encontrarSuspeito() – consulta o suspeito correspondente a uma pista. */
+const char* encontrarSuspeito(TabelaHash *tabela, const char *pista) {
+    HashEntry *e = buscarEntrada(tabela, pista);
+    return e ? textoStr(&e->suspeito) : NULL;
+}
+
+static void liberarSalaRefs(HashEntry *e) {
+    SalaRef *r = e->salas;
+    while (r) {
+        SalaRef *tmp = r;
+        r = r->prox;
+        free(tmp);
+    }
+    e->salas = NULL;
+}
+
+/* removerDaHash() – remove a associação de uma pista; retorna 1 se existia.
+   No índice atual o slot é liberado puxando para trás a sequência de sondagem, então
+   as buscas nunca passam por marcador de remoção; se a pista ainda não migrou, basta
+   a entrada virar buraco, que a migração pula. Os buracos no vetor denso (só o
+   iterador os vê) são fechados pela migração seguinte; quando passam da metade,
+   uma migração no mesmo tamanho é iniciada só para isso, e refaz junto o filtro de
+   Bloom, cujos bits não podem ser desligados. O id da pista não é reaproveitado.
+*/
+int removerDaHash(TabelaHash *tabela, const char *pista) {
+    if (!pista) return 0;
+    if (tabela->replicas) descartarReplicas(tabela);
+    migrarPassos(tabela, REHASH_PASSOS);
+    char buf[MAX_PISTA];
+    pista = chaveDaPista(pista, buf);
+    uint32_t hc = (uint32_t) hash_string(pista);
+    if (!talvezNoFiltro(&tabela->filtro, hc)) return 0;
+    size_t slot = sondar(&tabela->indice, tabela, hc, pista);
+    uint32_t v = lerSlot(&tabela->indice, slot);
+    if (v) removerDoIndice(&tabela->indice, slot, tabela);
+    else if (!(v = posicaoNaTabela(tabela, hc, pista))) return 0;
+    HashEntry *e = entradaEm(tabela, v - 1);
+    if (tabela->trigramas) esquecerPistaTrigramas(tabela->trigramas, e->id);
+    removerDoSuspeito(tabela, e, v - 1);
+    liberarSalaRefs(e);
+    e->idSuspeito = -1;
+    tabela->nEntradas--;
+    if (!tabela->antigo.slots && tabela->nUsadas > 2 * tabela->nEntradas)
+        iniciarMigracao(tabela, tabela->indice.nSlots);
+    return 1;
+}
+
+static void limparPistaDasSalas(Sala *s, const char *pista) {
+    if (!s) return;
+    if (strcmp(textoStr(&s->pista), pista) == 0) s->pista = criarTexto(&arenaJogo, "", MAX_PISTA);
+    limparPistaDasSalas(s->esquerda, pista);
+    limparPistaDasSalas(s->direita, pista);
+}
+
+/* retirarPista() – moderação: tira a pista da tabela, das salas e das pistas já coletadas.
+   Retorna 1 se a pista existia na tabela. raizSalas e raizPistas podem ser NULL.
+*/
+int retirarPista(TabelaHash *tabela, Sala *raizSalas, PistaNode **raizPistas, const char *pista) {
+    char copia[MAX_PISTA];   /* 'pista' pode apontar para o texto de uma sala ou nó */
+    strncpy(copia, pista, MAX_PISTA-1);
+    copia[MAX_PISTA-1] = '\0';
+    int existia = removerDaHash(tabela, copia);
+    limparPistaDasSalas(raizSalas, copia);
+    if (raizPistas) *raizPistas = removerPista(*raizPistas, copia);
+    return existia;
+}
+
+/* buscarSuspeitoIndice() – entrada do índice reverso para um suspeito (ou NULL). */
+const SuspeitoIndice* buscarSuspeitoIndice(const TabelaHash *tabela, const char *suspeito) {
+    if (!suspeito) return NULL;
+    for (int i = 0; i < tabela->nSuspeitos; ++i)
+        if (mesmoSuspeito(tabela->suspeitos[i].nome, suspeito)) return &tabela->suspeitos[i];
+    return NULL;
+}
+
+static void vincularSalasRec(TabelaHash *tabela, const Sala *s) {
+    if (!s) return;
+    if (s->pista.tam != 0) {
+        HashEntry *at = procurarNaTabela(tabela, s->pista.hash, textoStr(&s->pista));
+        if (at) {
+            SalaRef *r = (SalaRef*) malloc(sizeof(SalaRef));
+            if (!r) { fprintf(stderr, "Erro de alocacao indice reverso.\n"); exit(EXIT_FAILURE); }
+            r->sala = s;
+            r->prox = NULL;
+            SalaRef **fim = &at->salas;   /* mantém a ordem de visita (pré-ordem) */
+            while (*fim) fim = &(*fim)->prox;
+            *fim = r;
+        }
+    }
+    vincularSalasRec(tabela, s->esquerda);
+    vincularSalasRec(tabela, s->direita);
+}
+
+/* vincularSalas() – registra, em cada pista da tabela, as salas que a guardam.
+   Pode ser chamada de novo após alterar o mapa: os vínculos anteriores são descartados.
+*/
+void vincularSalas(TabelaHash *tabela, const Sala *raiz) {
+    if (tabela->replicas) descartarReplicas(tabela); /* as réplicas copiaram os vínculos antigos */
+    IteradorTabela it;
+    iniciarIterador(&it, tabela);
+    for (HashEntry *at; (at = proximaEntrada(&it)); ) liberarSalaRefs(at);
+    vincularSalasRec(tabela, raiz);
+}
+
+/* liberar tabela hash */
+void liberarTabelaHash(TabelaHash *tabela) {
+    descartarReplicas(tabela);
+    descartarTrigramas(tabela);
+    for (size_t i = 0; i < tabela->nUsadas; ++i) liberarSalaRefs(entradaEm(tabela, i));
+    for (size_t s = 0; s < tabela->nSegmentos; ++s) free(tabela->segmentos[s]);
+    free(tabela->segmentos);
+    free(tabela->indice.slots);
+    free(tabela->antigo.slots);
+    tabela->segmentos = NULL;
+    tabela->nSegmentos = tabela->capSegmentos = 0;
+    tabela->nEntradas = tabela->nUsadas = 0;
+    memset(&tabela->indice, 0, sizeof(IndiceSlots));
+    memset(&tabela->antigo, 0, sizeof(IndiceSlots));
+    tabela->migradas = tabela->destino = tabela->limiteMigracao = 0;
+    liberarArena(&tabela->textos);
+    for (int i = 0; i < tabela->nSuspeitos; ++i) free(tabela->suspeitos[i].pistas);
+    free(tabela->suspeitos);
+    free(tabela->filtro.blocos);
+    free(tabela->filtroNovo.blocos);
+    memset(&tabela->filtro, 0, sizeof(FiltroBloom));
+    memset(&tabela->filtroNovo, 0, sizeof(FiltroBloom));
+    tabela->suspeitos = NULL;
+    tabela->nSuspeitos = tabela->capSuspeitos = 0;
+}
+
+/* ---------------------------
+   Índice invertido de pistas
+   --------------------------- */
+
+/* Par (termo, id) usado durante a construção do índice */
+typedef struct parTermo {
+    char termo[MAX_TERMO];
+    int id;
+} ParTermo;
+
+static char* duplicarTexto(const char *s) {
+    size_t L = strlen(s) + 1;
+    char *d = (char*) malloc(L);
+    if (!d) { fprintf(stderr, "Erro de alocacao de texto.\n"); exit(EXIT_FAILURE); }
+    memcpy(d, s, L);
+    return d;
+}
+
+/* Extrai a próxima palavra de *p em minúsculas. Bytes >= 0x80 (acentos em UTF-8)
+   fazem parte da palavra; palavras longas são truncadas em MAX_TERMO-1. */
+static int proximoTermo(const char **p, char termo[MAX_TERMO]) {
+    const unsigned char *s = (const unsigned char*) *p;
+    while (*s && !(isalnum(*s) || *s >= 0x80)) s++;
+    if (!*s) { *p = (const char*) s; return 0; }
+    int L = 0;
+    while (*s && (isalnum(*s) || *s >= 0x80)) {
+        if (L < MAX_TERMO-1) termo[L++] = (char) tolower(*s);
+        s++;
+    }
+    termo[L] = '\0';
+    *p = (const char*) s;
+    return 1;
+}
+
+static size_t escreverVarint(unsigned char *dst, unsigned int v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        dst[n++] = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    dst[n++] = (unsigned char) v;
+    return n;
+}
+
+static unsigned int lerVarint(const unsigned char **p) {
+    unsigned int v = 0;
+    int desloc = 0;
+    const unsigned char *s = *p;
+    while (*s & 0x80) {
+        v |= (unsigned int) (*s++ & 0x7F) << desloc;
+        desloc += 7;
+    }
+    v |= (unsigned int) *s++ << desloc;
+    *p = s;
+    return v;
+}
+
+static int compararParTermo(const void *a, const void *b) {
+    const ParTermo *x = (const ParTermo*) a, *y = (const ParTermo*) b;
+    int cmp = strcmp(x->termo, y->termo);
+    if (cmp != 0) return cmp;
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+static int compararTermoIndice(const void *chave, const void *elem) {
+    return strcmp((const char*) chave, ((const TermoIndice*) elem)->termo);
+}
+
+/* construirIndiceInvertido() – indexa as palavras de todas as pistas da tabela hash.
+   Os pares (termo, id) são ordenados de uma vez, então cada lista de postagens
+   já sai crescente e sem repetição.
+*/
+void construirIndiceInvertido(IndiceInvertido *ind, TabelaHash *tabela) {
+    ind->pistas = NULL; ind->nPistas = 0;
+    ind->termos = NULL; ind->nTermos = 0;
+
+    int total = (int) tabela->nEntradas;
+    if (total == 0) return;
+
+    ind->pistas = (char**) malloc(total * sizeof(char*));
+    if (!ind->pistas) { fprintf(stderr, "Erro de alocacao indice.\n"); exit(EXIT_FAILURE); }
+
+    size_t nPares = 0, capPares = 64;
+    ParTermo *pares = (ParTermo*) malloc(capPares * sizeof(ParTermo));
+    if (!pares) { fprintf(stderr, "Erro de alocacao indice.\n"); exit(EXIT_FAILURE); }
+
+    IteradorTabela it;
+    iniciarIterador(&it, tabela);
+    for (HashEntry *at; (at = proximaEntrada(&it)); ) {
+        int id = ind->nPistas++;
+        ind->pistas[id] = duplicarTexto(textoStr(&at->pista));
+        const char *p = textoStr(&at->pista);
+        char termo[MAX_TERMO];
+        while (proximoTermo(&p, termo)) {
+            if (nPares == capPares) {
+                capPares *= 2;
+                pares = (ParTermo*) realloc(pares, capPares * sizeof(ParTermo));
+                if (!pares) { fprintf(stderr, "Erro de alocacao indice.\n"); exit(EXIT_FAILURE); }
+            }
+            strcpy(pares[nPares].termo, termo);
+            pares[nPares].id = id;
+            nPares++;
+        }
+    }
+    qsort(pares, nPares, sizeof(ParTermo), compararParTermo);
+
+    /* agrupar pares consecutivos do mesmo termo numa lista delta + varint */
+    ind->termos = (TermoIndice*) malloc((nPares ? nPares : 1) * sizeof(TermoIndice));
+    if (!ind->termos) { fprintf(stderr, "Erro de alocacao indice.\n"); exit(EXIT_FAILURE); }
+    size_t i = 0;
+    while (i < nPares) {
+        size_t fim = i;
+        while (fim < nPares && strcmp(pares[fim].termo, pares[i].termo) == 0) fim++;
+
+        TermoIndice *t = &ind->termos[ind->nTermos++];
+        strcpy(t->termo, pares[i].termo);
+        t->postagens = (unsigned char*) malloc((fim - i) * 5);
+        if (!t->postagens) { fprintf(stderr, "Erro de alocacao indice.\n"); exit(EXIT_FAILURE); }
+        t->tamBytes = 0;
+        t->qtd = 0;
+        int anterior = -1;
+        for (size_t k = i; k < fim; ++k) {
+            if (pares[k].id == anterior) continue; /* palavra repetida na mesma pista */
+            unsigned int delta = (unsigned int) (pares[k].id - (anterior < 0 ? 0 : anterior));
+            t->tamBytes += escreverVarint(t->postagens + t->tamBytes, delta);
+            t->qtd++;
+            anterior = pares[k].id;
+        }
+        i = fim;
+    }
+    free(pares);
+}
+
+/* buscarPistasPorPalavras() – ids das pistas que contêm todas as palavras da consulta.
+   Intersecta começando pela lista mais curta; as demais são decodificadas em fluxo.
+   Retorna o total de pistas encontradas (no máximo 'max' ids são copiados).
+*/
+int buscarPistasPorPalavras(const IndiceInvertido *ind, const char *consulta, int *resultado, int max) {
+    if (!consulta || ind->nTermos == 0) return 0;
+
+    const TermoIndice *lista[MAX_TERMOS_CONSULTA];
+    int nLista = 0;
+    char termo[MAX_TERMO];
+    const char *p = consulta;
+    while (nLista < MAX_TERMOS_CONSULTA && proximoTermo(&p, termo)) {
+        const TermoIndice *t = (const TermoIndice*) bsearch(termo, ind->termos, ind->nTermos,
+                                                            sizeof(TermoIndice), compararTermoIndice);
+        if (!t) return 0; /* palavra ausente: interseção vazia */
+        lista[nLista++] = t;
+    }
+    if (nLista == 0) return 0;
+
+    /* ordenar por tamanho da lista (poucos termos: inserção simples) */
+    for (int a = 1; a < nLista; ++a) {
+        const TermoIndice *t = lista[a];
+        int b = a - 1;
+        while (b >= 0 && lista[b]->qtd > t->qtd) { lista[b+1] = lista[b]; b--; }
+        lista[b+1] = t;
+    }
+
+    int *cand = (int*) malloc(lista[0]->qtd * sizeof(int));
+    if (!cand) { fprintf(stderr, "Erro de alocacao busca.\n"); exit(EXIT_FAILURE); }
+    const unsigned char *q = lista[0]->postagens;
+    int n = 0, id = 0;
+    for (int k = 0; k < lista[0]->qtd; ++k) {
+        id += (int) lerVarint(&q);
+        cand[n++] = id;
+    }
+
+    for (int l = 1; l < nLista && n > 0; ++l) {
+        q = lista[l]->postagens;
+        int restantes = lista[l]->qtd;
+        int atual = (int) lerVarint(&q);
+        restantes--;
+        int m = 0;
+        for (int c = 0; c < n; ++c) {
+            while (atual < cand[c] && restantes > 0) {
+                atual += (int) lerVarint(&q);
+                restantes--;
+            }
+            if (atual == cand[c]) cand[m++] = cand[c];
+            else if (atual < cand[c]) break; /* lista esgotada */
+        }
+        n = m;
+    }
+
+    for (int c = 0; c < n && c < max; ++c) resultado[c] = cand[c];
+    free(cand);
+    return n;
+}
+
+void liberarIndiceInvertido(IndiceInvertido *ind) {
+    for (int i = 0; i < ind->nPistas; ++i) free(ind->pistas[i]);
+    for (int i = 0; i < ind->nTermos; ++i) free(ind->termos[i].postagens);
+    free(ind->pistas);
+    free(ind->termos);
+    ind->pistas = NULL; ind->nPistas = 0;
+    ind->termos = NULL; ind->nTermos = 0;
+}
+
+/* ---------------------------
+   Busca aproximada de pistas (trigramas + distância de edição)
+   --------------------------- */
+
+/* Minúsculas, pontuação vira espaço, espaços repetidos viram um, e um espaço em cada
+   ponta (assim o começo e o fim das palavras também formam trigramas). Retorna o tamanho. */
+static int normalizarPista(const char *s, char *dst, int cap) {
+    int n = 0;
+    dst[n++] = ' ';
+    for (const unsigned char *p = (const unsigned char*) s; *p && n < cap - 2; ++p) {
+        unsigned char c = (isalnum(*p) || *p >= 0x80) ? (unsigned char) tolower(*p) : ' ';
+        if (c == ' ' && dst[n - 1] == ' ') continue;
+        dst[n++] = (char) c;
+    }
+    if (dst[n - 1] != ' ') dst[n++] = ' ';
+    dst[n] = '\0';
+    return n;
+}
+
+static uint32_t trigramaEm(const char *s) {
+    const unsigned char *u = (const unsigned char*) s;
+    return (uint32_t) u[0] << 16 | (uint32_t) u[1] << 8 | u[2];
+}
+
+static int compararU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+/* construirIndiceTrigramas() – como no índice invertido, os pares (trigrama, id) são
+   ordenados de uma vez; cada par cabe num uint64 (trigrama nos bits altos). */
+static void guardarPistaTrigramas(IndiceTrigramas *ind, const char *pista) {
+    if (ind->nPistas == ind->capPistas) {
+        ind->capPistas = ind->capPistas ? ind->capPistas * 2 : 16;
+        ind->pistas = (char**) realloc(ind->pistas, (size_t) ind->capPistas * sizeof(char*));
+        ind->normalizadas = (char**) realloc(ind->normalizadas, (size_t) ind->capPistas * sizeof(char*));
+        if (!ind->pistas || !ind->normalizadas) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+    }
+    if (!pista) { /* id sem pista (removida antes da montagem) */
+        ind->pistas[ind->nPistas] = ind->normalizadas[ind->nPistas] = NULL;
+        ind->nPistas++;
+        return;
+    }
+    char norm[MAX_PISTA + 2];
+    normalizarPista(pista, norm, sizeof(norm));
+    ind->pistas[ind->nPistas] = duplicarTexto(pista);
+    ind->normalizadas[ind->nPistas++] = duplicarTexto(norm);
+}
+
+/* Refaz as postagens sobre todas as pistas guardadas */
+static void reconstruirPostagens(IndiceTrigramas *ind) {
+    free(ind->trigramas);
+    free(ind->inicio);
+    free(ind->ids);
+    ind->nTrigramas = 0;
+    size_t nPares = 0, capPares = 256;
+    uint64_t *pares = (uint64_t*) malloc(capPares * sizeof(uint64_t));
+    if (!pares) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+    for (int id = 0; id < ind->nPistas; ++id) {
+        const char *norm = ind->normalizadas[id];
+        if (!norm) continue;
+        for (int i = 0; norm[i] && norm[i + 1] && norm[i + 2]; ++i) {
+            if (nPares == capPares) {
+                capPares *= 2;
+                pares = (uint64_t*) realloc(pares, capPares * sizeof(uint64_t));
+                if (!pares) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+            }
+            pares[nPares++] = (uint64_t) trigramaEm(norm + i) << 32 | (uint32_t) id;
+        }
+    }
+    qsort(pares, nPares, sizeof(uint64_t), compararU64);
+
+    ind->trigramas = (uint32_t*) malloc((nPares ? nPares : 1) * sizeof(uint32_t));
+    ind->inicio = (uint32_t*) malloc((nPares + 1) * sizeof(uint32_t));
+    ind->ids = (int*) malloc((nPares ? nPares : 1) * sizeof(int));
+    if (!ind->trigramas || !ind->inicio || !ind->ids) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+    uint32_t nIds = 0;
+    for (size_t i = 0; i < nPares; ++i) {
+        if (i > 0 && pares[i] == pares[i - 1]) continue; /* trigrama repetido na mesma pista */
+        uint32_t t = (uint32_t) (pares[i] >> 32);
+        if (ind->nTrigramas == 0 || ind->trigramas[ind->nTrigramas - 1] != t) {
+            ind->trigramas[ind->nTrigramas] = t;
+            ind->inicio[ind->nTrigramas++] = nIds;
+        }
+        ind->ids[nIds++] = (int) (uint32_t) pares[i];
+    }
+    ind->inicio[ind->nTrigramas] = nIds;
+    ind->nIndexados = ind->nPistas;
+    free(pares);
+}
+
+void construirIndiceTrigramas(IndiceTrigramas *ind, const char *const *pistas, int n) {
+    memset(ind, 0, sizeof(*ind));
+    for (int id = 0; id < n; ++id) guardarPistaTrigramas(ind, pistas[id]);
+    reconstruirPostagens(ind);
+}
+
+/* acrescentarPistaTrigramas() – a pista nova ganha o próximo id e fica pendente; as
+   postagens só são refeitas quando as pendentes passam de um oitavo das indexadas,
+   para que uma sequência de inserções custe O(n log n) amortizado. */
+void acrescentarPistaTrigramas(IndiceTrigramas *ind, const char *pista) {
+    guardarPistaTrigramas(ind, pista);
+    int pendentes = ind->nPistas - ind->nIndexados;
+    if (pendentes > TRIGRAMAS_PENDENTES && pendentes > ind->nIndexados / 8) reconstruirPostagens(ind);
+}
+
+/* esquecerPistaTrigramas() – o id deixa de ser sugerido; as postagens ainda o citam
+   até a próxima reconstrução. */
+void esquecerPistaTrigramas(IndiceTrigramas *ind, int id) {
+    if (id < 0 || id >= ind->nPistas || !ind->pistas[id]) return;
+    free(ind->pistas[id]);
+    free(ind->normalizadas[id]);
+    ind->pistas[id] = ind->normalizadas[id] = NULL;
+}
+
+/* Myers/Hyyrö: distância de edição global entre o padrão (m <= 64, já em peq) e o
+   texto, uma coluna da matriz por palavra de 64 bits. Desiste (limite + 1) assim que
+   nem os caracteres restantes conseguem trazer o placar de volta ao limite. */
+static int distanciaMyers(const uint64_t peq[256], int m, const unsigned char *t, int n, int limite) {
+    if (m == 0) return n;
+    uint64_t pv = ~0ull, mv = 0, alto = 1ull << (m - 1);
+    int placar = m;
+    for (int j = 0; j < n; ++j) {
+        uint64_t eq = peq[t[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+        if (ph & alto) placar++;
+        else if (mh & alto) placar--;
+        ph = ph << 1 | 1; /* linha 0 da matriz: D[0][j] = j */
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+        if (placar - (n - j - 1) > limite) return limite + 1;
+    }
+    return placar;
+}
+
+static void montarPeq(uint64_t peq[256], const unsigned char *p, int m) {
+    memset(peq, 0, 256 * sizeof(uint64_t));
+    for (int i = 0; i < m; ++i) peq[p[i]] |= 1ull << i;
+}
+
+/* Programação dinâmica em duas linhas, para padrões com mais de 64 bytes */
+static int distanciaLinhas(const unsigned char *a, int na, const unsigned char *b, int nb, int limite) {
+    int ant[MAX_PISTA + 3], cur[MAX_PISTA + 3];
+    for (int j = 0; j <= nb; ++j) ant[j] = j;
+    for (int i = 1; i <= na; ++i) {
+        cur[0] = i;
+        int menor = cur[0];
+        for (int j = 1; j <= nb; ++j) {
+            int v = ant[j - 1] + (a[i - 1] != b[j - 1]);
+            if (ant[j] + 1 < v) v = ant[j] + 1;
+            if (cur[j - 1] + 1 < v) v = cur[j - 1] + 1;
+            cur[j] = v;
+            if (v < menor) menor = v;
+        }
+        if (menor > limite) return limite + 1;
+        memcpy(ant, cur, (size_t) (nb + 1) * sizeof(int));
+    }
+    return ant[nb] > limite ? limite + 1 : ant[nb];
+}
+
+/* Distância entre textos já normalizados (no máximo MAX_PISTA + 1 bytes) */
+static int distanciaNormalizada(const uint64_t peq[256], const char *a, int na, const char *b, int nb, int limite) {
+    if (na - nb > limite || nb - na > limite) return limite + 1;
+    if (na <= 64) return distanciaMyers(peq, na, (const unsigned char*) b, nb, limite);
+    return distanciaLinhas((const unsigned char*) a, na, (const unsigned char*) b, nb, limite);
+}
+
+/* distanciaEdicao() – edições entre as formas normalizadas de a e b; limite + 1 se passar. */
+int distanciaEdicao(const char *a, const char *b, int limite) {
+    char na[MAX_PISTA + 2], nb[MAX_PISTA + 2];
+    int la = normalizarPista(a, na, sizeof(na)), lb = normalizarPista(b, nb, sizeof(nb));
+    uint64_t peq[256];
+    if (la <= 64) montarPeq(peq, (const unsigned char*) na, la);
+    return distanciaNormalizada(peq, na, la, nb, lb, limite);
+}
+
+static int compararSugestoes(const void *a, const void *b) {
+    const SugestaoPista *x = (const SugestaoPista*) a, *y = (const SugestaoPista*) b;
+    if (x->distancia != y->distancia) return x->distancia - y->distancia;
+    return x->id - y->id;
+}
+
+static int compararU32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+/* buscarPistasAproximadas() – cada edição destrói no máximo 3 trigramas, então uma pista
+   a até k edições tem pelo menos (trigramas distintos da consulta - 3k) deles em comum
+   e, em particular, contém algum dos 3k+1 trigramas mais raros da consulta. Só as
+   postagens desses são lidas; a contagem de comuns é feita sobre elas e o filtro de
+   contagem vale só quando todas as listas foram lidas. Se o filtro não corta nada
+   (consulta curta ou k grande), todas as pistas são conferidas.
+*/
+int buscarPistasAproximadas(const IndiceTrigramas *ind, const char *consulta, int maxDist,
+                            SugestaoPista *res, int max) {
+    if (ind->nPistas == 0 || maxDist < 0) return 0;
+    char q[MAX_PISTA + 2];
+    int L = normalizarPista(consulta, q, sizeof(q));
+    uint64_t peq[256];
+    if (L <= 64) montarPeq(peq, (const unsigned char*) q, L);
+
+    uint32_t tri[MAX_PISTA];
+    int nTri = 0;
+    for (int i = 0; i + 3 <= L; ++i) tri[nTri++] = trigramaEm(q + i);
+    qsort(tri, (size_t) nTri, sizeof(uint32_t), compararU32);
+    int distintos = 0;
+    for (int i = 0; i < nTri; ++i)
+        if (i == 0 || tri[i] != tri[i - 1]) tri[distintos++] = tri[i];
+    int minimo = distintos - 3 * maxDist;
+
+    int *candidatos = (int*) malloc((size_t) ind->nPistas * sizeof(int));
+    if (!candidatos) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+    int nCand = 0;
+    if (minimo <= 0) {
+        for (int id = 0; id < ind->nPistas; ++id) candidatos[nCand++] = id;
+    } else {
+        /* postagens de cada trigrama da consulta, das mais curtas para as mais longas */
+        uint64_t listas[MAX_PISTA];
+        for (int i = 0; i < distintos; ++i) {
+            const uint32_t *t = (const uint32_t*) bsearch(&tri[i], ind->trigramas, (size_t) ind->nTrigramas,
+                                                          sizeof(uint32_t), compararU32);
+            uint32_t k = t ? (uint32_t) (t - ind->trigramas) : UINT32_MAX;
+            uint32_t tam = t ? ind->inicio[k + 1] - ind->inicio[k] : 0;
+            listas[i] = (uint64_t) tam << 32 | k;
+        }
+        qsort(listas, (size_t) distintos, sizeof(uint64_t), compararU64);
+        int lidas = 3 * maxDist + 1; /* nunca passa de distintos, pois minimo > 0 */
+        int exigidas = lidas == distintos ? minimo : 1;
+        uint16_t *comuns = (uint16_t*) calloc((size_t) ind->nPistas, sizeof(uint16_t));
+        if (!comuns) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+        for (int i = 0; i < lidas; ++i) {
+            uint32_t k = (uint32_t) listas[i];
+            if (k == UINT32_MAX) continue;
+            for (uint32_t p = ind->inicio[k]; p < ind->inicio[k + 1]; ++p)
+                if (++comuns[ind->ids[p]] == exigidas) candidatos[nCand++] = ind->ids[p];
+        }
+        free(comuns);
+        for (int id = ind->nIndexados; id < ind->nPistas; ++id) candidatos[nCand++] = id; /* pendentes */
+    }
+
+    int n = 0;
+    SugestaoPista *achadas = (SugestaoPista*) malloc((size_t) (nCand ? nCand : 1) * sizeof(SugestaoPista));
+    if (!achadas) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+    for (int c = 0; c < nCand; ++c) {
+        const char *alvo = ind->normalizadas[candidatos[c]];
+        if (!alvo) continue;
+        int d = distanciaNormalizada(peq, q, L, alvo, (int) strlen(alvo), maxDist);
+        if (d <= maxDist) achadas[n++] = (SugestaoPista) { candidatos[c], d };
+    }
+    qsort(achadas, (size_t) n, sizeof(SugestaoPista), compararSugestoes);
+    for (int i = 0; i < n && i < max; ++i) res[i] = achadas[i];
+    free(achadas);
+    free(candidatos);
+    return n;
+}
+
+void liberarIndiceTrigramas(IndiceTrigramas *ind) {
+    for (int i = 0; i < ind->nPistas; ++i) { free(ind->pistas[i]); free(ind->normalizadas[i]); }
+    free(ind->pistas);
+    free(ind->normalizadas);
+    free(ind->trigramas);
+    free(ind->inicio);
+    free(ind->ids);
+    memset(ind, 0, sizeof(*ind));
+}
+
+/* Índice das pistas da tabela com o id de cada entrada; os ids de pistas removidas
+   (e os seguintes à última, até proximoId) ficam vazios, para que as inserções
+   continuem com o id certo */
+static void preencherTrigramas(IndiceTrigramas *ind, const TabelaHash *tabela) {
+    memset(ind, 0, sizeof(*ind));
+    IteradorTabela it;
+    iniciarIterador(&it, tabela);
+    for (const HashEntry *at; (at = proximaEntrada(&it)); ) {
+        while (ind->nPistas < at->id) guardarPistaTrigramas(ind, NULL);
+        guardarPistaTrigramas(ind, textoStr(&at->pista));
+    }
+    while (ind->nPistas < tabela->proximoId) guardarPistaTrigramas(ind, NULL);
+    reconstruirPostagens(ind);
+}
+
+void montarTrigramasDaTabela(TabelaHash *tabela) {
+    descartarTrigramas(tabela);
+    IndiceTrigramas *ind = (IndiceTrigramas*) malloc(sizeof(IndiceTrigramas));
+    if (!ind) { fprintf(stderr, "Erro de alocacao trigramas.\n"); exit(EXIT_FAILURE); }
+    preencherTrigramas(ind, tabela);
+    tabela->trigramas = ind;
+}
+
+/* ---------------------------
+   Dedução: fatos, álibis e propagação de restrições
+   --------------------------- */
+
+/* Cada fato vira uma restrição sobre "x é culpado": exonera é ¬x, álibi é x -> testemunha
+   e um_de é uma cláusula positiva. Somam-se "ao menos um culpado" e "no máximo
+   maxCulpados". A propagação trabalha com dois conjuntos (culpados e inocentes
+   forçados); a busca só ramifica quando sobra cláusula positiva em aberto. */
+
+void iniciarBaseFatos(BaseFatos *b) {
+    memset(b, 0, sizeof(*b));
+    b->maxCulpados = 1;
+}
+
+static inline int conjTem(const ConjSuspeitos *c, int i) {
+    return (int) ((c->w[i >> 6] >> (i & 63)) & 1);
+}
+
+static inline void conjPoe(ConjSuspeitos *c, int i) {
+    c->w[i >> 6] |= 1ull << (i & 63);
+}
+
+static inline int conjContar(const ConjSuspeitos *c) {
+    int n = 0;
+    for (int i = 0; i < PALAVRAS_DEDUCAO; ++i) n += __builtin_popcountll(c->w[i]);
+    return n;
+}
+
+static inline int conjSeCruzam(const ConjSuspeitos *a, const ConjSuspeitos *b) {
+    uint64_t r = 0;
+    for (int i = 0; i < PALAVRAS_DEDUCAO; ++i) r |= a->w[i] & b->w[i];
+    return r != 0;
+}
+
+/* id do suspeito na base (-1 se não existe) */
+int buscarSuspeitoFato(const BaseFatos *b, const char *nome) {
+    for (int i = 0; i < b->nSuspeitos; ++i)
+        if (strncmp(b->suspeitos[i], nome, MAX_NOME-1) == 0) return i;
+    return -1;
+}
+
+int registrarSuspeitoFato(BaseFatos *b, const char *nome) {
+    int id = buscarSuspeitoFato(b, nome);
+    if (id >= 0) return id;
+    if (b->nSuspeitos == MAX_SUSPEITOS_DEDUCAO) return -1;
+    if (b->nSuspeitos == b->capSuspeitos) {
+        b->capSuspeitos = b->capSuspeitos ? b->capSuspeitos * 2 : 8;
+        b->suspeitos = (char (*)[MAX_NOME]) realloc(b->suspeitos, (size_t) b->capSuspeitos * MAX_NOME);
+        if (!b->suspeitos) { fprintf(stderr, "Erro de alocacao deducao.\n"); exit(EXIT_FAILURE); }
+    }
+    snprintf(b->suspeitos[b->nSuspeitos], MAX_NOME, "%s", nome);
+    return b->nSuspeitos++;
+}
+
+int adicionarFato(BaseFatos *b, const char *pista, const char *tipo, const char *suspeito, const char *testemunha) {
+    FatoCaso f;
+    memset(&f, 0, sizeof(f));
+    snprintf(f.pista, sizeof(f.pista), "%s", pista);
+    f.testemunha = -1;
+    if (strcmp(tipo, "exonera") == 0 && !testemunha) {
+        f.tipo = FATO_EXONERA;
+        if ((f.suspeito = registrarSuspeitoFato(b, suspeito)) < 0) return 0;
+    } else if (strcmp(tipo, "alibi") == 0 && testemunha) {
+        f.tipo = FATO_ALIBI;
+        if ((f.suspeito = registrarSuspeitoFato(b, suspeito)) < 0) return 0;
+        if ((f.testemunha = registrarSuspeitoFato(b, testemunha)) < 0) return 0;
+    } else if (strcmp(tipo, "um_de") == 0 && !testemunha) {
+        /* "A;B;C": o culpado é um deles */
+        f.tipo = FATO_UM_DE;
+        f.suspeito = -1;
+        char nomes[MAX_PISTA];
+        snprintf(nomes, sizeof(nomes), "%s", suspeito);
+        for (char *p = nomes, *fim; p; p = fim) {
+            if ((fim = strchr(p, ';'))) *fim++ = '\0';
+            if (!*p) continue;
+            int id = registrarSuspeitoFato(b, p);
+            if (id < 0) return 0;
+            conjPoe(&f.conjunto, id);
+        }
+        if (conjContar(&f.conjunto) == 0) return 0;
+    } else {
+        return 0;
+    }
+    if (b->nFatos == b->capFatos) {
+        b->capFatos = b->capFatos ? b->capFatos * 2 : 8;
+        b->fatos = (FatoCaso*) realloc(b->fatos, (size_t) b->capFatos * sizeof(FatoCaso));
+        if (!b->fatos) { fprintf(stderr, "Erro de alocacao deducao.\n"); exit(EXIT_FAILURE); }
+    }
+    b->fatos[b->nFatos++] = f;
+    return 1;
+}
+
+void liberarBaseFatos(BaseFatos *b) {
+    free(b->fatos);
+    free(b->suspeitos);
+    memset(b, 0, sizeof(*b));
+}
+
+static int pistaColetada(const PistaNode *r, const char *pista) {
+    while (r) {
+        int cmp = strcmp(pista, textoStr(&r->pista));
+        if (cmp == 0) return 1;
+        r = cmp < 0 ? r->esq : r->dir;
+    }
+    return 0;
+}
+
+/* Restrições dos fatos ativos. As implicações já vêm fechadas: culpa de x força
+   avanco[x] e inocência de y força recuo[y], então a propagação não encadeia álibis. */
+typedef struct problemaDeducao {
+    ConjSuspeitos todos, inocentes;
+    ConjSuspeitos *avanco, *recuo;   /* só válidos em origens / alvos */
+    ConjSuspeitos origens, alvos;
+    ConjSuspeitos *clausulas;        /* positivas: ao menos um culpado no conjunto */
+    int nClausulas;
+    int maxCulpados;
+    unsigned long long nos;
+} ProblemaDeducao;
+
+static void montarProblema(ProblemaDeducao *p, const BaseFatos *b, const PistaNode *coletadas) {
+    memset(p, 0, sizeof(*p));
+    p->maxCulpados = b->maxCulpados > 0 ? b->maxCulpados : 1;
+    for (int i = 0; i < b->nSuspeitos; ++i) conjPoe(&p->todos, i);
+    p->clausulas = (ConjSuspeitos*) malloc(((size_t) b->nFatos + 1) * sizeof(ConjSuspeitos));
+    int *arestas = (int*) malloc(((size_t) b->nFatos + 1) * 2 * sizeof(int));
+    if (!p->clausulas || !arestas) { fprintf(stderr, "Erro de alocacao deducao.\n"); exit(EXIT_FAILURE); }
+    p->clausulas[p->nClausulas++] = p->todos;
+    int nArestas = 0;
+    for (int i = 0; i < b->nFatos; ++i) {
+        const FatoCaso *f = &b->fatos[i];
+        if (f->pista[0] && !pistaColetada(coletadas, f->pista)) continue;
+        if (f->tipo == FATO_EXONERA) conjPoe(&p->inocentes, f->suspeito);
+        else if (f->tipo == FATO_UM_DE) p->clausulas[p->nClausulas++] = f->conjunto;
+        else if (f->suspeito != f->testemunha) {
+            arestas[2 * nArestas] = f->suspeito;
+            arestas[2 * nArestas + 1] = f->testemunha;
+            nArestas++;
+            conjPoe(&p->origens, f->suspeito);
+            conjPoe(&p->alvos, f->testemunha);
+        }
+    }
+    if (nArestas > 0) {
+        int n = b->nSuspeitos;
+        p->avanco = (ConjSuspeitos*) calloc((size_t) n, sizeof(ConjSuspeitos));
+        p->recuo = (ConjSuspeitos*) calloc((size_t) n, sizeof(ConjSuspeitos));
+        int *inicio = (int*) calloc((size_t) n + 1, sizeof(int));
+        int *destino = (int*) malloc((size_t) nArestas * sizeof(int));
+        int *pilha = (int*) malloc((size_t) n * sizeof(int));
+        if (!p->avanco || !p->recuo || !inicio || !destino || !pilha) {
+            fprintf(stderr, "Erro de alocacao deducao.\n"); exit(EXIT_FAILURE);
+        }
+        /* arestas em CSR e fecho por busca em profundidade a partir de cada origem */
+        for (int e = 0; e < nArestas; ++e) inicio[arestas[2 * e] + 1]++;
+        for (int v = 0; v < n; ++v) inicio[v + 1] += inicio[v];
+        for (int e = 0; e < nArestas; ++e) destino[inicio[arestas[2 * e]]++] = arestas[2 * e + 1];
+        for (int v = n; v > 0; --v) inicio[v] = inicio[v - 1];
+        inicio[0] = 0;
+        for (int x = 0; x < n; ++x) {
+            if (!conjTem(&p->origens, x)) continue;
+            ConjSuspeitos *fecho = &p->avanco[x];
+            int topo = 0;
+            conjPoe(fecho, x);
+            pilha[topo++] = x;
+            while (topo > 0) {
+                int v = pilha[--topo];
+                for (int k = inicio[v]; k < inicio[v + 1]; ++k)
+                    if (!conjTem(fecho, destino[k])) { conjPoe(fecho, destino[k]); pilha[topo++] = destino[k]; }
+            }
+            for (int w = 0; w < PALAVRAS_DEDUCAO; ++w)
+                for (uint64_t m = fecho->w[w]; m; m &= m - 1)
+                    conjPoe(&p->recuo[w * 64 + __builtin_ctzll(m)], x);
+        }
+        free(inicio);
+        free(destino);
+        free(pilha);
+    }
+    free(arestas);
+}
+
+static void liberarProblema(ProblemaDeducao *p) {
+    free(p->clausulas);
+    free(p->avanco);
+    free(p->recuo);
+}
+
+/* Aplica as restrições até nada mudar; retorna 0 em contradição */
+static int propagar(const ProblemaDeducao *p, ConjSuspeitos *g, ConjSuspeitos *in) {
+    for (;;) {
+        ConjSuspeitos g0 = *g, in0 = *in;
+        for (int w = 0; w < PALAVRAS_DEDUCAO; ++w) {
+            for (uint64_t m = g->w[w] & p->origens.w[w]; m; m &= m - 1) {
+                const ConjSuspeitos *a = &p->avanco[w * 64 + __builtin_ctzll(m)];
+                for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) g->w[k] |= a->w[k];
+            }
+            for (uint64_t m = in->w[w] & p->alvos.w[w]; m; m &= m - 1) {
+                const ConjSuspeitos *r = &p->recuo[w * 64 + __builtin_ctzll(m)];
+                for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) in->w[k] |= r->w[k];
+            }
+        }
+        if (conjSeCruzam(g, in)) return 0;
+        int culpados = conjContar(g);
+        if (culpados > p->maxCulpados) return 0;
+        if (culpados == p->maxCulpados)
+            for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) in->w[k] |= p->todos.w[k] & ~g->w[k];
+        for (int c = 0; c < p->nClausulas; ++c) {
+            const ConjSuspeitos *cl = &p->clausulas[c];
+            if (conjSeCruzam(cl, g)) continue;
+            ConjSuspeitos livres;
+            for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) livres.w[k] = cl->w[k] & ~in->w[k];
+            int n = conjContar(&livres);
+            if (n == 0) return 0;
+            if (n == 1)
+                for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) g->w[k] |= livres.w[k];
+        }
+        if (memcmp(&g0, g, sizeof(g0)) == 0 && memcmp(&in0, in, sizeof(in0)) == 0) return 1;
+    }
+}
+
+/* Busca uma solução a partir de (g, in): ramifica na cláusula aberta com menos opções;
+   cada opção já tentada fica inocente nas seguintes, sem repetir ramos */
+static int resolver(ProblemaDeducao *p, ConjSuspeitos g, ConjSuspeitos in, ConjSuspeitos *solucao) {
+    p->nos++;
+    if (!propagar(p, &g, &in)) return 0;
+    int melhor = -1, menor = MAX_SUSPEITOS_DEDUCAO + 1;
+    for (int c = 0; c < p->nClausulas; ++c) {
+        if (conjSeCruzam(&p->clausulas[c], &g)) continue;
+        ConjSuspeitos livres;
+        for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) livres.w[k] = p->clausulas[c].w[k] & ~in.w[k];
+        int n = conjContar(&livres);
+        if (n < menor) { menor = n; melhor = c; }
+    }
+    if (melhor < 0) {
+        *solucao = g; /* todos os demais inocentes satisfazem o resto */
+        return 1;
+    }
+    for (int w = 0; w < PALAVRAS_DEDUCAO; ++w) {
+        for (uint64_t m = p->clausulas[melhor].w[w] & ~in.w[w]; m; m &= m - 1) {
+            int v = w * 64 + __builtin_ctzll(m);
+            ConjSuspeitos g2 = g;
+            conjPoe(&g2, v);
+            if (resolver(p, g2, in, solucao)) return 1;
+            conjPoe(&in, v);
+        }
+    }
+    return 0;
+}
+
+/* deduzirSuspeitos() – cada solução achada marca de uma vez todos os seus culpados como
+   possíveis e todos os seus inocentes como não certos; só os suspeitos ainda em dúvida
+   custam uma busca. */
+void deduzirSuspeitos(const BaseFatos *b, const PistaNode *coletadas, Deducao *d) {
+    memset(d, 0, sizeof(*d));
+    ProblemaDeducao p;
+    montarProblema(&p, b, coletadas);
+    ConjSuspeitos g, in = p.inocentes, sol, naoCertos;
+    memset(&g, 0, sizeof(g));
+    if (propagar(&p, &g, &in) && resolver(&p, g, in, &sol)) {
+        d->consistente = 1;
+        d->possiveis = sol;
+        for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) naoCertos.w[k] = p.todos.w[k] & ~sol.w[k];
+        for (int w = 0; w < PALAVRAS_DEDUCAO; ++w) {
+            for (uint64_t m = p.todos.w[w] & ~in.w[w]; m; m &= m - 1) {
+                int v = w * 64 + __builtin_ctzll(m);
+                if (conjTem(&d->possiveis, v)) continue;
+                ConjSuspeitos g2 = g;
+                conjPoe(&g2, v);
+                if (!resolver(&p, g2, in, &sol)) continue;
+                for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) {
+                    d->possiveis.w[k] |= sol.w[k];
+                    naoCertos.w[k] |= p.todos.w[k] & ~sol.w[k];
+                }
+            }
+        }
+        for (int w = 0; w < PALAVRAS_DEDUCAO; ++w) {
+            for (uint64_t m = d->possiveis.w[w] & ~naoCertos.w[w]; m; m &= m - 1) {
+                int v = w * 64 + __builtin_ctzll(m);
+                if (conjTem(&naoCertos, v)) continue;
+                ConjSuspeitos in2 = in;
+                conjPoe(&in2, v);
+                if (!resolver(&p, g, in2, &sol)) continue;
+                for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) naoCertos.w[k] |= p.todos.w[k] & ~sol.w[k];
+            }
+        }
+        for (int k = 0; k < PALAVRAS_DEDUCAO; ++k) d->certos.w[k] = d->possiveis.w[k] & ~naoCertos.w[k];
+    }
+    d->nos = p.nos;
+    liberarProblema(&p);
+}
+
+/* exibirDeducao() – lista os suspeitos que ainda podem ser culpados (até 10 nomes). */
+void exibirDeducao(const BaseFatos *b, const Deducao *d) {
+    if (!d->consistente) {
+        printf("  Os fatos coletados se contradizem.\n");
+        return;
+    }
+    int n = conjContar(&d->possiveis), mostrados = 0;
+    printf("  Ainda podem ser culpados (%d de %d):", n, b->nSuspeitos);
+    for (int i = 0; i < b->nSuspeitos && mostrados < 10; ++i)
+        if (conjTem(&d->possiveis, i))
+            printf("%s %s", mostrados++ ? "," : "", b->suspeitos[i]);
+    if (n > mostrados) printf(" e mais %d", n - mostrados);
+    printf("\n");
+    for (int i = 0; i < b->nSuspeitos; ++i)
+        if (conjTem(&d->certos, i)) printf("  Culpado com certeza: %s\n", b->suspeitos[i]);
+}
+
+/* ---------------------------
+   Grafo de evidências (suspeito–pista)
+   --------------------------- */
+
+/* Arestas (suspeito, pista) -> CSR nos dois sentidos. As arestas não podem se repetir. */
+void construirGrafo(GrafoEvidencias *g, int nSuspeitos, int nPistas, const int *arestas, long long nArestas) {
+    memset(g, 0, sizeof(*g));
+    g->nSuspeitos = nSuspeitos;
+    g->nPistas = nPistas;
+    g->nVertices = nSuspeitos + nPistas;
+    g->nArestas = nArestas;
+    g->inicio = (long long*) calloc((size_t) g->nVertices + 1, sizeof(long long));
+    g->vizinhos = (int*) malloc((size_t) (2 * nArestas + 1) * sizeof(int));
+    if (!g->inicio || !g->vizinhos) { fprintf(stderr, "Erro de alocacao grafo.\n"); exit(EXIT_FAILURE); }
+    for (long long e = 0; e < nArestas; ++e) {
+        g->inicio[arestas[2 * e] + 1]++;
+        g->inicio[nSuspeitos + arestas[2 * e + 1] + 1]++;
+    }
+    for (int v = 0; v < g->nVertices; ++v) g->inicio[v + 1] += g->inicio[v];
+    for (long long e = 0; e < nArestas; ++e) {
+        int s = arestas[2 * e], p = nSuspeitos + arestas[2 * e + 1];
+        g->vizinhos[g->inicio[s]++] = p;
+        g->vizinhos[g->inicio[p]++] = s;
+    }
+    for (int v = g->nVertices; v > 0; --v) g->inicio[v] = g->inicio[v - 1];
+    g->inicio[0] = 0;
+}
+
+static int compararArestas(const void *a, const void *b) {
+    const int *x = (const int*) a, *y = (const int*) b;
+    if (x[1] != y[1]) return x[1] < y[1] ? -1 : 1;
+    return (x[0] > y[0]) - (x[0] < y[0]);
+}
+
+static void anexarAresta(int **arestas, long long *n, long long *cap, int s, int p) {
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        *arestas = (int*) realloc(*arestas, (size_t) *cap * 2 * sizeof(int));
+        if (!*arestas) { fprintf(stderr, "Erro de alocacao grafo.\n"); exit(EXIT_FAILURE); }
+    }
+    (*arestas)[2 * *n] = s;
+    (*arestas)[2 * *n + 1] = p;
+    (*n)++;
+}
+
+/* montarGrafoDoCaso() – cada pista liga ao suspeito da tabela e aos suspeitos citados
+   pelos fatos dela. Os suspeitos que só aparecem nos fatos vêm depois dos da tabela. */
+void montarGrafoDoCaso(GrafoEvidencias *g, TabelaHash *tabela, const BaseFatos *fatos) {
+    int *vertice = (int*) malloc(((size_t) fatos->nSuspeitos + 1) * sizeof(int));
+    int *idPista = (int*) malloc((tabela->nUsadas + 1) * sizeof(int));
+    if (!vertice || !idPista) { fprintf(stderr, "Erro de alocacao grafo.\n"); exit(EXIT_FAILURE); }
+    int nSuspeitos = tabela->nSuspeitos, nPistas = 0;
+    for (int i = 0; i < fatos->nSuspeitos; ++i) {
+        const SuspeitoIndice *si = buscarSuspeitoIndice(tabela, fatos->suspeitos[i]);
+        vertice[i] = si ? (int) (si - tabela->suspeitos) : nSuspeitos++;
+    }
+    int *arestas = NULL;
+    long long nArestas = 0, cap = 0;
+    for (size_t i = 0; i < tabela->nUsadas; ++i) {
+        const HashEntry *e = entradaEm(tabela, i);
+        idPista[i] = e->idSuspeito >= 0 ? nPistas++ : -1;
+        if (e->idSuspeito >= 0) anexarAresta(&arestas, &nArestas, &cap, e->idSuspeito, idPista[i]);
+    }
+    for (int i = 0; i < fatos->nFatos; ++i) {
+        const FatoCaso *f = &fatos->fatos[i];
+        /* na própria tabela: buscarEntrada() pode responder com a réplica do nó,
+           cujo vetor de entradas não é o que idPista indexa */
+        uint32_t v = f->pista[0] ? posicaoNaTabela(tabela, (uint32_t) hash_string(f->pista), f->pista) : 0;
+        if (!v) continue;
+        int p = idPista[v - 1];
+        if (f->tipo == FATO_UM_DE) {
+            for (int w = 0; w < PALAVRAS_DEDUCAO; ++w)
+                for (uint64_t m = f->conjunto.w[w]; m; m &= m - 1)
+                    anexarAresta(&arestas, &nArestas, &cap, vertice[w * 64 + __builtin_ctzll(m)], p);
+        } else {
+            anexarAresta(&arestas, &nArestas, &cap, vertice[f->suspeito], p);
+            if (f->testemunha >= 0) anexarAresta(&arestas, &nArestas, &cap, vertice[f->testemunha], p);
+        }
+    }
+    /* um fato pode repetir a ligação que a tabela já fez */
+    if (nArestas > 0) qsort(arestas, (size_t) nArestas, 2 * sizeof(int), compararArestas);
+    long long unicas = 0;
+    for (long long e = 0; e < nArestas; ++e) {
+        if (unicas > 0 && arestas[2 * e] == arestas[2 * (unicas - 1)] && arestas[2 * e + 1] == arestas[2 * (unicas - 1) + 1])
+            continue;
+        arestas[2 * unicas] = arestas[2 * e];
+        arestas[2 * unicas + 1] = arestas[2 * e + 1];
+        unicas++;
+    }
+    construirGrafo(g, nSuspeitos, nPistas, arestas, unicas);
+    g->nomes = (const char**) malloc(((size_t) g->nVertices + 1) * sizeof(char*));
+    if (!g->nomes) { fprintf(stderr, "Erro de alocacao grafo.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < tabela->nSuspeitos; ++i) g->nomes[i] = tabela->suspeitos[i].nome;
+    for (int i = 0; i < fatos->nSuspeitos; ++i) g->nomes[vertice[i]] = fatos->suspeitos[i];
+    for (size_t i = 0; i < tabela->nUsadas; ++i)
+        if (idPista[i] >= 0) g->nomes[nSuspeitos + idPista[i]] = textoStr(&entradaEm(tabela, i)->pista);
+    free(arestas);
+    free(vertice);
+    free(idPista);
+}
+
+void liberarGrafo(GrafoEvidencias *g) {
+    free(g->inicio);
+    free(g->vizinhos);
+    free(g->nomes);
+    memset(g, 0, sizeof(*g));
+}
+
+/* Fatia de vértices [inicio, fim) processada por uma thread em cada núcleo */
+typedef struct fatiaGrafo {
+    const GrafoEvidencias *g;
+    AnaliseGrafo *a;
+    int inicio, fim;
+    long long histSuspeitos[BALDES_GRAU], histPistas[BALDES_GRAU];
+    long long grauMaxSuspeito, grauMaxPista, contagem;
+    int mudou;
+    pthread_t thread;
+    int emThread;
+} FatiaGrafo;
+
+static int baldeGrau(long long grau) {
+    int b = 0;
+    while (grau > 0 && b < BALDES_GRAU - 1) { grau >>= 1; b++; }
+    return b;
+}
+
+/* Graus: histogramas locais e marca das pistas de grau 1 (bytes distintos por fatia) */
+static void* kernelGraus(void *arg) {
+    FatiaGrafo *f = (FatiaGrafo*) arg;
+    const GrafoEvidencias *g = f->g;
+    for (int v = f->inicio; v < f->fim; ++v) {
+        long long grau = g->inicio[v + 1] - g->inicio[v];
+        if (v < g->nSuspeitos) {
+            f->histSuspeitos[baldeGrau(grau)]++;
+            if (grau > f->grauMaxSuspeito) f->grauMaxSuspeito = grau;
+        } else {
+            f->histPistas[baldeGrau(grau)]++;
+            if (grau > f->grauMaxPista) f->grauMaxPista = grau;
+            f->a->identifica[v - g->nSuspeitos] = grau == 1;
+        }
+    }
+    return NULL;
+}
+
+/* Pistas identificadoras de cada suspeito (só lê as marcas de kernelGraus) */
+static void* kernelIdentificadoras(void *arg) {
+    FatiaGrafo *f = (FatiaGrafo*) arg;
+    const GrafoEvidencias *g = f->g;
+    for (int s = f->inicio; s < f->fim; ++s) {
+        int n = 0;
+        for (long long k = g->inicio[s]; k < g->inicio[s + 1]; ++k)
+            n += f->a->identifica[g->vizinhos[k] - g->nSuspeitos];
+        f->a->identificadoras[s] = n;
+        f->contagem += n;
+    }
+    return NULL;
+}
+
+/* Uma rodada de propagação de rótulos: cada vértice fica com o menor rótulo entre ele e
+   os vizinhos, seguido de um salto (rótulo do rótulo) que encurta as cadeias. Leituras
+   e escritas concorrentes só diminuem rótulos, então a ordem entre threads não importa. */
+static void* kernelRotulos(void *arg) {
+    FatiaGrafo *f = (FatiaGrafo*) arg;
+    const GrafoEvidencias *g = f->g;
+    atomic_int *rotulo = f->a->rotulo;
+    for (int v = f->inicio; v < f->fim; ++v) {
+        int atual = atomic_load_explicit(&rotulo[v], memory_order_relaxed), menor = atual;
+        for (long long k = g->inicio[v]; k < g->inicio[v + 1]; ++k) {
+            int r = atomic_load_explicit(&rotulo[g->vizinhos[k]], memory_order_relaxed);
+            if (r < menor) menor = r;
+        }
+        menor = atomic_load_explicit(&rotulo[menor], memory_order_relaxed);
+        if (menor < atual) {
+            atomic_store_explicit(&rotulo[v], menor, memory_order_relaxed);
+            f->mudou = 1;
+        }
+    }
+    return NULL;
+}
+
+/* Tamanho de cada componente, somado no vértice-rótulo */
+static void* kernelTamanhos(void *arg) {
+    FatiaGrafo *f = (FatiaGrafo*) arg;
+    AnaliseGrafo *a = f->a;
+    for (int v = f->inicio; v < f->fim; ++v) {
+        int r = atomic_load_explicit(&a->rotulo[v], memory_order_relaxed);
+        if (r == v) f->contagem++;
+        atomic_fetch_add_explicit(&a->tamanho[r], 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+/* Divide [inicio, fim) entre as fatias e roda o kernel; a fatia 0 fica na thread chamadora */
+static void rodarFatias(FatiaGrafo *fatias, int nFatias, int inicio, int fim, void *(*kernel)(void*)) {
+    int passo = (fim - inicio + nFatias - 1) / nFatias;
+    for (int t = 0; t < nFatias; ++t) {
+        FatiaGrafo *f = &fatias[t];
+        f->inicio = inicio + t * passo < fim ? inicio + t * passo : fim;
+        f->fim = f->inicio + passo < fim ? f->inicio + passo : fim;
+        f->mudou = 0;
+        f->emThread = t > 0 && pthread_create(&f->thread, NULL, kernel, f) == 0;
+        if (t > 0 && !f->emThread) kernel(f);
+    }
+    kernel(&fatias[0]);
+    for (int t = 0; t < nFatias; ++t)
+        if (fatias[t].emThread) pthread_join(fatias[t].thread, NULL);
+}
+
+/* analisarGrafo() – graus, componentes e pistas identificadoras; nThreads 0 = conforme o tamanho e os núcleos. */
+void analisarGrafo(const GrafoEvidencias *g, AnaliseGrafo *a, int threads) {
+    memset(a, 0, sizeof(*a));
+    a->identifica = (uint8_t*) calloc((size_t) g->nPistas + 1, 1);
+    a->identificadoras = (int*) calloc((size_t) g->nSuspeitos + 1, sizeof(int));
+    a->rotulo = (atomic_int*) malloc(((size_t) g->nVertices + 1) * sizeof(atomic_int));
+    a->tamanho = (atomic_int*) calloc((size_t) g->nVertices + 1, sizeof(atomic_int));
+    if (!a->identifica || !a->identificadoras || !a->rotulo || !a->tamanho) {
+        fprintf(stderr, "Erro de alocacao grafo.\n"); exit(EXIT_FAILURE);
+    }
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    int nThreads = g->nVertices / VERTICES_POR_THREAD + 1;
+    if (nThreads > nucleos) nThreads = (int) (nucleos > 0 ? nucleos : 1);
+    if (threads > 0) nThreads = threads;
+    if (nThreads > MAX_THREADS_CONSULTA) nThreads = MAX_THREADS_CONSULTA;
+    a->nThreads = nThreads;
+
+    FatiaGrafo fatias[MAX_THREADS_CONSULTA];
+    memset(fatias, 0, sizeof(fatias));
+    for (int t = 0; t < nThreads; ++t) { fatias[t].g = g; fatias[t].a = a; }
+
+    rodarFatias(fatias, nThreads, 0, g->nVertices, kernelGraus);
+    for (int t = 0; t < nThreads; ++t) {
+        for (int b = 0; b < BALDES_GRAU; ++b) {
+            a->histSuspeitos[b] += fatias[t].histSuspeitos[b];
+            a->histPistas[b] += fatias[t].histPistas[b];
+        }
+        if (fatias[t].grauMaxSuspeito > a->grauMaxSuspeito) a->grauMaxSuspeito = fatias[t].grauMaxSuspeito;
+        if (fatias[t].grauMaxPista > a->grauMaxPista) a->grauMaxPista = fatias[t].grauMaxPista;
+    }
+
+    rodarFatias(fatias, nThreads, 0, g->nSuspeitos, kernelIdentificadoras);
+    for (int t = 0; t < nThreads; ++t) { a->nIdentificadoras += fatias[t].contagem; fatias[t].contagem = 0; }
+
+    for (int v = 0; v < g->nVertices; ++v) atomic_init(&a->rotulo[v], v);
+    for (int mudou = 1; mudou; ) {
+        rodarFatias(fatias, nThreads, 0, g->nVertices, kernelRotulos);
+        a->rodadas++;
+        mudou = 0;
+        for (int t = 0; t < nThreads; ++t) mudou |= fatias[t].mudou;
+    }
+    rodarFatias(fatias, nThreads, 0, g->nVertices, kernelTamanhos);
+    for (int t = 0; t < nThreads; ++t) a->nComponentes += fatias[t].contagem;
+    for (int v = 0; v < g->nVertices; ++v) {
+        int tam = atomic_load_explicit(&a->tamanho[v], memory_order_relaxed);
+        if (tam > a->maiorComponente) a->maiorComponente = tam;
+    }
+}
+
+void liberarAnaliseGrafo(AnaliseGrafo *a) {
+    free(a->identifica);
+    free(a->identificadoras);
+    free(a->rotulo);
+    free(a->tamanho);
+    memset(a, 0, sizeof(*a));
+}
+
+static void exibirHistograma(const char *titulo, const long long *hist, long long grauMax) {
+    printf("%s (grau maximo %lld):\n", titulo, grauMax);
+    for (int b = 0; b < BALDES_GRAU; ++b) {
+        if (!hist[b]) continue;
+        char faixa[48];
+        if (b <= 1) snprintf(faixa, sizeof(faixa), "%d", b);
+        else snprintf(faixa, sizeof(faixa), "%lld-%lld", 1ll << (b - 1), (1ll << b) - 1);
+        printf("  %-16s %lld\n", faixa, hist[b]);
+    }
+}
+
+/* exibirAnaliseGrafo() – relatório para quem monta o caso. */
+void exibirAnaliseGrafo(const GrafoEvidencias *g, const AnaliseGrafo *a) {
+    printf("Grafo: %d suspeitos, %d pistas, %lld ligacoes\n", g->nSuspeitos, g->nPistas, g->nArestas);
+    exibirHistograma("Pistas ligadas a cada suspeito", a->histSuspeitos, a->grauMaxSuspeito);
+    exibirHistograma("Suspeitos ligados a cada pista", a->histPistas, a->grauMaxPista);
+    printf("Componentes: %d (maior com %d vertices; %d rodadas de rotulos)\n",
+           a->nComponentes, a->maiorComponente, a->rodadas);
+    printf("Pistas que identificam um unico suspeito: %lld de %d\n", a->nIdentificadoras, g->nPistas);
+    if (!g->nomes) return;
+    int semPista = 0;
+    for (int s = 0; s < g->nSuspeitos; ++s) {
+        if (a->identificadoras[s]) continue;
+        if (semPista++ < 10) printf("  sem pista identificadora: %s\n", g->nomes[s]);
+    }
+    if (semPista > 10) printf("  ... e mais %d suspeitos\n", semPista - 10);
+}
+
+/* ---------------------------
+   Distâncias até as pistas (BFS de várias origens)
+   --------------------------- */
+
+/* construirDistancias() – para cada suspeito, uma BFS que parte ao mesmo tempo de todas
+   as salas com pista contra ele. A árvore é percorrida sem direção (filhos e pai). */
+void construirDistancias(TabelaDistancias *t, const Sala *raiz, int nSalas, const TabelaHash *tabela) {
+    memset(t, 0, sizeof(*t));
+    t->nSalas = nSalas;
+    t->nSuspeitos = tabela->nSuspeitos;
+    t->salas = (const Sala**) malloc(((size_t) nSalas + 1) * sizeof(Sala*));
+    t->vizinhos = (int (*)[3]) malloc(((size_t) nSalas + 1) * sizeof(*t->vizinhos));
+    t->dist = (uint16_t*) malloc(((size_t) t->nSuspeitos * nSalas + 1) * sizeof(uint16_t));
+    int *fila = (int*) malloc(((size_t) nSalas + 1) * sizeof(int));
+    if (!t->salas || !t->vizinhos || !t->dist || !fila) {
+        fprintf(stderr, "Erro de alocacao distancias.\n"); exit(EXIT_FAILURE);
+    }
+    /* salas por id e vizinhos em vetor (ids de numerarSalas): as BFS não tocam nas salas */
+    int fim = 0;
+    if (raiz && nSalas > 0) {
+        t->salas[raiz->id] = raiz;
+        t->vizinhos[raiz->id][0] = -1;
+        fila[fim++] = raiz->id;
+    }
+    for (int ini = 0; ini < fim; ++ini) {
+        const Sala *s = t->salas[fila[ini]];
+        const Sala *filhos[2] = { s->esquerda, s->direita };
+        for (int k = 0; k < 2; ++k) {
+            t->vizinhos[s->id][k + 1] = filhos[k] ? filhos[k]->id : -1;
+            if (!filhos[k]) continue;
+            t->salas[filhos[k]->id] = filhos[k];
+            t->vizinhos[filhos[k]->id][0] = s->id;
+            fila[fim++] = filhos[k]->id;
+        }
+    }
+    for (int sp = 0; sp < t->nSuspeitos; ++sp) {
+        uint16_t *d = &t->dist[(size_t) sp * nSalas];
+        for (int i = 0; i < nSalas; ++i) d[i] = DISTANCIA_INFINITA;
+        int ini = 0;
+        fim = 0;
+        const SuspeitoIndice *si = &tabela->suspeitos[sp];
+        for (int i = 0; i < si->nPistas; ++i)
+            for (const SalaRef *r = entradaEm(tabela, si->pistas[i])->salas; r; r = r->prox)
+                if (d[r->sala->id] != 0) { d[r->sala->id] = 0; fila[fim++] = r->sala->id; }
+        for (; ini < fim; ++ini) {
+            int v = fila[ini];
+            /* distâncias que não cabem em 16 bits ficam no teto */
+            uint16_t prox = d[v] < DISTANCIA_MAXIMA ? (uint16_t) (d[v] + 1) : DISTANCIA_MAXIMA;
+            for (int k = 0; k < 3; ++k) {
+                int w = t->vizinhos[v][k];
+                if (w >= 0 && d[w] == DISTANCIA_INFINITA) {
+                    d[w] = prox;
+                    fila[fim++] = w;
+                }
+            }
+        }
+    }
+    free(fila);
+}
+
+/* proximoPassoPista() – vizinho de 'sala' um passo mais perto da pista (-1 se já está nela
+   ou se não há caminho); a consulta em si é distanciaPista(). */
+int proximoPassoPista(const TabelaDistancias *t, int suspeito, int sala) {
+    uint16_t d = distanciaPista(t, suspeito, sala);
+    if (d == 0 || d == DISTANCIA_INFINITA) return -1;
+    int melhor = -1;
+    for (int k = 0; k < 3; ++k) {
+        int w = t->vizinhos[sala][k];
+        if (w >= 0 && (melhor < 0 || distanciaPista(t, suspeito, w) < distanciaPista(t, suspeito, melhor)))
+            melhor = w;
+    }
+    return melhor;
+}
+
+void liberarDistancias(TabelaDistancias *t) {
+    free(t->salas);
+    free(t->vizinhos);
+    free(t->dist);
+    memset(t, 0, sizeof(*t));
+}
+
+/* exibirPistasProximas() – os suspeitos com pista mais perto da sala e o caminho a seguir. */
+void exibirPistasProximas(const TabelaDistancias *t, const TabelaHash *tabela, int sala) {
+    int mostrados = 0;
+    /* até 10 suspeitos, do mais perto ao mais longe: cada passada pega a menor distância
+       maior que a anterior */
+    for (uint32_t limite = 0; mostrados < 10 && limite < DISTANCIA_INFINITA; ) {
+        uint32_t proxima = DISTANCIA_INFINITA;
+        for (int sp = 0; sp < t->nSuspeitos && mostrados < 10; ++sp) {
+            uint16_t d = distanciaPista(t, sp, sala);
+            if (d > limite && d < proxima) proxima = d;
+            if (d != limite) continue;
+            int passo = proximoPassoPista(t, sp, sala);
+            if (d == 0) printf("  %s: pista nesta sala\n", tabela->suspeitos[sp].nome);
+            else printf("  %s: %u sala%s%s (siga para %s%s)\n", tabela->suspeitos[sp].nome, d, d > 1 ? "s" : "",
+                        d == DISTANCIA_MAXIMA ? " ou mais" : "", textoStr(&t->salas[passo]->nome),
+                        passo == t->vizinhos[sala][0] ? ", voltando" : "");
+            mostrados++;
+        }
+        limite = proxima;
+    }
+    if (mostrados == 0) printf("  Nenhuma pista alcancavel a partir daqui.\n");
+}
+
+/* ---------------------------
+   Rotas entre salas (k menores caminhos, Yen)
+   --------------------------- */
+
+static int compararLigacoes(const void *a, const void *b) {
+    const int *x = (const int*) a, *y = (const int*) b;
+    for (int i = 0; i < 3; ++i)
+        if (x[i] != y[i]) return x[i] < y[i] ? -1 : 1;
+    return 0;
+}
+
+/* montarMapaSalas() – grafo não dirigido das salas em CSR: ligações da árvore (custo 1) e
+   passagens extras. As salas precisam estar numeradas. */
+void montarMapaSalas(MapaSalas *m, const Sala *raiz, int nSalas, const Passagem *passagens, int nPassagens) {
+    memset(m, 0, sizeof(*m));
+    m->nSalas = nSalas;
+    m->salas = (const Sala**) malloc(((size_t) nSalas + 1) * sizeof(Sala*));
+    m->temPista = (uint8_t*) calloc((size_t) nSalas + 1, 1);
+    m->inicio = (int*) calloc((size_t) nSalas + 1, sizeof(int));
+    int maxArestas = 2 * (nSalas + nPassagens);
+    int *pares = (int*) malloc(((size_t) maxArestas + 1) * 3 * sizeof(int));
+    if (!m->salas || !m->temPista || !m->inicio || !pares) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+    int nPares = 0, topo = 0;
+    const Sala **pilha = (const Sala**) malloc(((size_t) nSalas + 1) * sizeof(Sala*));
+    if (!pilha) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+    if (raiz && nSalas > 0) pilha[topo++] = raiz;
+    while (topo > 0) {
+        const Sala *s = pilha[--topo];
+        m->salas[s->id] = s;
+        m->temPista[s->id] = s->pista.tam != 0;
+        const Sala *filhos[2] = { s->esquerda, s->direita };
+        for (int k = 0; k < 2; ++k) {
+            if (!filhos[k]) continue;
+            int *p = &pares[3 * nPares++];
+            p[0] = s->id; p[1] = filhos[k]->id; p[2] = 1;
+            pilha[topo++] = filhos[k];
+        }
+    }
+    free(pilha);
+    for (int i = 0; i < nPassagens; ++i) {
+        int *p = &pares[3 * nPares++];
+        p[0] = passagens[i].a->id; p[1] = passagens[i].b->id; p[2] = passagens[i].custo;
+    }
+    /* ligações repetidas entre as mesmas salas ficam só com a mais barata: assim uma
+       rota é identificada pela sequência de salas */
+    for (int i = 0; i < nPares; ++i)
+        if (pares[3 * i] > pares[3 * i + 1]) { int t = pares[3 * i]; pares[3 * i] = pares[3 * i + 1]; pares[3 * i + 1] = t; }
+    qsort(pares, (size_t) nPares, 3 * sizeof(int), compararLigacoes);
+    int unicas = 0;
+    for (int i = 0; i < nPares; ++i) {
+        if (unicas > 0 && pares[3 * i] == pares[3 * (unicas - 1)] && pares[3 * i + 1] == pares[3 * (unicas - 1) + 1]) continue;
+        memmove(&pares[3 * unicas++], &pares[3 * i], 3 * sizeof(int));
+    }
+    nPares = unicas;
+    /* cada ligação vira duas arestas dirigidas */
+    m->nArestas = 2 * nPares;
+    m->destino = (int*) malloc(((size_t) m->nArestas + 1) * sizeof(int));
+    m->custo = (int*) malloc(((size_t) m->nArestas + 1) * sizeof(int));
+    if (!m->destino || !m->custo) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < nPares; ++i) {
+        m->inicio[pares[3 * i]]++;
+        m->inicio[pares[3 * i + 1]]++;
+    }
+    for (int v = 0, soma = 0; v <= nSalas; ++v) { int c = m->inicio[v]; m->inicio[v] = soma; soma += c; }
+    for (int i = 0; i < nPares; ++i) {
+        int a = pares[3 * i], b = pares[3 * i + 1];
+        m->destino[m->inicio[a]] = b; m->custo[m->inicio[a]++] = pares[3 * i + 2];
+        m->destino[m->inicio[b]] = a; m->custo[m->inicio[b]++] = pares[3 * i + 2];
+    }
+    for (int v = nSalas; v > 0; --v) m->inicio[v] = m->inicio[v - 1];
+    m->inicio[0] = 0;
+    free(pares);
+}
+
+void liberarMapaSalas(MapaSalas *m) {
+    free(m->salas);
+    free(m->temPista);
+    free(m->inicio);
+    free(m->destino);
+    free(m->custo);
+    memset(m, 0, sizeof(*m));
+}
+
+/* Os nós da busca são (sala, camada): a camada passa a 1 ao entrar numa sala com pista,
+   e só existe quando a rota é obrigada a passar por uma. Nó = camada * nSalas + sala. */
+void iniciarBuscaRotas(BuscaRotas *b, const MapaSalas *m) {
+    memset(b, 0, sizeof(*b));
+    b->mapa = m;
+    size_t nos = 2 * (size_t) m->nSalas + 1, arestas = 2 * (size_t) m->nArestas + 1;
+    b->dist = (int*) malloc(nos * sizeof(int));
+    b->pai = (int*) malloc(nos * sizeof(int));
+    b->arestaPai = (int*) malloc(nos * sizeof(int));
+    b->potencial = (int*) malloc(nos * sizeof(int));
+    b->visto = (uint32_t*) calloc(nos, sizeof(uint32_t));
+    b->noBloqueado = (uint32_t*) calloc(nos, sizeof(uint32_t));
+    b->arestaBloqueada = (uint32_t*) calloc(arestas, sizeof(uint32_t));
+    b->capHeap = (int) (arestas + nos);
+    b->heap = (long long*) malloc((size_t) b->capHeap * sizeof(long long));
+    if (!b->dist || !b->pai || !b->arestaPai || !b->potencial || !b->visto || !b->noBloqueado || !b->arestaBloqueada || !b->heap) {
+        fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE);
+    }
+}
+
+void liberarBuscaRotas(BuscaRotas *b) {
+    free(b->dist); free(b->pai); free(b->arestaPai); free(b->potencial);
+    free(b->visto); free(b->noBloqueado); free(b->arestaBloqueada);
+    free(b->heap);
+    memset(b, 0, sizeof(*b));
+}
+
+/* Heap binário de (distância << 32 | nó); entradas velhas são ignoradas ao sair.
+   Cada relaxamento empilha de novo, então o heap dobra quando enche. */
+static void empilharHeap(BuscaRotas *b, int dist, int no) {
+    long long x = (long long) dist << 32 | (uint32_t) no;
+    if (b->nHeap == b->capHeap) {
+        b->capHeap = b->capHeap ? b->capHeap * 2 : 16;
+        b->heap = (long long*) realloc(b->heap, (size_t) b->capHeap * sizeof(long long));
+        if (!b->heap) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+    }
+    int i = b->nHeap++;
+    while (i > 0 && b->heap[(i - 1) / 2] > x) { b->heap[i] = b->heap[(i - 1) / 2]; i = (i - 1) / 2; }
+    b->heap[i] = x;
+}
+
+static long long desempilharHeap(BuscaRotas *b) {
+    long long topo = b->heap[0], x = b->heap[--b->nHeap];
+    int i = 0;
+    for (;;) {
+        int f = 2 * i + 1;
+        if (f >= b->nHeap) break;
+        if (f + 1 < b->nHeap && b->heap[f + 1] < b->heap[f]) f++;
+        if (b->heap[f] >= x) break;
+        b->heap[i] = b->heap[f];
+        i = f;
+    }
+    if (b->nHeap > 0) b->heap[i] = x;
+    return topo;
+}
+
+/* Distância de cada nó até o destino no grafo sem bloqueios (só as salas evitadas saem):
+   Dijkstra de trás para frente. Bloquear nós e arestas só aumenta distâncias, então ela
+   nunca superestima e serve de heurística exata o bastante para o A* das buscas de desvio. */
+static void calcularPotencial(BuscaRotas *b, int destino) {
+    const MapaSalas *m = b->mapa;
+    int nos = 2 * m->nSalas;
+    for (int v = 0; v < nos; ++v) b->potencial[v] = b->completo ? 0 : INT32_MAX;
+    if (b->completo) return; /* referência: Dijkstra sem heurística */
+    b->nHeap = 0;
+    b->potencial[destino] = 0;
+    empilharHeap(b, 0, destino);
+    while (b->nHeap > 0) {
+        long long x = desempilharHeap(b);
+        int d = (int) (x >> 32), w = (int) (uint32_t) x;
+        if (d > b->potencial[w]) continue;
+        int sala = w % m->nSalas, camada = w / m->nSalas;
+        /* entrar numa sala com pista leva à camada 1 vindo de qualquer camada; nas outras
+           salas a camada não muda */
+        int entra = b->exigirPista && m->temPista[sala];
+        if ((!b->exigirPista && camada == 1) || (entra && camada == 0)) continue;
+        for (int e = m->inicio[sala]; e < m->inicio[sala + 1]; ++e) {
+            int vizinha = m->destino[e];
+            if (b->evitar && b->evitar[vizinha]) continue;
+            for (int c = 0; c < 2; ++c) {
+                if (c != camada && !entra) continue;
+                int u = c * m->nSalas + vizinha, nd = d + m->custo[e];
+                if (nd < b->potencial[u]) {
+                    b->potencial[u] = nd;
+                    empilharHeap(b, nd, u);
+                }
+            }
+        }
+    }
+}
+
+/* A* de origem a destino evitando o que está bloqueado nesta rodada. Os vetores são da
+   busca inteira: o carimbo novo faz as marcas antigas valerem como "não visto". */
+static int buscarCaminhoRotas(BuscaRotas *b, int origem, int destino) {
+    const MapaSalas *m = b->mapa;
+    if (b->completo) memset(b->visto, 0, (2 * (size_t) m->nSalas + 1) * sizeof(uint32_t));
+    uint32_t c = ++b->carimbo;
+    b->nBuscas++;
+    b->nHeap = 0;
+    if (b->potencial[origem] == INT32_MAX) return 0;
+    b->visto[origem] = c;
+    b->dist[origem] = 0;
+    b->pai[origem] = -1;
+    empilharHeap(b, b->potencial[origem], origem);
+    while (b->nHeap > 0) {
+        long long x = desempilharHeap(b);
+        int u = (int) (uint32_t) x, d = b->dist[u];
+        if ((int) (x >> 32) > d + b->potencial[u]) continue;
+        b->nosFechados++;
+        if (u == destino) return 1;
+        int sala = u % m->nSalas, camada = u / m->nSalas;
+        for (int e = m->inicio[sala]; e < m->inicio[sala + 1]; ++e) {
+            int vizinha = m->destino[e];
+            if (b->evitar && b->evitar[vizinha]) continue;
+            int w = ((camada | (b->exigirPista && m->temPista[vizinha])) ? m->nSalas : 0) + vizinha;
+            if (b->noBloqueado[w] == b->bloqueio || b->arestaBloqueada[camada * m->nArestas + e] == b->bloqueio) continue;
+            if (b->potencial[w] == INT32_MAX) continue;
+            int nd = d + m->custo[e];
+            if (b->visto[w] == c && nd >= b->dist[w]) continue;
+            b->visto[w] = c;
+            b->dist[w] = nd;
+            b->pai[w] = u;
+            b->arestaPai[w] = e;
+            empilharHeap(b, nd + b->potencial[w], w);
+        }
+    }
+    return 0;
+}
+
+/* Rota de 'de' até o destino da última busca, nós e arestas, depois de um prefixo */
+static void montarRota(BuscaRotas *b, Rota *r, const Rota *prefixo, int tamPrefixo, int de, int destino) {
+    int n = 0;
+    for (int v = destino; v != de; v = b->pai[v]) n++;
+    r->n = tamPrefixo + n + 1;
+    r->nos = (int*) malloc((size_t) r->n * sizeof(int));
+    r->arestas = (int*) malloc((size_t) r->n * sizeof(int));
+    if (!r->nos || !r->arestas) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+    r->custo = 0;
+    for (int i = 0; i < tamPrefixo; ++i) {
+        r->nos[i] = prefixo->nos[i];
+        r->arestas[i] = prefixo->arestas[i];
+        r->custo += b->mapa->custo[prefixo->arestas[i]];
+    }
+    int i = r->n - 1;
+    r->arestas[i] = -1;
+    for (int v = destino; v != de; v = b->pai[v], --i) {
+        r->nos[i] = v;
+        r->arestas[i - 1] = b->arestaPai[v];
+        r->custo += b->mapa->custo[b->arestaPai[v]];
+    }
+    r->nos[i] = de;
+}
+
+static int mesmaRota(const Rota *a, const Rota *b) {
+    return a->n == b->n && memcmp(a->nos, b->nos, (size_t) a->n * sizeof(int)) == 0;
+}
+
+void liberarRota(Rota *r) {
+    free(r->nos);
+    free(r->arestas);
+    memset(r, 0, sizeof(*r));
+}
+
+/* buscarRotas() – algoritmo de Yen: a rota i+1 sai de um desvio de alguma rota anterior.
+   Para cada nó de desvio da última rota, bloqueia as arestas que as rotas já aceitas
+   tomam depois do mesmo prefixo e os nós do prefixo, e busca o resto. Só os desvios a
+   partir do ponto em que a última rota foi gerada são novos (Lawler); os anteriores já
+   estão entre os candidatos. b->completo desliga esse atalho, a heurística e o
+   reaproveitamento dos vetores (referência do benchmark). */
+int buscarRotas(BuscaRotas *b, int origem, int destino, int k, const uint8_t *evitar, int exigirPista, Rota *rotas) {
+    const MapaSalas *m = b->mapa;
+    if (k > MAX_ROTAS) k = MAX_ROTAS;
+    if (k < 1 || origem < 0 || destino < 0 || origem >= m->nSalas || destino >= m->nSalas) return 0;
+    if (evitar && (evitar[origem] || evitar[destino])) return 0;
+    b->evitar = evitar;
+    b->exigirPista = exigirPista;
+    int noOrigem = (exigirPista && m->temPista[origem] ? m->nSalas : 0) + origem;
+    int noDestino = (exigirPista ? m->nSalas : 0) + destino;
+
+    calcularPotencial(b, noDestino);
+    b->bloqueio++;
+    if (!buscarCaminhoRotas(b, noOrigem, noDestino)) return 0;
+    montarRota(b, &rotas[0], NULL, 0, noOrigem, noDestino);
+    rotas[0].desvio = 0;
+    int nRotas = 1;
+    Rota *candidatos = NULL;
+    int nCandidatos = 0, capCandidatos = 0;
+    while (nRotas < k) {
+        const Rota *ultima = &rotas[nRotas - 1];
+        for (int i = b->completo ? 0 : ultima->desvio; i < ultima->n - 1; ++i) {
+            b->bloqueio++;
+            for (int r = 0; r < nRotas; ++r)
+                if (rotas[r].n > i + 1 && memcmp(rotas[r].nos, ultima->nos, (size_t) (i + 1) * sizeof(int)) == 0)
+                    b->arestaBloqueada[(rotas[r].nos[i] / m->nSalas) * m->nArestas + rotas[r].arestas[i]] = b->bloqueio;
+            for (int j = 0; j < i; ++j) b->noBloqueado[ultima->nos[j]] = b->bloqueio;
+            if (!buscarCaminhoRotas(b, ultima->nos[i], noDestino)) continue;
+            Rota nova;
+            montarRota(b, &nova, ultima, i, ultima->nos[i], noDestino);
+            nova.desvio = i;
+            int repetida = 0;
+            for (int c = 0; c < nCandidatos && !repetida; ++c) repetida = mesmaRota(&candidatos[c], &nova);
+            if (repetida) { liberarRota(&nova); continue; }
+            if (nCandidatos == capCandidatos) {
+                capCandidatos = capCandidatos ? capCandidatos * 2 : 16;
+                candidatos = (Rota*) realloc(candidatos, (size_t) capCandidatos * sizeof(Rota));
+                if (!candidatos) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+            }
+            candidatos[nCandidatos++] = nova;
+        }
+        if (nCandidatos == 0) break;
+        int melhor = 0;
+        for (int c = 1; c < nCandidatos; ++c)
+            if (candidatos[c].custo < candidatos[melhor].custo
+                || (candidatos[c].custo == candidatos[melhor].custo && candidatos[c].n < candidatos[melhor].n))
+                melhor = c;
+        rotas[nRotas++] = candidatos[melhor];
+        candidatos[melhor] = candidatos[--nCandidatos];
+    }
+    for (int c = 0; c < nCandidatos; ++c) liberarRota(&candidatos[c]);
+    free(candidatos);
+    return nRotas;
+}
+
+/* exibirRotas() – uma linha por rota; salas com pista levam '*'. */
+void exibirRotas(const MapaSalas *m, const Rota *rotas, int n) {
+    for (int r = 0; r < n; ++r) {
+        printf("%d) custo %d:", r + 1, rotas[r].custo);
+        for (int i = 0; i < rotas[r].n; ++i) {
+            int sala = rotas[r].nos[i] % m->nSalas;
+            printf("%s %s%s", i ? " ->" : "", textoStr(&m->salas[sala]->nome), m->temPista[sala] ? "*" : "");
+        }
+        printf("\n");
+    }
+}
+
+/* ---------------------------
+   Esboços de frequência (count-min) entre sessões
+   --------------------------- */
+
+/* Posição da chave na linha d (hash duplo derivado de um único djb2) */
+static uint32_t posicaoEsboco(unsigned long h, int d) {
+    uint64_t x = misturarHash((uint64_t) h);
+    uint32_t a = (uint32_t) x, b = (uint32_t) (x >> 32) | 1u;
+    return (a + (uint32_t) d * b) & (CMS_LARGURA - 1);
+}
+
+/* registrarNoEsboco() – soma 1 à chave; seguro entre threads, sem trava. */
+void registrarNoEsboco(EsbocoFrequencia *e, const char *chave) {
+    unsigned long h = hash_string(chave);
+    for (int d = 0; d < CMS_PROFUNDIDADE; ++d)
+        atomic_fetch_add_explicit(&e->cont[d][posicaoEsboco(h, d)], 1u, memory_order_relaxed);
+    atomic_fetch_add_explicit(&e->total, 1u, memory_order_relaxed);
+}
+
+/* estimarFrequencia() – limite superior da contagem da chave (mínimo entre as linhas). */
+uint32_t estimarFrequencia(const EsbocoFrequencia *e, const char *chave) {
+    unsigned long h = hash_string(chave);
+    uint32_t menor = UINT32_MAX;
+    for (int d = 0; d < CMS_PROFUNDIDADE; ++d) {
+        uint32_t v = atomic_load_explicit(&e->cont[d][posicaoEsboco(h, d)], memory_order_relaxed);
+        if (v < menor) menor = v;
+    }
+    return menor;
+}
+
+/* mesclarEsbocos() – acumula 'origem' em 'destino' (esboços de outros processos). */
+void mesclarEsbocos(EsbocoFrequencia *destino, const EsbocoFrequencia *origem) {
+    for (int d = 0; d < CMS_PROFUNDIDADE; ++d)
+        for (int i = 0; i < CMS_LARGURA; ++i)
+            atomic_fetch_add_explicit(&destino->cont[d][i],
+                                      atomic_load_explicit(&origem->cont[d][i], memory_order_relaxed),
+                                      memory_order_relaxed);
+    atomic_fetch_add_explicit(&destino->total,
+                              atomic_load_explicit(&origem->total, memory_order_relaxed),
+                              memory_order_relaxed);
+}
+
+static void escreverEsboco(FILE *f, const EsbocoFrequencia *e) {
+    for (int d = 0; d < CMS_PROFUNDIDADE; ++d)
+        for (int i = 0; i < CMS_LARGURA; ++i) {
+            uint32_t v = atomic_load_explicit(&e->cont[d][i], memory_order_relaxed);
+            fwrite(&v, sizeof(v), 1, f);
+        }
+    uint64_t t = atomic_load_explicit(&e->total, memory_order_relaxed);
+    fwrite(&t, sizeof(t), 1, f);
+}
+
+static int lerEsboco(FILE *f, EsbocoFrequencia *e) {
+    for (int d = 0; d < CMS_PROFUNDIDADE; ++d)
+        for (int i = 0; i < CMS_LARGURA; ++i) {
+            uint32_t v;
+            if (fread(&v, sizeof(v), 1, f) != 1) return 0;
+            atomic_store_explicit(&e->cont[d][i], v, memory_order_relaxed);
+        }
+    uint64_t t;
+    if (fread(&t, sizeof(t), 1, f) != 1) return 0;
+    atomic_store_explicit(&e->total, t, memory_order_relaxed);
+    return 1;
+}
+
+/* salvarEstatisticas() – grava os dois esboços; retorna 0 em caso de erro. */
+int salvarEstatisticas(const Estatisticas *est, const char *arquivo) {
+    FILE *f = fopen(arquivo, "wb");
+    if (!f) return 0;
+    uint32_t dims[2] = { CMS_PROFUNDIDADE, CMS_LARGURA };
+    fwrite(CMS_MAGICO, 1, 4, f);
+    fwrite(dims, sizeof(dims), 1, f);
+    escreverEsboco(f, &est->visitasSalas);
+    escreverEsboco(f, &est->coletasPistas);
+    return fclose(f) == 0;
+}
+
+/* carregarEstatisticas() – lê um arquivo salvo por salvarEstatisticas().
+   Retorna 0 se o arquivo não existir ou tiver dimensões diferentes.
+*/
+int carregarEstatisticas(Estatisticas *est, const char *arquivo) {
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return 0;
+    char magico[4];
+    uint32_t dims[2];
+    int ok = fread(magico, 1, 4, f) == 4 && memcmp(magico, CMS_MAGICO, 4) == 0
+          && fread(dims, sizeof(dims), 1, f) == 1
+          && dims[0] == CMS_PROFUNDIDADE && dims[1] == CMS_LARGURA
+          && lerEsboco(f, &est->visitasSalas) && lerEsboco(f, &est->coletasPistas);
+    fclose(f);
+    return ok;
+}
+
+Estatisticas* criarEstatisticas(void) {
+    Estatisticas *est = (Estatisticas*) calloc(1, sizeof(Estatisticas));
+    if (!est) { fprintf(stderr, "Erro de alocacao estatisticas.\n"); exit(EXIT_FAILURE); }
+    return est;
+}
+
+typedef struct candidato {
+    const char *nome;
+    uint32_t estimativa;
+} Candidato;
+
+static int compararCandidato(const void *a, const void *b) {
+    const Candidato *x = (const Candidato*) a, *y = (const Candidato*) b;
+    if (x->estimativa != y->estimativa) return x->estimativa < y->estimativa ? 1 : -1;
+    return strcmp(x->nome, y->nome);
+}
+
+/* listarMaisFrequentes() – imprime as k chaves mais frequentes entre os candidatos.
+   O esboço não guarda as chaves, então os candidatos vêm do caso carregado
+   (nomes das salas ou textos das pistas).
+*/
+void listarMaisFrequentes(const EsbocoFrequencia *e, const char *candidatos[], int n, int k) {
+    if (n <= 0) return;
+    Candidato *v = (Candidato*) malloc(n * sizeof(Candidato));
+    if (!v) { fprintf(stderr, "Erro de alocacao estatisticas.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < n; ++i) {
+        v[i].nome = candidatos[i];
+        v[i].estimativa = estimarFrequencia(e, candidatos[i]);
+    }
+    qsort(v, n, sizeof(Candidato), compararCandidato);
+    uint64_t total = atomic_load_explicit(&e->total, memory_order_relaxed);
+    for (int i = 0; i < n && i < k; ++i) {
+        if (v[i].estimativa == 0) break;
+        printf(" %2d. %-32s ~%u (%.1f%%)\n", i + 1, v[i].nome, v[i].estimativa,
+               total ? 100.0 * v[i].estimativa / (double) total : 0.0);
+    }
+    free(v);
+}
+
+/* numerarSalas() – atribui ids em pré-ordem às salas; retorna a quantidade. */
+static void numerarSalasRec(Sala *s, int *proximo) {
+    if (!s) return;
+    s->id = (*proximo)++;
+    numerarSalasRec(s->esquerda, proximo);
+    numerarSalasRec(s->direita, proximo);
+}
+
+int numerarSalas(Sala *raiz) {
+    int n = 0;
+    numerarSalasRec(raiz, &n);
+    return n;
+}
+
+/* ---------------------------
+   Mapa de calor exato (contadores por thread + mesclagem periódica)
+   --------------------------- */
+
+static _Atomic uint64_t* alocarContadores(int n) {
+    size_t bytes = ((size_t) (n > 0 ? n : 1) * sizeof(uint64_t) + LINHA_CACHE - 1) / LINHA_CACHE * LINHA_CACHE;
+    _Atomic uint64_t *v = (_Atomic uint64_t*) aligned_alloc(LINHA_CACHE, bytes);
+    if (!v) { fprintf(stderr, "Erro de alocacao mapa de calor.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < n; ++i) atomic_init(&v[i], 0);
+    return v;
+}
+
+/* Fragmento da thread atual (registrado no primeiro uso). Cada thread só escreve
+   no seu, então o incremento é load + store relaxados, sem instrução travada.
+   O fragmento é do mapa, identificado pelo id da thread: trocar de mapa e voltar
+   reencontra o mesmo. O cache da thread guarda a geração do mapa, não o endereço,
+   então um mapa novo alocado no lugar de um liberado nunca herda o fragmento antigo. */
+static _Atomic uint64_t proximoIdThread = 1;
+static _Atomic uint64_t proximaGeracaoMapa = 1;
+static _Thread_local uint64_t idThread = 0;
+static _Thread_local ShardContadores *shardLocal = NULL;
+static _Thread_local uint64_t geracaoDoShard = 0;
+
+static ShardContadores* procurarShard(MapaCalor *m, int n) {
+    for (int s = 0; s < n; ++s)
+        if (m->shards[s].dono == idThread) return &m->shards[s];
+    return NULL;
+}
+
+static ShardContadores* obterShard(MapaCalor *m) {
+    if (geracaoDoShard == m->geracao) return shardLocal;
+    if (idThread == 0) idThread = atomic_fetch_add(&proximoIdThread, 1);
+    ShardContadores *sh = procurarShard(m, atomic_load_explicit(&m->nShards, memory_order_acquire));
+    if (!sh) {
+        pthread_mutex_lock(&m->trava);
+        int n = atomic_load_explicit(&m->nShards, memory_order_relaxed);
+        if (n < MAX_SHARDS) {
+            sh = &m->shards[n];
+            sh->visitas = alocarContadores(m->nSalas);
+            sh->coletas = alocarContadores(m->nPistas);
+            sh->dono = idThread;
+            atomic_store_explicit(&m->nShards, n + 1, memory_order_release);
+        } else {
+            /* sem fragmento próprio: divide o comum, com incremento atômico */
+            sh = &m->comum;
+            if (!atomic_load_explicit(&m->temComum, memory_order_relaxed)) {
+                sh->visitas = alocarContadores(m->nSalas);
+                sh->coletas = alocarContadores(m->nPistas);
+                sh->dono = 0;
+                atomic_store_explicit(&m->temComum, 1, memory_order_release);
+            }
+        }
+        pthread_mutex_unlock(&m->trava);
+    }
+    shardLocal = sh;
+    geracaoDoShard = m->geracao;
+    return sh;
+}
+
+static void incrementar(const ShardContadores *sh, _Atomic uint64_t *c) {
+    if (sh->dono == 0) atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+    else atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void registrarVisita(MapaCalor *m, int idSala) {
+    if (idSala < 0 || idSala >= m->nSalas) return;
+    ShardContadores *sh = obterShard(m);
+    incrementar(sh, &sh->visitas[idSala]);
+}
+
+void registrarColeta(MapaCalor *m, int idPista) {
+    if (idPista < 0 || idPista >= m->nPistas) return;
+    ShardContadores *sh = obterShard(m);
+    incrementar(sh, &sh->coletas[idPista]);
+}
+
+/* mesclarMapaCalor() – soma todos os fragmentos num novo retrato. */
+void mesclarMapaCalor(MapaCalor *m) {
+    uint64_t *visitas = (uint64_t*) calloc(m->nSalas ? m->nSalas : 1, sizeof(uint64_t));
+    uint64_t *coletas = (uint64_t*) calloc(m->nPistas ? m->nPistas : 1, sizeof(uint64_t));
+    if (!visitas || !coletas) { fprintf(stderr, "Erro de alocacao mapa de calor.\n"); exit(EXIT_FAILURE); }
+    int n = atomic_load_explicit(&m->nShards, memory_order_acquire);
+    int comum = atomic_load_explicit(&m->temComum, memory_order_acquire);
+    for (int s = 0; s < n + comum; ++s) {
+        const ShardContadores *sh = s < n ? &m->shards[s] : &m->comum;
+        for (int i = 0; i < m->nSalas; ++i)
+            visitas[i] += atomic_load_explicit(&sh->visitas[i], memory_order_relaxed);
+        for (int i = 0; i < m->nPistas; ++i)
+            coletas[i] += atomic_load_explicit(&sh->coletas[i], memory_order_relaxed);
+    }
+    pthread_mutex_lock(&m->trava);
+    free(m->visitas); free(m->coletas);
+    m->visitas = visitas;
+    m->coletas = coletas;
+    pthread_mutex_unlock(&m->trava);
+}
+
+static void* lacoMesclador(void *arg) {
+    MapaCalor *m = (MapaCalor*) arg;
+    pthread_mutex_lock(&m->trava);
+    while (m->ativo) {
+        struct timespec ate;
+        clock_gettime(CLOCK_REALTIME, &ate);
+        ate.tv_sec += m->intervaloMs / 1000;
+        ate.tv_nsec += (long) (m->intervaloMs % 1000) * 1000000L;
+        if (ate.tv_nsec >= 1000000000L) { ate.tv_sec++; ate.tv_nsec -= 1000000000L; }
+        pthread_cond_timedwait(&m->sinal, &m->trava, &ate);
+        if (!m->ativo) break;
+        pthread_mutex_unlock(&m->trava);
+        mesclarMapaCalor(m);
+        pthread_mutex_lock(&m->trava);
+    }
+    pthread_mutex_unlock(&m->trava);
+    return NULL;
+}
+
+/* criarMapaCalor() – contadores para nSalas salas e nPistas pistas (ids 0..n-1);
+   se intervaloMs > 0, uma thread mescla os fragmentos periodicamente. */
+MapaCalor* criarMapaCalor(int nSalas, int nPistas, unsigned intervaloMs) {
+    MapaCalor *m = (MapaCalor*) calloc(1, sizeof(MapaCalor));
+    if (!m) { fprintf(stderr, "Erro de alocacao mapa de calor.\n"); exit(EXIT_FAILURE); }
+    m->nSalas = nSalas;
+    m->nPistas = nPistas;
+    atomic_init(&m->nShards, 0);
+    atomic_init(&m->temComum, 0);
+    m->geracao = atomic_fetch_add(&proximaGeracaoMapa, 1);
+    pthread_mutex_init(&m->trava, NULL);
+    pthread_cond_init(&m->sinal, NULL);
+    m->intervaloMs = intervaloMs;
+    mesclarMapaCalor(m);
+    if (intervaloMs > 0) {
+        m->ativo = 1;
+        if (pthread_create(&m->mesclador, NULL, lacoMesclador, m) != 0) {
+            fprintf(stderr, "Aviso: mesclagem periodica indisponivel.\n");
+            m->ativo = 0;
+        }
+    }
+    return m;
+}
+
+/* liberarMapaCalor() – para o mesclador; as threads que usaram o mapa já devem ter terminado. */
+void liberarMapaCalor(MapaCalor *m) {
+    if (!m) return;
+    pthread_mutex_lock(&m->trava);
+    int tinhaThread = m->ativo;
+    m->ativo = 0;
+    pthread_cond_signal(&m->sinal);
+    pthread_mutex_unlock(&m->trava);
+    if (tinhaThread) pthread_join(m->mesclador, NULL);
+
+    int n = atomic_load(&m->nShards);
+    for (int s = 0; s < n; ++s) {
+        free((void*) m->shards[s].visitas);
+        free((void*) m->shards[s].coletas);
+    }
+    if (atomic_load(&m->temComum)) {
+        free((void*) m->comum.visitas);
+        free((void*) m->comum.coletas);
+    }
+    pthread_mutex_destroy(&m->trava);
+    pthread_cond_destroy(&m->sinal);
+    free(m->visitas); free(m->coletas);
+    free(m);
+}
+
+static void exportarSalasRec(FILE *f, const Sala *s, const uint64_t *visitas, int nSalas) {
+    if (!s) return;
+    if (s->id >= 0 && s->id < nSalas)
+        fprintf(f, "sala;%d;%s;%llu\n", s->id, textoStr(&s->nome), (unsigned long long) visitas[s->id]);
+    exportarSalasRec(f, s->esquerda, visitas, nSalas);
+    exportarSalasRec(f, s->direita, visitas, nSalas);
+}
+
+/* exportarMapaCalor() – grava o último retrato mesclado em CSV (tipo;id;nome;contagem).
+   Retorna 0 se o arquivo não puder ser gravado. */
+int exportarMapaCalor(MapaCalor *m, const char *arquivo, const Sala *raiz, const TabelaHash *tabela) {
+    FILE *f = fopen(arquivo, "w");
+    if (!f) return 0;
+    pthread_mutex_lock(&m->trava);
+    fprintf(f, "tipo;id;nome;contagem\n");
+    exportarSalasRec(f, raiz, m->visitas, m->nSalas);
+    IteradorTabela it;
+    iniciarIterador(&it, tabela);
+    for (const HashEntry *at; (at = proximaEntrada(&it)); )
+        if (at->id < m->nPistas)
+            fprintf(f, "pista;%d;%s;%llu\n", at->id, textoStr(&at->pista), (unsigned long long) m->coletas[at->id]);
+    pthread_mutex_unlock(&m->trava);
+    return fclose(f) == 0;
+}
+
+/* ---------------------------
+   Diário assíncrono de eventos
+   --------------------------- */
+
+static int gravarTudo(int fd, const char *d, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, d, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        d += w;
+        n -= (size_t) w;
+    }
+    return 1;
+}
+
+/* Thread escritora: tudo que chegou enquanto o lote anterior ia para o disco
+   sai junto na próxima gravação. */
+static void* lacoEscritorDiario(void *arg) {
+    Diario *d = (Diario*) arg;
+    pthread_mutex_lock(&d->trava);
+    for (;;) {
+        while (d->usado[d->ativo] == 0 && !d->encerrar)
+            pthread_cond_wait(&d->temEventos, &d->trava);
+        int lote = d->ativo;
+        if (d->usado[lote] == 0) break; /* encerrando e nada pendente */
+        d->ativo = 1 - lote;
+        pthread_mutex_unlock(&d->trava);
+
+        int ok = gravarTudo(d->fd, d->lotes[lote], d->usado[lote]) && fdatasync(d->fd) == 0;
+
+        pthread_mutex_lock(&d->trava);
+        if (!ok) d->erro = 1;
+        d->usado[lote] = 0;
+        d->gravacoes++;
+    }
+    pthread_mutex_unlock(&d->trava);
+    return NULL;
+}
+
+Diario* abrirDiario(const char *arquivo) {
+    int fd = open(arquivo, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return NULL;
+    Diario *d = (Diario*) calloc(1, sizeof(Diario));
+    if (!d) { fprintf(stderr, "Erro de alocacao diario.\n"); exit(EXIT_FAILURE); }
+    d->fd = fd;
+    for (int i = 0; i < 2; ++i) {
+        d->lotes[i] = (char*) malloc(DIARIO_LOTE);
+        if (!d->lotes[i]) { fprintf(stderr, "Erro de alocacao diario.\n"); exit(EXIT_FAILURE); }
+        d->cap[i] = DIARIO_LOTE;
+    }
+    pthread_mutex_init(&d->trava, NULL);
+    pthread_cond_init(&d->temEventos, NULL);
+    if (pthread_create(&d->escritor, NULL, lacoEscritorDiario, d) != 0) {
+        fprintf(stderr, "Erro ao iniciar a thread do diario.\n");
+        exit(EXIT_FAILURE);
+    }
+    return d;
+}
+
+/* registrarEventoDiario() – acrescenta "tempo pid tipo sala detalhe" (separados por TAB)
+   ao lote em memória. Nunca espera o disco: se a escritora estiver atrasada, o buffer
+   ativo cresce em vez de bloquear o jogo.
+*/
+void registrarEventoDiario(Diario *d, const char *tipo, const char *sala, const char *detalhe) {
+    char linha[2 * MAX_PISTA + 64];
+    struct timespec agora;
+    clock_gettime(CLOCK_REALTIME, &agora);
+    int n = snprintf(linha, sizeof(linha), "%lld.%09ld\t%ld\t%s\t%s\t%s\n",
+                     (long long) agora.tv_sec, agora.tv_nsec, (long) getpid(),
+                     tipo, sala ? sala : "", detalhe ? detalhe : "");
+    if (n < 0) return;
+    if ((size_t) n >= sizeof(linha)) { n = sizeof(linha) - 1; linha[n - 1] = '\n'; }
+
+    pthread_mutex_lock(&d->trava);
+    int a = d->ativo;
+    if (d->usado[a] + (size_t) n > d->cap[a]) {
+        size_t cap = d->cap[a] * 2;
+        char *novo = (char*) realloc(d->lotes[a], cap);
+        if (!novo) { fprintf(stderr, "Erro de alocacao diario.\n"); exit(EXIT_FAILURE); }
+        d->lotes[a] = novo;
+        d->cap[a] = cap;
+    }
+    /* a escritora só dorme com o buffer ativo vazio: basta acordá-la no primeiro evento */
+    if (d->usado[a] == 0) pthread_cond_signal(&d->temEventos);
+    memcpy(d->lotes[a] + d->usado[a], linha, (size_t) n);
+    d->usado[a] += (size_t) n;
+    d->eventos++;
+    pthread_mutex_unlock(&d->trava);
+}
+
+void fecharDiario(Diario *d) {
+    if (!d) return;
+    pthread_mutex_lock(&d->trava);
+    d->encerrar = 1;
+    pthread_cond_signal(&d->temEventos);
+    pthread_mutex_unlock(&d->trava);
+    pthread_join(d->escritor, NULL);
+    if (close(d->fd) != 0) d->erro = 1;
+    if (d->erro) fprintf(stderr, "Erro ao gravar o diario.\n");
+    pthread_mutex_destroy(&d->trava);
+    pthread_cond_destroy(&d->temEventos);
+    free(d->lotes[0]);
+    free(d->lotes[1]);
+    free(d);
+}
+
+/* ---------------------------
+   Registro colunar de sessões
+   --------------------------- */
+
+static void* crescerVetor(void *v, int *cap, int minimo, size_t tamElem) {
+    if (*cap >= minimo) return v;
+    int novo = *cap ? *cap : 8;
+    while (novo < minimo) novo *= 2;
+    v = realloc(v, (size_t) novo * tamElem);
+    if (!v) { fprintf(stderr, "Erro de alocacao sessoes.\n"); exit(EXIT_FAILURE); }
+    *cap = novo;
+    return v;
+}
+
+/* registrarPassoSessao() – anexa a sala (e a pista, na primeira coleta) ao registro. */
+void registrarPassoSessao(RegistroSessao *r, const Sala *sala) {
+    r->salas = (const char**) crescerVetor((void*) r->salas, &r->capSalas, r->nSalas + 1, sizeof(char*));
+    r->salas[r->nSalas++] = textoStr(&sala->nome);
+    if (sala->pista.tam == 0) return;
+    for (int i = 0; i < r->nPistas; ++i)
+        if (strcmp(r->pistas[i], textoStr(&sala->pista)) == 0) return;
+    r->pistas = (const char**) crescerVetor((void*) r->pistas, &r->capPistas, r->nPistas + 1, sizeof(char*));
+    r->pistas[r->nPistas++] = textoStr(&sala->pista);
+}
+
+void liberarRegistroSessao(RegistroSessao *r) {
+    free((void*) r->salas);
+    free((void*) r->pistas);
+    memset(r, 0, sizeof(*r));
+    r->veredicto = VEREDICTO_SEM_ACUSACAO;
+}
+
+static int posicaoNoDicionario(const Dicionario *d, const char *nome) {
+    for (int i = 0; i < d->n; ++i)
+        if (strcmp(d->nomes[i], nome) == 0) return i;
+    return -1;
+}
+
+/* id do nome no dicionário da coluna; insere se ainda não existir */
+static int idNoDicionario(Dicionario *d, const char *nome) {
+    for (int i = 0; i < d->n; ++i)
+        if (strcmp(d->nomes[i], nome) == 0) return i;
+    d->nomes = (char**) crescerVetor(d->nomes, &d->cap, d->n + 1, sizeof(char*));
+    d->nomes[d->n] = duplicarTexto(nome);
+    return d->n++;
+}
+
+/* garante espaço nas colunas de tamanho fixo por sessão (offsets têm uma posição a mais) */
+static void reservarSessoes(TabelaSessoes *ts, int minimo) {
+    if (ts->capSessoes >= minimo + 1) return;
+    int novo = ts->capSessoes ? ts->capSessoes : 8;
+    while (novo < minimo + 1) novo *= 2;
+    ts->inicioCaminho = (uint32_t*) realloc(ts->inicioCaminho, (size_t) novo * sizeof(uint32_t));
+    ts->inicioPistas = (uint32_t*) realloc(ts->inicioPistas, (size_t) novo * sizeof(uint32_t));
+    ts->acusado = (int32_t*) realloc(ts->acusado, (size_t) novo * sizeof(int32_t));
+    ts->veredicto = (uint8_t*) realloc(ts->veredicto, (size_t) novo);
+    if (!ts->inicioCaminho || !ts->inicioPistas || !ts->acusado || !ts->veredicto) {
+        fprintf(stderr, "Erro de alocacao sessoes.\n");
+        exit(EXIT_FAILURE);
+    }
+    ts->capSessoes = novo;
+}
+
+/* anexarSessao() – acrescenta a sessão concluída às colunas (codificando por dicionário). */
+void anexarSessao(TabelaSessoes *ts, const RegistroSessao *r) {
+    int n = ts->nSessoes;
+    reservarSessoes(ts, n + 1);
+    if (n == 0) { ts->inicioCaminho[0] = 0; ts->inicioPistas[0] = 0; }
+
+    ts->caminho = (int32_t*) crescerVetor(ts->caminho, &ts->capCaminho, ts->nCaminho + r->nSalas, sizeof(int32_t));
+    for (int i = 0; i < r->nSalas; ++i) ts->caminho[ts->nCaminho++] = idNoDicionario(&ts->dicSalas, r->salas[i]);
+    ts->pistas = (int32_t*) crescerVetor(ts->pistas, &ts->capPistas, ts->nPistas + r->nPistas, sizeof(int32_t));
+    for (int i = 0; i < r->nPistas; ++i) ts->pistas[ts->nPistas++] = idNoDicionario(&ts->dicPistas, r->pistas[i]);
+
+    ts->inicioCaminho[n+1] = (uint32_t) ts->nCaminho;
+    ts->inicioPistas[n+1] = (uint32_t) ts->nPistas;
+    ts->acusado[n] = r->acusado[0] ? idNoDicionario(&ts->dicSuspeitos, r->acusado) : -1;
+    ts->veredicto[n] = (uint8_t) r->veredicto;
+    ts->nSessoes++;
+}
+
+void liberarTabelaSessoes(TabelaSessoes *ts) {
+    Dicionario *dics[3] = { &ts->dicSalas, &ts->dicPistas, &ts->dicSuspeitos };
+    for (int d = 0; d < 3; ++d) {
+        for (int i = 0; i < dics[d]->n; ++i) free(dics[d]->nomes[i]);
+        free(dics[d]->nomes);
+    }
+    free(ts->inicioCaminho); free(ts->caminho);
+    free(ts->inicioPistas); free(ts->pistas);
+    free(ts->acusado); free(ts->veredicto);
+    memset(ts, 0, sizeof(*ts));
+}
+
+/* Buffer de bytes crescente usado na codificação das colunas */
+typedef struct buffer {
+    unsigned char *d;
+    size_t n, cap;
+} Buffer;
+
+static void bufReservar(Buffer *b, size_t extra) {
+    if (b->n + extra <= b->cap) return;
+    size_t novo = b->cap ? b->cap : 256;
+    while (novo < b->n + extra) novo *= 2;
+    b->d = (unsigned char*) realloc(b->d, novo);
+    if (!b->d) { fprintf(stderr, "Erro de alocacao buffer.\n"); exit(EXIT_FAILURE); }
+    b->cap = novo;
+}
+
+static void bufVarint(Buffer *b, uint32_t v) {
+    bufReservar(b, 5);
+    b->n += escreverVarint(b->d + b->n, v);
+}
+
+static void bufBytes(Buffer *b, const void *p, size_t n) {
+    bufReservar(b, n);
+    memcpy(b->d + b->n, p, n);
+    b->n += n;
+}
+
+/* zigue-zague: deltas negativos pequenos viram varints curtos */
+static uint32_t zigue(int32_t v) { return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31); }
+static int32_t zague(uint32_t v) { return (int32_t) (v >> 1) ^ -(int32_t) (v & 1); }
+
+/* Leitura com limite (arquivo pode estar truncado ou corrompido) */
+typedef struct leitor {
+    const unsigned char *p, *fim;
+    int erro;
+} Leitor;
+
+static uint32_t lerVarintLimitado(Leitor *l) {
+    uint32_t v = 0;
+    for (int desloc = 0; desloc < 35; desloc += 7) {
+        if (l->p >= l->fim) { l->erro = 1; return 0; }
+        unsigned char c = *l->p++;
+        v |= (uint32_t) (c & 0x7F) << desloc;
+        if (!(c & 0x80)) return v;
+    }
+    l->erro = 1;
+    return 0;
+}
+
+static void escreverDicionario(Buffer *b, const Dicionario *d) {
+    bufVarint(b, (uint32_t) d->n);
+    for (int i = 0; i < d->n; ++i) {
+        uint32_t L = (uint32_t) strlen(d->nomes[i]);
+        bufVarint(b, L);
+        bufBytes(b, d->nomes[i], L);
+    }
+}
+
+static int lerDicionario(Leitor *l, Dicionario *d) {
+    uint32_t n = lerVarintLimitado(l);
+    for (uint32_t i = 0; i < n && !l->erro; ++i) {
+        uint32_t L = lerVarintLimitado(l);
+        if (l->erro || L > (size_t) (l->fim - l->p)) { l->erro = 1; break; }
+        char *nome = (char*) malloc(L + 1);
+        if (!nome) { fprintf(stderr, "Erro de alocacao sessoes.\n"); exit(EXIT_FAILURE); }
+        memcpy(nome, l->p, L);
+        nome[L] = '\0';
+        l->p += L;
+        d->nomes = (char**) crescerVetor(d->nomes, &d->cap, d->n + 1, sizeof(char*));
+        d->nomes[d->n++] = nome;
+    }
+    return !l->erro;
+}
+
+/* coluna de listas por sessão: tamanhos em varint, depois ids em delta zigue-zague */
+static void escreverColunaListas(Buffer *b, const uint32_t *inicio, const int32_t *ids, int nSessoes) {
+    Buffer col = { NULL, 0, 0 };
+    for (int s = 0; s < nSessoes; ++s) bufVarint(&col, inicio[s+1] - inicio[s]);
+    for (int s = 0; s < nSessoes; ++s) {
+        int32_t anterior = 0;
+        for (uint32_t i = inicio[s]; i < inicio[s+1]; ++i) {
+            bufVarint(&col, zigue(ids[i] - anterior));
+            anterior = ids[i];
+        }
+    }
+    bufVarint(b, (uint32_t) col.n);
+    bufBytes(b, col.d, col.n);
+    free(col.d);
+}
+
+/* lê a coluna [tamanho em bytes][bytes] de 'l' num leitor só dela */
+static int lerColunaDelimitada(Leitor *l, Leitor *col) {
+    uint32_t bytes = lerVarintLimitado(l);
+    if (l->erro || bytes > (size_t) (l->fim - l->p)) return 0;
+    col->p = l->p;
+    col->fim = l->p + bytes;
+    col->erro = 0;
+    l->p += bytes;
+    return 1;
+}
+
+/* decodifica a coluna de listas 'col' acrescentando os ids aos já existentes;
+   na entrada inicio[0] deve valer *nIds */
+static int lerColunaListas(Leitor *col, uint32_t *inicio, int32_t **ids, int *capIds, size_t *nIds,
+                           int nSessoes, int tamDicionario) {
+    size_t bytes = (size_t) (col->fim - col->p);
+    /* cada id ocupa ao menos 1 byte, então 'bytes' limita a coluna inteira; o total
+       acumulado também precisa caber nos offsets de 32 bits e em crescerVetor */
+    if (bytes > (size_t) (INT_MAX / 2) - inicio[0]) return 0;
+    for (int s = 0; s < nSessoes; ++s) {
+        uint32_t tam = lerVarintLimitado(col);
+        /* checar a cada passo também impede que a soma dê a volta */
+        if (col->erro || tam > bytes - (inicio[s] - inicio[0])) return 0;
+        inicio[s+1] = inicio[s] + tam;
+    }
+    *ids = (int32_t*) crescerVetor(*ids, capIds, (int) inicio[nSessoes], sizeof(int32_t));
+    for (int s = 0; s < nSessoes; ++s) {
+        int64_t anterior = 0;
+        for (uint32_t i = inicio[s]; i < inicio[s+1]; ++i) {
+            anterior += zague(lerVarintLimitado(col));
+            if (col->erro || anterior < 0 || anterior >= tamDicionario) return 0;
+            (*ids)[i] = (int32_t) anterior;
+        }
+    }
+    *nIds = inicio[nSessoes];
+    return !col->erro;
+}
+
+/* ---------------------------
+   Compressão LZ em blocos
+   --------------------------- */
+
+/* Formato de bloco (estilo LZ4): sequências de
+     token (4 bits literais | 4 bits repetição), [extensão do nº de literais],
+     literais, distância (2 bytes, little-endian), [extensão da repetição]
+   Um campo de 4 bits igual a 15 continua em bytes de 255 até um byte < 255.
+   A repetição mede (token & 15) + LZ_MIN_REPETICAO. A última sequência tem só
+   literais e termina no fim do bloco; os LZ_FIM_LITERAIS bytes finais nunca
+   fazem parte de repetição, o que deixa o descompressor copiar de 8 em 8 bytes. */
+
+/* Pior caso de comprimirBloco() para n bytes de entrada */
+#define LZ_LIMITE_COMPRIMIDO(n) ((n) + (n) / 255 + 16)
+
+static uint32_t ler32(const unsigned char *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint64_t ler64(const unsigned char *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+
+static uint32_t hashLz(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_BITS_HASH);
+}
+
+static unsigned char* escreverExtensaoLz(unsigned char *o, size_t n) {
+    while (n >= 255) { *o++ = 255; n -= 255; }
+    *o++ = (unsigned char) n;
+    return o;
+}
+
+static unsigned char* escreverSequenciaLz(unsigned char *o, const unsigned char *literais, size_t nLit,
+                                          size_t distancia, size_t extra) {
+    unsigned char *token = o++;
+    *token = (unsigned char) ((nLit >= 15 ? 15 : nLit) << 4);
+    if (nLit >= 15) o = escreverExtensaoLz(o, nLit - 15);
+    memcpy(o, literais, nLit);
+    o += nLit;
+    if (distancia == 0) return o; /* última sequência */
+    *token |= (unsigned char) (extra >= 15 ? 15 : extra);
+    *o++ = (unsigned char) (distancia & 0xFF);
+    *o++ = (unsigned char) (distancia >> 8);
+    if (extra >= 15) o = escreverExtensaoLz(o, extra - 15);
+    return o;
+}
+
+/* comprimirBloco() – comprime n bytes (n <= LZ_BLOCO) em dst, que precisa de
+   LZ_LIMITE_COMPRIMIDO(n) bytes. Busca gulosa com uma tabela hash de 4 bytes;
+   depois de muitas falhas seguidas o passo cresce (dados que não comprimem passam rápido).
+   Retorna o tamanho comprimido.
+*/
+size_t comprimirBloco(const unsigned char *src, size_t n, unsigned char *dst) {
+    uint32_t candidatos[1 << LZ_BITS_HASH];
+    memset(candidatos, 0, sizeof(candidatos));
+    const unsigned char *ip = src, *ancora = src, *fim = src + n;
+    const unsigned char *limiteInicio = n > LZ_MARGEM_REPETICAO ? fim - LZ_MARGEM_REPETICAO : src;
+    const unsigned char *limiteRepeticao = fim - LZ_FIM_LITERAIS;
+    unsigned char *op = dst;
+    unsigned falhas = 0;
+
+    while (ip < limiteInicio) {
+        uint32_t seq = ler32(ip);
+        uint32_t h = hashLz(seq);
+        const unsigned char *cand = src + candidatos[h];
+        candidatos[h] = (uint32_t) (ip - src);
+        if (cand >= ip || ip - cand > LZ_JANELA || ler32(cand) != seq) {
+            ip += 1 + (falhas++ >> 6);
+            continue;
+        }
+        falhas = 0;
+        /* estende a repetição 8 bytes por vez */
+        const unsigned char *m = ip + LZ_MIN_REPETICAO, *c = cand + LZ_MIN_REPETICAO;
+        while (m + 8 <= limiteRepeticao) {
+            uint64_t dif = ler64(m) ^ ler64(c);
+            if (dif) { m += __builtin_ctzll(dif) >> 3; goto estendida; }
+            m += 8; c += 8;
+        }
+        while (m < limiteRepeticao && *m == *c) { m++; c++; }
+    estendida:
+        /* volta enquanto os bytes anteriores também batem */
+        while (ip > ancora && cand > src && ip[-1] == cand[-1]) { ip--; cand--; }
+        op = escreverSequenciaLz(op, ancora, (size_t) (ip - ancora), (size_t) (ip - cand),
+                                 (size_t) (m - ip) - LZ_MIN_REPETICAO);
+        if (m - 2 > src && m + 2 <= fim)
+            candidatos[hashLz(ler32(m - 2))] = (uint32_t) (m - 2 - src);
+        ip = ancora = m;
+    }
+    op = escreverSequenciaLz(op, ancora, (size_t) (fim - ancora), 0, 0);
+    return (size_t) (op - dst);
+}
+
+/* descomprimirBloco() – descomprime em dst (cap bytes); retorna o tamanho ou -1 se o
+   bloco estiver corrompido. Nunca lê nem escreve fora dos limites dados; as cópias
+   largas (16 bytes de literais, 8 de repetição) só são usadas com folga nos dois lados.
+*/
+long descomprimirBloco(const unsigned char *src, size_t n, unsigned char *dst, size_t cap) {
+    const unsigned char *ip = src, *fimEntrada = src + n;
+    unsigned char *op = dst, *fimSaida = dst + cap;
+    for (;;) {
+        if (ip >= fimEntrada) return -1;
+        unsigned token = *ip++;
+        size_t nLit = token >> 4;
+        if (nLit == 15) {
+            unsigned char c;
+            do {
+                if (ip >= fimEntrada) return -1;
+                c = *ip++;
+                nLit += c;
+            } while (c == 255);
+        }
+        if ((size_t) (fimEntrada - ip) < nLit || (size_t) (fimSaida - op) < nLit) return -1;
+        if (nLit <= 16 && fimEntrada - ip >= 16 && fimSaida - op >= 16) memcpy(op, ip, 16);
+        else memcpy(op, ip, nLit);
+        op += nLit;
+        ip += nLit;
+        if (ip == fimEntrada) break; /* última sequência: só literais */
+
+        if (fimEntrada - ip < 2) return -1;
+        size_t distancia = (size_t) ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        if (distancia == 0 || distancia > (size_t) (op - dst)) return -1;
+        size_t tam = token & 15;
+        if (tam == 15) {
+            unsigned char c;
+            do {
+                if (ip >= fimEntrada) return -1;
+                c = *ip++;
+                tam += c;
+            } while (c == 255);
+        }
+        tam += LZ_MIN_REPETICAO;
+        if ((size_t) (fimSaida - op) < tam) return -1;
+        const unsigned char *m = op - distancia;
+        if (distancia >= 8 && (size_t) (fimSaida - op) >= tam + 8) {
+            unsigned char *fimCopia = op + tam;
+            do { memcpy(op, m, 8); op += 8; m += 8; } while (op < fimCopia);
+            op = fimCopia;
+        } else {
+            while (tam--) *op++ = *m++; /* sobreposta: repete o padrão byte a byte */
+        }
+    }
+    return (long) (op - dst);
+}
+
+/* Contêiner DQZ1: mágico e blocos (varint tamanho original, varint tamanho gravado,
+   bytes). Bloco que não encolhe é gravado cru, com os dois tamanhos iguais. Os blocos
+   são independentes: comprimirBlocos() sozinho gera o que pode ser acrescentado ao fim
+   de um contêiner existente. */
+static void comprimirBlocos(const unsigned char *src, size_t n, Buffer *saida) {
+    unsigned char *tmp = (unsigned char*) malloc(LZ_LIMITE_COMPRIMIDO(LZ_BLOCO));
+    if (!tmp) { fprintf(stderr, "Erro de alocacao compressao.\n"); exit(EXIT_FAILURE); }
+    for (size_t ini = 0; ini < n; ini += LZ_BLOCO) {
+        size_t tam = n - ini < LZ_BLOCO ? n - ini : LZ_BLOCO;
+        size_t c = comprimirBloco(src + ini, tam, tmp);
+        bufVarint(saida, (uint32_t) tam);
+        if (c < tam) {
+            bufVarint(saida, (uint32_t) c);
+            bufBytes(saida, tmp, c);
+        } else {
+            bufVarint(saida, (uint32_t) tam);
+            bufBytes(saida, src + ini, tam);
+        }
+    }
+    free(tmp);
+}
+
+static void comprimirDados(const unsigned char *src, size_t n, Buffer *saida) {
+    bufBytes(saida, LZ_MAGICO, 4);
+    comprimirBlocos(src, n, saida);
+}
+
+static int ehComprimido(const unsigned char *d, size_t n) {
+    return n >= 4 && memcmp(d, LZ_MAGICO, 4) == 0;
+}
+
+/* Descomprime um contêiner DQZ1 inteiro; NULL se inválido. O resultado tem um byte
+   de folga no fim (quem lê texto pode terminá-lo com '\0'). */
+static unsigned char* descomprimirDados(const unsigned char *src, size_t n, size_t *tam) {
+    if (!ehComprimido(src, n)) return NULL;
+    Leitor l = { src + 4, src + n, 0 };
+    Buffer b = { NULL, 0, 0 };
+    while (l.p < l.fim) {
+        uint32_t original = lerVarintLimitado(&l);
+        uint32_t gravado = lerVarintLimitado(&l);
+        if (l.erro || original > LZ_BLOCO || gravado > original || gravado > (size_t) (l.fim - l.p)) {
+            free(b.d);
+            return NULL;
+        }
+        bufReservar(&b, (size_t) original + 1);
+        if (gravado == original) {
+            memcpy(b.d + b.n, l.p, original);
+        } else if (descomprimirBloco(l.p, gravado, b.d + b.n, original) != (long) original) {
+            free(b.d);
+            return NULL;
+        }
+        b.n += original;
+        l.p += gravado;
+    }
+    bufReservar(&b, 1);
+    *tam = b.n;
+    return b.d;
+}
+
+/* ---------------------------
+   Arquivo de sessões
+   --------------------------- */
+
+/* Grava num temporário e renomeia: leitores nunca veem o arquivo pela metade */
+static int gravarTrocando(const char *arquivo, const unsigned char *d, size_t n) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", arquivo);
+    FILE *f = fopen(tmp, "wb");
+    int ok = f && fwrite(d, 1, n, f) == n;
+    if (f) ok = (fclose(f) == 0) && ok;
+    if (ok) ok = rename(tmp, arquivo) == 0;
+    if (!ok) remove(tmp);
+    return ok;
+}
+
+/* salvarSessoes() – grava todas as sessões em formato colunar; retorna 0 em erro.
+   Layout: "DQS2", os dicionários (salas, pistas, suspeitos) e depois lotes de até
+   SESSOES_POR_LOTE sessões: nº de sessões e as colunas acusado, veredicto, pistas e
+   caminho, cada uma precedida do seu tamanho em bytes (pode ser pulada sem decodificar).
+   O arquivo é gravado comprimido (contêiner DQZ1): os dicionários repetem muito texto.
+*/
+static void escreverLoteSessoes(Buffer *b, const TabelaSessoes *ts, int ini, int n) {
+    bufVarint(b, (uint32_t) n);
+    Buffer col = { NULL, 0, 0 };
+    for (int s = ini; s < ini + n; ++s) bufVarint(&col, (uint32_t) (ts->acusado[s] + 1)); /* 0 = ninguém */
+    bufVarint(b, (uint32_t) col.n);
+    bufBytes(b, col.d, col.n);
+    free(col.d);
+    bufVarint(b, (uint32_t) n);
+    bufBytes(b, ts->veredicto + ini, (size_t) n);
+    escreverColunaListas(b, ts->inicioPistas + ini, ts->pistas, n);
+    escreverColunaListas(b, ts->inicioCaminho + ini, ts->caminho, n);
+}
+
+int salvarSessoes(const TabelaSessoes *ts, const char *arquivo) {
+    Buffer b = { NULL, 0, 0 };
+    bufBytes(&b, SESSOES_MAGICO, 4);
+    const Dicionario *dics[3] = { &ts->dicSalas, &ts->dicPistas, &ts->dicSuspeitos };
+    for (int d = 0; d < 3; ++d) {
+        Buffer dic = { NULL, 0, 0 };
+        escreverDicionario(&dic, dics[d]);
+        bufVarint(&b, (uint32_t) dic.n);
+        bufBytes(&b, dic.d, dic.n);
+        free(dic.d);
+    }
+    for (int ini = 0; ini < ts->nSessoes; ini += SESSOES_POR_LOTE) {
+        int n = ts->nSessoes - ini < SESSOES_POR_LOTE ? ts->nSessoes - ini : SESSOES_POR_LOTE;
+        escreverLoteSessoes(&b, ts, ini, n);
+    }
+    Buffer z = { NULL, 0, 0 };
+    comprimirDados(b.d, b.n, &z);
+    free(b.d);
+    int ok = gravarTrocando(arquivo, z.d, z.n);
+    free(z.d);
+    return ok;
+}
+
+static unsigned char* lerArquivoInteiro(const char *arquivo, size_t *tam) {
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return NULL;
+    size_t cap = 4096, n = 0;
+    unsigned char *d = (unsigned char*) malloc(cap);
+    if (!d) { fprintf(stderr, "Erro de alocacao arquivo.\n"); exit(EXIT_FAILURE); }
+    size_t lidos;
+    while ((lidos = fread(d + n, 1, cap - n, f)) > 0) {
+        n += lidos;
+        if (n == cap) {
+            cap *= 2;
+            d = (unsigned char*) realloc(d, cap);
+            if (!d) { fprintf(stderr, "Erro de alocacao arquivo.\n"); exit(EXIT_FAILURE); }
+        }
+    }
+    fclose(f);
+    *tam = n;
+    return d;
+}
+
+/* Leitura sequencial de um arquivo cru ou DQZ1 (descomprimido bloco a bloco):
+   só a janela d[ini, n) fica em memória, não o arquivo inteiro */
+typedef struct fluxo {
+    FILE *f;
+    int comprimido, erro;
+    unsigned char *d, *bloco;
+    size_t ini, n, cap;
+} Fluxo;
+
+static void reservarFluxo(Fluxo *fx, size_t minimo) {
+    if (fx->cap >= minimo) return;
+    size_t novo = fx->cap ? fx->cap : LZ_BLOCO;
+    while (novo < minimo) novo *= 2;
+    fx->d = (unsigned char*) realloc(fx->d, novo);
+    if (!fx->d) { fprintf(stderr, "Erro de alocacao arquivo.\n"); exit(EXIT_FAILURE); }
+    fx->cap = novo;
+}
+
+/* varint lido direto do arquivo: 1 = lido, 0 = fim do arquivo antes dele, -1 = inválido */
+static int lerVarintArquivo(FILE *f, uint32_t *v) {
+    *v = 0;
+    for (int desloc = 0; desloc < 35; desloc += 7) {
+        int c = fgetc(f);
+        if (c == EOF) return desloc == 0 ? 0 : -1;
+        *v |= (uint32_t) (c & 0x7F) << desloc;
+        if (!(c & 0x80)) return 1;
+    }
+    return -1;
+}
+
+static int abrirFluxo(Fluxo *fx, const char *arquivo) {
+    memset(fx, 0, sizeof(*fx));
+    fx->f = fopen(arquivo, "rb");
+    if (!fx->f) return 0;
+    unsigned char cab[4];
+    size_t lidos = fread(cab, 1, 4, fx->f);
+    fx->comprimido = ehComprimido(cab, lidos);
+    if (fx->comprimido) {
+        fx->bloco = (unsigned char*) malloc(LZ_BLOCO);
+        if (!fx->bloco) { fprintf(stderr, "Erro de alocacao arquivo.\n"); exit(EXIT_FAILURE); }
+    } else if (lidos) { /* arquivo vazio: nada a guardar (e fx->d segue NULL) */
+        reservarFluxo(fx, lidos);
+        memcpy(fx->d, cab, lidos);
+        fx->n = lidos;
+    }
+    return 1;
+}
+
+static void fecharFluxo(Fluxo *fx) {
+    if (fx->f) fclose(fx->f);
+    free(fx->d);
+    free(fx->bloco);
+    memset(fx, 0, sizeof(*fx));
+}
+
+/* garante ao menos 'minimo' bytes na janela (menos só no fim do arquivo); retorna quantos há */
+static size_t encherFluxo(Fluxo *fx, size_t minimo) {
+    while (!fx->erro && fx->n - fx->ini < minimo) {
+        if (fx->ini > 0) {
+            memmove(fx->d, fx->d + fx->ini, fx->n - fx->ini);
+            fx->n -= fx->ini;
+            fx->ini = 0;
+        }
+        size_t lidos;
+        if (fx->comprimido) {
+            uint32_t original, gravado;
+            int r = lerVarintArquivo(fx->f, &original);
+            if (r == 0) break;
+            if (r < 0 || lerVarintArquivo(fx->f, &gravado) != 1 || original > LZ_BLOCO || gravado > original) {
+                fx->erro = 1;
+                break;
+            }
+            if (original == 0) continue; /* bloco vazio: nada a copiar */
+            reservarFluxo(fx, fx->n + original);
+            if (fread(fx->bloco, 1, gravado, fx->f) != gravado) { fx->erro = 1; break; }
+            if (gravado == original) {
+                memcpy(fx->d + fx->n, fx->bloco, original);
+            } else if (descomprimirBloco(fx->bloco, gravado, fx->d + fx->n, original) != (long) original) {
+                fx->erro = 1;
+                break;
+            }
+            lidos = original;
+        } else {
+            reservarFluxo(fx, fx->n + LZ_BLOCO);
+            lidos = fread(fx->d + fx->n, 1, LZ_BLOCO, fx->f);
+            if (lidos == 0) break;
+        }
+        fx->n += lidos;
+    }
+    return fx->n - fx->ini;
+}
+
+/* próximo varint do fluxo: 1 = lido, 0 = fim do arquivo exatamente aqui, -1 = inválido */
+static int varintFluxo(Fluxo *fx, uint32_t *v) {
+    size_t disp = encherFluxo(fx, 5);
+    if (disp == 0) return fx->erro ? -1 : 0;
+    Leitor l = { fx->d + fx->ini, fx->d + fx->ini + disp, 0 };
+    *v = lerVarintLimitado(&l);
+    if (l.erro) { fx->erro = 1; return -1; }
+    fx->ini = (size_t) (l.p - fx->d);
+    return 1;
+}
+
+/* leitor sobre os próximos 'bytes' do fluxo (consumidos); vale até o próximo encherFluxo */
+static int trechoFluxo(Fluxo *fx, size_t bytes, Leitor *l) {
+    if (encherFluxo(fx, bytes) < bytes) { fx->erro = 1; return 0; }
+    l->p = fx->d + fx->ini;
+    l->fim = l->p + bytes;
+    l->erro = 0;
+    fx->ini += bytes;
+    return 1;
+}
+
+static int pularFluxo(Fluxo *fx, size_t bytes) {
+    while (bytes > 0) {
+        size_t disp = encherFluxo(fx, bytes < LZ_BLOCO ? bytes : LZ_BLOCO);
+        if (disp == 0) { fx->erro = 1; return 0; }
+        size_t k = disp < bytes ? disp : bytes;
+        fx->ini += k;
+        bytes -= k;
+    }
+    return 1;
+}
+
+/* "DQS2" e os três dicionários, cada um precedido do seu tamanho em bytes */
+static int lerCabecalhoSessoes(Fluxo *fx, TabelaSessoes *ts) {
+    Leitor l;
+    if (!trechoFluxo(fx, 4, &l) || memcmp(l.p, SESSOES_MAGICO, 4) != 0) return 0;
+    Dicionario *dics[3] = { &ts->dicSalas, &ts->dicPistas, &ts->dicSuspeitos };
+    for (int d = 0; d < 3; ++d) {
+        uint32_t bytes;
+        if (varintFluxo(fx, &bytes) != 1 || !trechoFluxo(fx, bytes, &l)) return 0;
+        if (!lerDicionario(&l, dics[d]) || l.p != l.fim) return 0;
+    }
+    return 1;
+}
+
+static void esvaziarSessoes(TabelaSessoes *ts) {
+    ts->nSessoes = 0;
+    ts->nCaminho = ts->nPistas = 0;
+}
+
+/* lerLoteSessoes() – acrescenta a 'ts' o próximo lote do fluxo. Só as colunas pedidas
+   são decodificadas; as outras são puladas pelo tamanho (em 'ts' ficam sem valor).
+   Os ids são validados contra os dicionários de 'dic'. Retorna 1, 0 no fim do arquivo
+   ou -1 se o lote for inválido ou não couber na memória da tabela.
+*/
+static int lerLoteSessoes(Fluxo *fx, TabelaSessoes *ts, int colunas, const TabelaSessoes *dic) {
+    uint32_t n;
+    int r = varintFluxo(fx, &n);
+    if (r <= 0) return r;
+    if (n == 0 || n > SESSOES_POR_LOTE) return -1;
+    if (ts->nSessoes > INT_MAX / 2 - SESSOES_POR_LOTE) {
+        fprintf(stderr, "Arquivo de sessoes grande demais para carregar inteiro (use --consultar).\n");
+        return -1;
+    }
+    int base = ts->nSessoes;
+    reservarSessoes(ts, base + (int) n);
+    if (base == 0) { ts->inicioCaminho[0] = 0; ts->inicioPistas[0] = 0; }
+    ts->inicioPistas[base] = (uint32_t) ts->nPistas;
+    ts->inicioCaminho[base] = (uint32_t) ts->nCaminho;
+
+    static const int ordem[4] = { COLUNA_ACUSADO, COLUNA_VEREDICTO, COLUNA_PISTAS, COLUNA_CAMINHO };
+    for (int c = 0; c < 4; ++c) {
+        uint32_t bytes;
+        Leitor col;
+        if (varintFluxo(fx, &bytes) != 1) return -1;
+        if (!(colunas & ordem[c])) {
+            if (!pularFluxo(fx, bytes)) return -1;
+            continue;
+        }
+        if (!trechoFluxo(fx, bytes, &col)) return -1;
+        int ok = 1;
+        switch (ordem[c]) {
+        case COLUNA_ACUSADO:
+            for (uint32_t s = 0; ok && s < n; ++s) {
+                uint32_t v = lerVarintLimitado(&col);
+                ok = !col.erro && v <= (uint32_t) dic->dicSuspeitos.n;
+                ts->acusado[base + s] = (int32_t) v - 1;
+            }
+            break;
+        case COLUNA_VEREDICTO:
+            ok = bytes == n;
+            if (ok) memcpy(ts->veredicto + base, col.p, n);
+            break;
+        case COLUNA_PISTAS:
+            ok = lerColunaListas(&col, ts->inicioPistas + base, &ts->pistas, &ts->capPistas, &ts->nPistas,
+                                 (int) n, dic->dicPistas.n);
+            break;
+        case COLUNA_CAMINHO:
+            ok = lerColunaListas(&col, ts->inicioCaminho + base, &ts->caminho, &ts->capCaminho, &ts->nCaminho,
+                                 (int) n, dic->dicSalas.n);
+            break;
+        }
+        if (!ok) return -1;
+    }
+    ts->nSessoes = base + (int) n;
+    return 1;
+}
+
+/* arquivo DQS1 (sem lotes) já descomprimido em memória */
+static int carregarSessoesV1(TabelaSessoes *ts, const unsigned char *dados, size_t tam) {
+    Leitor l = { dados + 4, dados + tam, 0 };
+    uint32_t n = lerVarintLimitado(&l);
+    int ok = !l.erro && n <= tam && n <= (uint32_t) (INT_MAX / 2);
+    ok = ok && lerDicionario(&l, &ts->dicSalas) && lerDicionario(&l, &ts->dicPistas)
+            && lerDicionario(&l, &ts->dicSuspeitos);
+    if (ok) {
+        Leitor col;
+        reservarSessoes(ts, (int) n);
+        ts->nSessoes = (int) n;
+        ts->inicioCaminho[0] = 0;
+        ts->inicioPistas[0] = 0;
+        ok = lerColunaDelimitada(&l, &col)
+          && lerColunaListas(&col, ts->inicioCaminho, &ts->caminho, &ts->capCaminho, &ts->nCaminho,
+                             (int) n, ts->dicSalas.n)
+          && lerColunaDelimitada(&l, &col)
+          && lerColunaListas(&col, ts->inicioPistas, &ts->pistas, &ts->capPistas, &ts->nPistas,
+                             (int) n, ts->dicPistas.n);
+    }
+    if (ok) {
+        Leitor col;
+        ok = lerColunaDelimitada(&l, &col);
+        for (uint32_t s = 0; ok && s < n; ++s) {
+            uint32_t v = lerVarintLimitado(&col);
+            ok = !col.erro && v <= (uint32_t) ts->dicSuspeitos.n;
+            ts->acusado[s] = (int32_t) v - 1;
+        }
+    }
+    if (ok) {
+        uint32_t nv = lerVarintLimitado(&l);
+        ok = !l.erro && nv == n && n <= (size_t) (l.fim - l.p);
+        if (ok) memcpy(ts->veredicto, l.p, n);
+    }
+    return ok;
+}
+
+/* o arquivo é do formato antigo? (olha os 4 primeiros bytes sem consumi-los) */
+static int ehSessoesV1(Fluxo *fx) {
+    return encherFluxo(fx, 4) >= 4 && memcmp(fx->d + fx->ini, SESSOES_MAGICO_V1, 4) == 0;
+}
+
+/* carregarSessoes() – lê um arquivo de salvarSessoes() inteiro para a memória;
+   retorna 0 se ausente, inválido ou grande demais. Aceita também os arquivos DQS1
+   antigos e os gravados sem compressão. */
+int carregarSessoes(TabelaSessoes *ts, const char *arquivo) {
+    memset(ts, 0, sizeof(*ts));
+    Fluxo fx;
+    if (!abrirFluxo(&fx, arquivo)) return 0;
+    int ok;
+    if (ehSessoesV1(&fx)) {
+        size_t tam = encherFluxo(&fx, SIZE_MAX);
+        ok = !fx.erro && carregarSessoesV1(ts, fx.d + fx.ini, tam);
+    } else {
+        ok = lerCabecalhoSessoes(&fx, ts);
+        int r;
+        while (ok && (r = lerLoteSessoes(&fx, ts, COLUNAS_TODAS, ts)) != 0) ok = r > 0;
+        ok = ok && !fx.erro;
+    }
+    fecharFluxo(&fx);
+    if (!ok) liberarTabelaSessoes(ts);
+    return ok;
+}
+
+/* os dicionários já têm todos os nomes da sessão? (então ela cabe num lote acrescentado) */
+static int dicionariosCobrem(const TabelaSessoes *ts, const RegistroSessao *r) {
+    for (int i = 0; i < r->nSalas; ++i)
+        if (posicaoNoDicionario(&ts->dicSalas, r->salas[i]) < 0) return 0;
+    for (int i = 0; i < r->nPistas; ++i)
+        if (posicaoNoDicionario(&ts->dicPistas, r->pistas[i]) < 0) return 0;
+    return !r->acusado[0] || posicaoNoDicionario(&ts->dicSuspeitos, r->acusado) >= 0;
+}
+
+/* acrescentarSessao() – só o cabeçalho (dicionários) é lido; a sessão vira um lote de
+   uma sessão gravado com um write() no fim do arquivo (um bloco DQZ1 a mais, se ele é
+   comprimido), e as sessões anteriores não são tocadas. O arquivo inteiro só é
+   regravado quando ele não existe ou está vazio, é DQS1, ou a sessão traz um nome que
+   os dicionários não têm. Processos concorrentes se revezam pelo flock; quem regrava
+   troca o arquivo (rename), então a trava só vale se ainda é o arquivo do caminho.
+*/
+int acrescentarSessao(const char *arquivo, const RegistroSessao *r) {
+    int fd;
+    struct stat st, atual;
+    for (;;) {
+        fd = open(arquivo, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return 0;
+        if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) { close(fd); return 0; }
+        if (stat(arquivo, &atual) == 0 && atual.st_ino == st.st_ino && atual.st_dev == st.st_dev) break;
+        close(fd); /* regravado enquanto esperávamos: trava o novo */
+    }
+
+    TabelaSessoes ts;
+    memset(&ts, 0, sizeof(ts));
+    int ok = 1, regravar = st.st_size == 0;
+    if (!regravar) {
+        Fluxo fx;
+        if (!abrirFluxo(&fx, arquivo)) { close(fd); return -1; }
+        int comprimido = fx.comprimido;
+        if (ehSessoesV1(&fx)) regravar = 1;
+        else if (!lerCabecalhoSessoes(&fx, &ts)) ok = -1;
+        else if (!dicionariosCobrem(&ts, r)) regravar = 1;
+        fecharFluxo(&fx);
+        if (ok > 0 && !regravar) {
+            anexarSessao(&ts, r);
+            Buffer b = { NULL, 0, 0 }, z = { NULL, 0, 0 };
+            escreverLoteSessoes(&b, &ts, 0, 1);
+            if (comprimido) comprimirBlocos(b.d, b.n, &z);
+            const Buffer *saida = comprimido ? &z : &b;
+            ok = lseek(fd, 0, SEEK_END) == st.st_size
+              && gravarTudo(fd, (const char*) saida->d, saida->n) && fsync(fd) == 0;
+            if (!ok && ftruncate(fd, st.st_size) != 0) fprintf(stderr, "Erro ao desfazer o lote em %s.\n", arquivo);
+            free(b.d);
+            free(z.d);
+        }
+        liberarTabelaSessoes(&ts);
+    }
+    if (regravar) {
+        if (st.st_size == 0) memset(&ts, 0, sizeof(ts));
+        else if (!carregarSessoes(&ts, arquivo)) ok = -1;
+        if (ok > 0) {
+            anexarSessao(&ts, r);
+            ok = salvarSessoes(&ts, arquivo);
+        }
+        liberarTabelaSessoes(&ts);
+    }
+    close(fd);
+    return ok;
+}
+
+/* filtrarFaixa() – máscara das sessões [inicio, fim) com o acusado/veredicto pedidos
+   (-1 = qualquer). Laço sem desvios sobre colunas contíguas: o compilador vetoriza.
+   Retorna quantas passaram. */
+int filtrarFaixa(const TabelaSessoes *ts, int inicio, int fim, int32_t acusado, int veredicto, uint8_t *mascara) {
+    const int32_t *ac = ts->acusado + inicio;
+    const uint8_t *ve = ts->veredicto + inicio;
+    int qualquerAcusado = acusado < 0, qualquerVeredicto = veredicto < 0;
+    int total = 0;
+    for (int k = 0; k < fim - inicio; ++k) {
+        uint8_t m = (uint8_t) ((qualquerAcusado | (ac[k] == acusado)) & (qualquerVeredicto | (ve[k] == veredicto)));
+        mascara[k] = m;
+        total += m;
+    }
+    return total;
+}
+
+/* filtrarSessoes() – filtrarFaixa() sobre todas as sessões. */
+int filtrarSessoes(const TabelaSessoes *ts, int32_t acusado, int veredicto, uint8_t *mascara) {
+    return filtrarFaixa(ts, 0, ts->nSessoes, acusado, veredicto, mascara);
+}
+
+/* analisarSessoes() – resumo das sessões gravadas: acusações, condenações e visitas. */
+void analisarSessoes(const TabelaSessoes *ts) {
+    printf("Sessoes: %d\n", ts->nSessoes);
+    if (ts->nSessoes == 0) return;
+    uint8_t *mascara = (uint8_t*) malloc((size_t) ts->nSessoes);
+    if (!mascara) { fprintf(stderr, "Erro de alocacao sessoes.\n"); exit(EXIT_FAILURE); }
+
+    printf("\nAcusacoes por suspeito (acusacoes / condenacoes):\n");
+    for (int a = 0; a < ts->dicSuspeitos.n; ++a) {
+        int acusacoes = filtrarSessoes(ts, a, -1, mascara);
+        int condenacoes = filtrarSessoes(ts, a, VEREDICTO_CULPADO, mascara);
+        printf(" - %-24s %6d / %6d\n", ts->dicSuspeitos.nomes[a], acusacoes, condenacoes);
+    }
+    printf(" - %-24s %6d\n", "(sem acusacao)", filtrarSessoes(ts, -1, VEREDICTO_SEM_ACUSACAO, mascara));
+    free(mascara);
+
+    uint64_t *visitas = (uint64_t*) calloc(ts->dicSalas.n ? ts->dicSalas.n : 1, sizeof(uint64_t));
+    uint64_t *coletas = (uint64_t*) calloc(ts->dicPistas.n ? ts->dicPistas.n : 1, sizeof(uint64_t));
+    if (!visitas || !coletas) { fprintf(stderr, "Erro de alocacao sessoes.\n"); exit(EXIT_FAILURE); }
+    for (size_t i = 0; i < ts->nCaminho; ++i) visitas[ts->caminho[i]]++;
+    for (size_t i = 0; i < ts->nPistas; ++i) coletas[ts->pistas[i]]++;
+    printf("\nVisitas por sala:\n");
+    for (int i = 0; i < ts->dicSalas.n; ++i)
+        printf(" - %-32s %llu\n", ts->dicSalas.nomes[i], (unsigned long long) visitas[i]);
+    printf("\nColetas por pista:\n");
+    for (int i = 0; i < ts->dicPistas.n; ++i)
+        printf(" - %-32s %llu\n", ts->dicPistas.nomes[i], (unsigned long long) coletas[i]);
+    free(visitas);
+    free(coletas);
+}
+
+/* ---------------------------
+   WAL das pistas coletadas
+   --------------------------- */
+
+static uint32_t tabelaCrc[256];
+static pthread_once_t crcPronto = PTHREAD_ONCE_INIT;
+
+static void montarTabelaCrc(void) {
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1)));
+        tabelaCrc[i] = c;
+    }
+}
+
+/* crc32Bytes() – CRC-32 (polinômio refletido 0xEDB88320, o mesmo do zlib). */
+uint32_t crc32Bytes(const void *dados, size_t n) {
+    pthread_once(&crcPronto, montarTabelaCrc);
+    const unsigned char *p = (const unsigned char*) dados;
+    uint32_t c = 0xFFFFFFFFu;
+    while (n--) c = tabelaCrc[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+Wal* abrirWal(const char *arquivo) {
+    int fd = open(arquivo, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return NULL;
+    off_t fim = lseek(fd, 0, SEEK_END);
+    Wal *w = (Wal*) calloc(1, sizeof(Wal));
+    if (!w) { fprintf(stderr, "Erro de alocacao WAL.\n"); exit(EXIT_FAILURE); }
+    w->fd = fd;
+    w->lsnFinal = w->lsnDuravel = fim > 0 ? (uint64_t) fim : 0;
+    pthread_mutex_init(&w->trava, NULL);
+    pthread_cond_init(&w->confirmado, NULL);
+    return w;
+}
+
+/* anexarWal() – registro [tamanho][crc][WAL_PISTA, texto] no lote pendente; só memória. */
+uint64_t anexarWal(Wal *w, const char *pista) {
+    unsigned char reg[WAL_CABECALHO + 1 + MAX_PISTA];
+    size_t n = strnlen(pista, MAX_PISTA - 1);
+    uint32_t tam = (uint32_t) (n + 1);
+    reg[WAL_CABECALHO] = WAL_PISTA;
+    memcpy(reg + WAL_CABECALHO + 1, pista, n);
+    uint32_t crc = crc32Bytes(reg + WAL_CABECALHO, tam);
+    memcpy(reg, &tam, 4);
+    memcpy(reg + 4, &crc, 4);
+    size_t total = WAL_CABECALHO + tam;
+
+    pthread_mutex_lock(&w->trava);
+    if (w->nPendente + total > w->capPendente) {
+        size_t cap = w->capPendente ? w->capPendente * 2 : 4096;
+        while (cap < w->nPendente + total) cap *= 2;
+        char *novo = (char*) realloc(w->pendente, cap);
+        if (!novo) { fprintf(stderr, "Erro de alocacao WAL.\n"); exit(EXIT_FAILURE); }
+        w->pendente = novo;
+        w->capPendente = cap;
+    }
+    memcpy(w->pendente + w->nPendente, reg, total);
+    w->nPendente += total;
+    w->lsnFinal += total;
+    w->registros++;
+    uint64_t lsn = w->lsnFinal;
+    pthread_mutex_unlock(&w->trava);
+    return lsn;
+}
+
+/* confirmarWal() – commit em grupo: se ninguém está gravando, esta thread vira líder e
+   leva para o disco tudo que estiver pendente (inclusive registros de outras threads);
+   senão espera o líder atual e confere de novo. Retorna 0 se a gravação falhou.
+*/
+int confirmarWal(Wal *w, uint64_t lsn) {
+    pthread_mutex_lock(&w->trava);
+    while (w->lsnDuravel < lsn && !w->erro) {
+        if (w->gravando) {
+            pthread_cond_wait(&w->confirmado, &w->trava);
+            continue;
+        }
+        w->gravando = 1;
+        char *lote = w->pendente;
+        size_t n = w->nPendente;
+        uint64_t ate = w->lsnFinal;
+        w->pendente = NULL;
+        w->nPendente = w->capPendente = 0;
+        pthread_mutex_unlock(&w->trava);
+
+        int ok = gravarTudo(w->fd, lote, n) && fdatasync(w->fd) == 0;
+        free(lote);
+
+        pthread_mutex_lock(&w->trava);
+        w->gravando = 0;
+        w->sincronizacoes++;
+        if (ok) w->lsnDuravel = ate;
+        else w->erro = 1;
+        pthread_cond_broadcast(&w->confirmado);
+    }
+    int ok = !w->erro;
+    pthread_mutex_unlock(&w->trava);
+    return ok;
+}
+
+int reaplicarWal(const char *arquivo, TabelaHash *tabela, PistaNode **raizPistas) {
+    size_t tam;
+    unsigned char *dados = lerArquivoInteiro(arquivo, &tam);
+    if (!dados) return 0;
+    size_t pos = 0;
+    int n = 0;
+    while (tam - pos >= WAL_CABECALHO) {
+        uint32_t t, crc;
+        memcpy(&t, dados + pos, 4);
+        memcpy(&crc, dados + pos + 4, 4);
+        if (t == 0 || t > tam - pos - WAL_CABECALHO) break;       /* registro cortado */
+        const unsigned char *reg = dados + pos + WAL_CABECALHO;
+        if (crc32Bytes(reg, t) != crc || reg[0] != WAL_PISTA) break;
+        char pista[MAX_PISTA];
+        size_t np = t - 1 < MAX_PISTA - 1 ? t - 1 : MAX_PISTA - 1;
+        memcpy(pista, reg + 1, np);
+        pista[np] = '\0';
+        /* a pista retirada do caso depois da queda não volta */
+        const HashEntry *e = buscarEntrada(tabela, pista);
+        if (e) {
+            *raizPistas = inserirPista(*raizPistas, &e->pista);
+            n++;
+        }
+        pos += WAL_CABECALHO + t;
+    }
+    free(dados);
+    /* a cauda inválida é descartada para os próximos registros não ficarem atrás dela */
+    if (pos < tam && truncate(arquivo, (off_t) pos) != 0)
+        fprintf(stderr, "Aviso: nao foi possivel cortar o WAL %s.\n", arquivo);
+    return n;
+}
+
+/* fecharWal() – confirma o que estiver pendente; com descartar, esvazia o arquivo
+   (a sessão terminou e as pistas não precisam mais ser recuperadas). */
+void fecharWal(Wal *w, int descartar) {
+    if (!w) return;
+    if (!confirmarWal(w, w->lsnFinal)) fprintf(stderr, "Erro ao gravar o WAL.\n");
+    if (descartar && (ftruncate(w->fd, 0) != 0 || fdatasync(w->fd) != 0))
+        fprintf(stderr, "Aviso: nao foi possivel esvaziar o WAL.\n");
+    close(w->fd);
+    pthread_mutex_destroy(&w->trava);
+    pthread_cond_destroy(&w->confirmado);
+    free(w->pendente);
+    free(w);
+}
+
+/* ---------------------------
+   Arquivo de casos: B+tree em disco
+   --------------------------- */
+
+/* Layout do nó: cabeçalho de 12 bytes, vetor de deslocamentos (uint16) das células em
+   ordem de chave e células alocadas do fim da página para o início:
+     [uint16 tamanho da chave][chave][uint32 valor]
+   Na folha o valor é a contagem e 'ligacao' aponta a próxima folha (0 = última).
+   No nó interno o valor é o filho com chaves >= chave e 'ligacao' é o filho mais à esquerda. */
+#define NO_CABECALHO 12
+#define MAX_CELULAS_NO ((PAGINA_ARQUIVO - NO_CABECALHO) / 8) /* célula mínima: slot, tamanho, 1 byte, valor */
+
+static int noFolha(const unsigned char *p) { return p[0]; }
+static uint16_t ler16(const unsigned char *p) { uint16_t v; memcpy(&v, p, 2); return v; }
+static void gravar16(unsigned char *p, uint16_t v) { memcpy(p, &v, 2); }
+static void gravar32(unsigned char *p, uint32_t v) { memcpy(p, &v, 4); }
+static uint16_t nChavesNo(const unsigned char *p) { return ler16(p + 2); }
+static uint32_t ligacaoNo(const unsigned char *p) { return ler32(p + 8); }
+
+static const unsigned char* celulaNo(const unsigned char *p, int i) {
+    return p + ler16(p + NO_CABECALHO + 2 * i);
+}
+
+static uint32_t valorNo(const unsigned char *p, int i) {
+    const unsigned char *c = celulaNo(p, i);
+    return ler32(c + 2 + ler16(c));
+}
+
+/* Confere um nó lido do disco antes de qualquer uso: tipo, nº de chaves, início da área
+   de células, cada célula (deslocamento, chave e valor) dentro da página e filhos que
+   apontam para páginas de nós existentes. */
+static int noValido(const unsigned char *p, uint32_t nPaginas) {
+    if (p[0] > 1) return 0;
+    int folha = noFolha(p);
+    size_t nChaves = nChavesNo(p), ini = ler16(p + 4);
+    if (nChaves > MAX_CELULAS_NO || ini < NO_CABECALHO + 2 * nChaves || ini > PAGINA_ARQUIVO) return 0;
+    uint32_t ligacao = ligacaoNo(p);
+    if (ligacao >= nPaginas || (!folha && ligacao == 0)) return 0;
+    for (size_t i = 0; i < nChaves; ++i) {
+        size_t o = ler16(p + NO_CABECALHO + 2 * i);
+        if (o < ini || o + 2 > PAGINA_ARQUIVO) return 0;
+        size_t n = ler16(p + o);
+        if (n > MAX_CHAVE_ARQUIVO || o + 2 + n + 4 > PAGINA_ARQUIVO) return 0;
+        uint32_t filho = ler32(p + o + 2 + n);
+        if (!folha && (filho == 0 || filho >= nPaginas)) return 0;
+    }
+    return 1;
+}
+
+static void iniciarNo(unsigned char *p, int folha, uint32_t ligacao) {
+    memset(p, 0, NO_CABECALHO);
+    p[0] = (unsigned char) folha;
+    gravar16(p + 4, PAGINA_ARQUIVO);
+    gravar32(p + 8, ligacao);
+}
+
+static int compararChaves(const unsigned char *a, size_t na, const unsigned char *b, size_t nb) {
+    int c = memcmp(a, b, na < nb ? na : nb);
+    if (c) return c;
+    return na < nb ? -1 : na > nb;
+}
+
+/* Primeira posição com chave >= procurada; *igual diz se ela é a própria chave */
+static int buscarNoNo(const unsigned char *p, const unsigned char *chave, size_t n, int *igual) {
+    int lo = 0, hi = nChavesNo(p);
+    *igual = 0;
+    while (lo < hi) {
+        int meio = (lo + hi) / 2;
+        const unsigned char *c = celulaNo(p, meio);
+        int cmp = compararChaves(c + 2, ler16(c), chave, n);
+        if (cmp < 0) lo = meio + 1;
+        else { hi = meio; if (cmp == 0) *igual = 1; }
+    }
+    if (*igual && lo < nChavesNo(p)) {
+        const unsigned char *c = celulaNo(p, lo);
+        *igual = compararChaves(c + 2, ler16(c), chave, n) == 0;
+    }
+    return lo;
+}
+
+/* Filho do nó interno que cobre a chave */
+static uint32_t filhoNo(const unsigned char *p, const unsigned char *chave, size_t n) {
+    int igual;
+    int pos = buscarNoNo(p, chave, n, &igual);
+    int i = igual ? pos : pos - 1;
+    return i < 0 ? ligacaoNo(p) : valorNo(p, i);
+}
+
+static int cabeNoNo(const unsigned char *p, size_t n) {
+    size_t livre = ler16(p + 4) - (NO_CABECALHO + 2 * (size_t) nChavesNo(p));
+    return 2 + n + 4 + 2 <= livre;
+}
+
+/* Insere a célula na posição pos; quem chama já conferiu o espaço com cabeNoNo() */
+static void inserirCelula(unsigned char *p, int pos, const unsigned char *chave, size_t n, uint32_t valor) {
+    uint16_t nChaves = nChavesNo(p);
+    uint16_t ini = (uint16_t) (ler16(p + 4) - (2 + n + 4));
+    gravar16(p + ini, (uint16_t) n);
+    memcpy(p + ini + 2, chave, n);
+    gravar32(p + ini + 2 + n, valor);
+    unsigned char *slots = p + NO_CABECALHO;
+    memmove(slots + 2 * (pos + 1), slots + 2 * pos, 2 * (size_t) (nChaves - pos));
+    gravar16(slots + 2 * pos, ini);
+    gravar16(p + 2, (uint16_t) (nChaves + 1));
+    gravar16(p + 4, ini);
+}
+
+/* Página inválida no disco: avisa uma vez e para de gravar, para não espalhar o estrago */
+static void paginaCorrompida(ArquivoCasos *a, uint32_t pagina) {
+    if (!a->corrompido)
+        fprintf(stderr, "Arquivo de casos corrompido (pagina %u); nada sera gravado.\n", pagina);
+    a->corrompido = a->erro = 1;
+}
+
+static void gravarPagina(ArquivoCasos *a, uint32_t pagina, const unsigned char *dados) {
+    if (a->corrompido || !a->escrita) return;
+    if (pwrite(a->fd, dados, PAGINA_ARQUIVO, (off_t) pagina * PAGINA_ARQUIVO) != PAGINA_ARQUIVO)
+        a->erro = 1;
+    a->escritas++;
+}
+
+/* Relógio: percorre os quadros dando uma segunda chance a quem tem o bit de referência;
+   o primeiro quadro livre ou não referenciado (e não fixado) é reaproveitado. */
+static Quadro* despejarQuadro(ArquivoCasos *a) {
+    for (int passo = 0; passo < 2 * a->nQuadros; ++passo) {
+        Quadro *q = &a->quadros[a->ponteiro];
+        a->ponteiro = (a->ponteiro + 1) % a->nQuadros;
+        if (!q->usado) return q;
+        if (q->fixado) continue;
+        if (q->referencia) { q->referencia = 0; continue; }
+        if (q->sujo) gravarPagina(a, q->pagina, q->dados);
+        q->usado = q->sujo = 0;
+        return q;
+    }
+    fprintf(stderr, "Todos os quadros do arquivo de casos estao fixados.\n");
+    exit(EXIT_FAILURE);
+}
+
+static Quadro* fixarPagina(ArquivoCasos *a, uint32_t pagina) {
+    for (int i = 0; i < a->nQuadros; ++i) {
+        Quadro *q = &a->quadros[i];
+        if (q->usado && q->pagina == pagina) {
+            q->fixado++;
+            q->referencia = 1;
+            a->acertos++;
+            return q;
+        }
+    }
+    Quadro *q = despejarQuadro(a);
+    if (pread(a->fd, q->dados, PAGINA_ARQUIVO, (off_t) pagina * PAGINA_ARQUIVO) != PAGINA_ARQUIVO
+        || !noValido(q->dados, a->nPaginas)) {
+        /* no lugar dela, uma folha vazia: quem estiver lendo simplesmente não acha nada */
+        paginaCorrompida(a, pagina);
+        iniciarNo(q->dados, 1, 0);
+    }
+    a->leituras++;
+    q->pagina = pagina;
+    q->usado = q->referencia = 1;
+    q->sujo = 0;
+    q->fixado = 1;
+    return q;
+}
+
+static void soltarPagina(Quadro *q, int sujo) {
+    if (sujo) q->sujo = 1;
+    q->fixado--;
+}
+
+static Quadro* novaPagina(ArquivoCasos *a, int folha, uint32_t ligacao) {
+    Quadro *q = despejarQuadro(a);
+    q->pagina = a->nPaginas++;
+    q->usado = q->referencia = q->sujo = 1;
+    q->fixado = 1;
+    iniciarNo(q->dados, folha, ligacao);
+    return q;
+}
+
+/* Resultado da inserção num nó: se ele dividiu, a chave separadora e a página nova */
+typedef struct divisaoNo {
+    int houve;
+    uint16_t tam;
+    unsigned char chave[MAX_CHAVE_ARQUIVO];
+    uint32_t direita;
+} DivisaoNo;
+
+/* Insere a célula no nó de q; sem espaço, divide o nó ao meio (em bytes) e devolve a
+   separadora: na folha ela é copiada (primeira chave da direita), no nó interno sobe. */
+static void inserirOuDividir(ArquivoCasos *a, Quadro *q, int pos, const unsigned char *chave, size_t n,
+                             uint32_t valor, DivisaoNo *div) {
+    unsigned char *p = q->dados;
+    div->houve = 0;
+    if (cabeNoNo(p, n)) {
+        inserirCelula(p, pos, chave, n, valor);
+        return;
+    }
+    unsigned char copia[PAGINA_ARQUIVO];
+    memcpy(copia, p, PAGINA_ARQUIVO);
+    int total = nChavesNo(copia) + 1;   /* noValido() garante no máximo MAX_CELULAS_NO */
+    const unsigned char *chaves[MAX_CELULAS_NO + 1];
+    size_t tams[MAX_CELULAS_NO + 1];
+    uint32_t valores[MAX_CELULAS_NO + 1];
+    size_t bytes = 0;
+    for (int i = 0, j = 0; i < total; ++i) {
+        if (i == pos) { chaves[i] = chave; tams[i] = n; valores[i] = valor; }
+        else {
+            const unsigned char *c = celulaNo(copia, j++);
+            chaves[i] = c + 2; tams[i] = ler16(c); valores[i] = ler32(c + 2 + tams[i]);
+        }
+        bytes += tams[i] + 8;
+    }
+    int folha = noFolha(copia);
+    int meio = 1;
+    for (size_t acumulado = tams[0] + 8; meio < total - 1 && acumulado < bytes / 2; ++meio)
+        acumulado += tams[meio] + 8;
+
+    Quadro *qd = novaPagina(a, folha, folha ? ligacaoNo(copia) : valores[meio]);
+    iniciarNo(p, folha, folha ? qd->pagina : ligacaoNo(copia));
+    for (int i = 0; i < meio; ++i) inserirCelula(p, i, chaves[i], tams[i], valores[i]);
+    for (int i = folha ? meio : meio + 1, k = 0; i < total; ++i, ++k)
+        inserirCelula(qd->dados, k, chaves[i], tams[i], valores[i]);
+    div->houve = 1;
+    div->tam = (uint16_t) tams[meio];
+    memcpy(div->chave, chaves[meio], tams[meio]);
+    div->direita = qd->pagina;
+    soltarPagina(qd, 1);
+}
+
+static void inserirNaArvore(ArquivoCasos *a, uint32_t pagina, const unsigned char *chave, size_t n,
+                            DivisaoNo *div, int nivel) {
+    div->houve = 0;
+    if (nivel > MAX_NIVEIS_ARQUIVO) { paginaCorrompida(a, pagina); return; }
+    Quadro *q = fixarPagina(a, pagina);
+    if (noFolha(q->dados)) {
+        int igual;
+        int pos = buscarNoNo(q->dados, chave, n, &igual);
+        if (igual) {
+            unsigned char *c = (unsigned char*) celulaNo(q->dados, pos);
+            gravar32(c + 2 + ler16(c), ler32(c + 2 + ler16(c)) + 1);
+        } else {
+            inserirOuDividir(a, q, pos, chave, n, 1, div);
+        }
+        soltarPagina(q, 1);
+        return;
+    }
+    /* o nó interno fica solto durante a descida: só os nós do caminho que dividirem
+       voltam para o pool */
+    uint32_t filho = filhoNo(q->dados, chave, n);
+    soltarPagina(q, 0);
+    DivisaoNo abaixo;
+    inserirNaArvore(a, filho, chave, n, &abaixo, nivel + 1);
+    if (!abaixo.houve) return;
+    q = fixarPagina(a, pagina);
+    int igual;
+    int pos = buscarNoNo(q->dados, abaixo.chave, abaixo.tam, &igual);
+    inserirOuDividir(a, q, pos, abaixo.chave, abaixo.tam, abaixo.direita, div);
+    soltarPagina(q, 1);
+}
+
+static size_t montarChaveArquivo(unsigned char *chave, const char *jogador, const char *pista) {
+    size_t nj = strnlen(jogador, MAX_NOME - 1), np = strnlen(pista, MAX_PISTA - 1);
+    memcpy(chave, jogador, nj);
+    chave[nj] = '\0';
+    memcpy(chave + nj + 1, pista, np);
+    return nj + 1 + np;
+}
+
+static void gravarCabecalhoArquivo(ArquivoCasos *a) {
+    unsigned char cab[PAGINA_ARQUIVO];
+    memset(cab, 0, sizeof(cab));
+    memcpy(cab, ARQUIVO_MAGICO, 4);
+    gravar32(cab + 4, a->raiz);
+    gravar32(cab + 8, a->nPaginas);
+    gravarPagina(a, 0, cab);
+}
+
+ArquivoCasos* abrirArquivoCasos(const char *arquivo, int nQuadros, int escrita) {
+    int fd = open(arquivo, escrita ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) return NULL;
+    /* outro processo gravando ao mesmo tempo corromperia a árvore: espera a vez dele */
+    if (flock(fd, escrita ? LOCK_EX : LOCK_SH) != 0) { close(fd); return NULL; }
+    ArquivoCasos *a = (ArquivoCasos*) calloc(1, sizeof(ArquivoCasos));
+    if (!a) { fprintf(stderr, "Erro de alocacao arquivo de casos.\n"); exit(EXIT_FAILURE); }
+    a->fd = fd;
+    a->escrita = escrita;
+    a->nQuadros = nQuadros < 8 ? 8 : nQuadros; /* a divisão da raiz fixa até 3 páginas */
+    a->quadros = (Quadro*) calloc((size_t) a->nQuadros, sizeof(Quadro));
+    if (!a->quadros) { fprintf(stderr, "Erro de alocacao arquivo de casos.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < a->nQuadros; ++i) {
+        a->quadros[i].dados = (unsigned char*) aligned_alloc(PAGINA_ARQUIVO, PAGINA_ARQUIVO);
+        if (!a->quadros[i].dados) { fprintf(stderr, "Erro de alocacao arquivo de casos.\n"); exit(EXIT_FAILURE); }
+    }
+
+    unsigned char cab[PAGINA_ARQUIVO];
+    ssize_t lidos = pread(fd, cab, PAGINA_ARQUIVO, 0);
+    if (lidos == 0 && escrita) {
+        /* arquivo novo: cabeçalho e uma folha vazia como raiz */
+        a->nPaginas = 1;
+        Quadro *q = novaPagina(a, 1, 0);
+        a->raiz = q->pagina;
+        soltarPagina(q, 1);
+        return a;
+    }
+    off_t fim = lseek(fd, 0, SEEK_END);
+    if (lidos != PAGINA_ARQUIVO || memcmp(cab, ARQUIVO_MAGICO, 4) != 0) a->erro = 1;
+    a->raiz = ler32(cab + 4);
+    a->nPaginas = ler32(cab + 8);
+    if (a->nPaginas < 2 || a->nPaginas > (uint32_t) (INT32_MAX / PAGINA_ARQUIVO) || a->raiz == 0
+        || a->raiz >= a->nPaginas || fim < (off_t) a->nPaginas * PAGINA_ARQUIVO) a->erro = 1;
+    if (a->erro) {
+        a->nPaginas = 0; /* nada a gravar */
+        fecharArquivoCasos(a);
+        return NULL;
+    }
+    return a;
+}
+
+int arquivarPista(ArquivoCasos *a, const char *jogador, const char *pista) {
+    unsigned char chave[MAX_CHAVE_ARQUIVO];
+    size_t n = montarChaveArquivo(chave, jogador, pista);
+    DivisaoNo div;
+    inserirNaArvore(a, a->raiz, chave, n, &div, 0);
+    if (div.houve) {
+        /* a raiz dividiu: a árvore ganha um nível */
+        Quadro *q = novaPagina(a, 0, a->raiz);
+        inserirCelula(q->dados, 0, div.chave, div.tam, div.direita);
+        a->raiz = q->pagina;
+        soltarPagina(q, 1);
+    }
+    return !a->erro;
+}
+
+void posicionarCursor(ArquivoCasos *a, const char *jogador, CursorArquivo *c) {
+    unsigned char chave[MAX_CHAVE_ARQUIVO];
+    size_t n = jogador ? montarChaveArquivo(chave, jogador, "") : 0;
+    uint32_t pagina = a->raiz;
+    c->arquivo = a;
+    c->folhas = 0;
+    for (int nivel = 0; ; ++nivel) {
+        if (nivel > MAX_NIVEIS_ARQUIVO) {
+            paginaCorrompida(a, pagina);
+            c->pagina = 0;
+            return;
+        }
+        Quadro *q = fixarPagina(a, pagina);
+        if (noFolha(q->dados)) {
+            int igual;
+            c->pagina = pagina;
+            c->pos = buscarNoNo(q->dados, chave, n, &igual);
+            soltarPagina(q, 0);
+            return;
+        }
+        uint32_t filho = filhoNo(q->dados, chave, n);
+        soltarPagina(q, 0);
+        pagina = filho;
+    }
+}
+
+int proximoNoCursor(CursorArquivo *c, char jogador[MAX_NOME], char pista[MAX_PISTA], uint32_t *vezes) {
+    while (c->pagina != 0) {
+        Quadro *q = fixarPagina(c->arquivo, c->pagina);
+        if (c->pos < nChavesNo(q->dados)) {
+            const unsigned char *cel = celulaNo(q->dados, c->pos++);
+            size_t n = ler16(cel);
+            const unsigned char *k = cel + 2;
+            size_t nj = strnlen((const char*) k, n < MAX_NOME - 1 ? n : MAX_NOME - 1);
+            size_t np = n > nj + 1 ? n - nj - 1 : 0;
+            if (np > MAX_PISTA - 1) np = MAX_PISTA - 1;
+            memcpy(jogador, k, nj);
+            jogador[nj] = '\0';
+            memcpy(pista, k + nj + 1, np);
+            pista[np] = '\0';
+            *vezes = ler32(k + n);
+            soltarPagina(q, 0);
+            return 1;
+        }
+        c->pagina = ligacaoNo(q->dados);
+        c->pos = 0;
+        soltarPagina(q, 0);
+        if (c->pagina != 0 && ++c->folhas >= c->arquivo->nPaginas) {
+            paginaCorrompida(c->arquivo, c->pagina);
+            c->pagina = 0;
+        }
+    }
+    return 0;
+}
+
+/* fecharArquivoCasos() – grava as páginas sujas e o cabeçalho; retorna 0 se algo falhou. */
+int fecharArquivoCasos(ArquivoCasos *a) {
+    if (!a) return 0;
+    if (a->nPaginas > 0 && a->escrita && !a->corrompido) {
+        for (int i = 0; i < a->nQuadros; ++i)
+            if (a->quadros[i].usado && a->quadros[i].sujo) gravarPagina(a, a->quadros[i].pagina, a->quadros[i].dados);
+        /* nós primeiro, cabeçalho (raiz e nº de páginas) por último */
+        if (fdatasync(a->fd) != 0) a->erro = 1;
+        gravarCabecalhoArquivo(a);
+        if (fdatasync(a->fd) != 0) a->erro = 1;
+    }
+    int ok = !a->erro;
+    close(a->fd);
+    for (int i = 0; i < a->nQuadros; ++i) free(a->quadros[i].dados);
+    free(a->quadros);
+    free(a);
+    return ok;
+}
+
+void listarHistorico(ArquivoCasos *a, const char *jogador) {
+    CursorArquivo c;
+    char nome[MAX_NOME], pista[MAX_PISTA], atual[MAX_NOME] = "";
+    uint32_t vezes;
+    int n = 0;
+    posicionarCursor(a, jogador, &c);
+    while (proximoNoCursor(&c, nome, pista, &vezes)) {
+        if (jogador && strcmp(nome, jogador) != 0) break;
+        if (n == 0 || strcmp(nome, atual) != 0) {
+            printf("%s:\n", nome);
+            strcpy(atual, nome);
+        }
+        printf(" - %s (%u %s)\n", pista, vezes, vezes == 1 ? "partida" : "partidas");
+        n++;
+    }
+    if (n == 0) printf("Nenhuma pista arquivada%s%s.\n", jogador ? " para " : "", jogador ? jogador : "");
+}
+
+/* ---------------------------
+   Catálogo de casos (carga sob demanda + cache LRU)
+   --------------------------- */
+
+/* Divide a linha em campos separados por '|' (sem o '\n' final); retorna quantos */
+static int separarCampos(char *linha, char *campos[], int max) {
+    strip_newline(linha);
+    int n = 0;
+    for (char *p = linha; n < max; ) {
+        campos[n++] = p;
+        p = strchr(p, '|');
+        if (!p) break;
+        *p++ = '\0';
+    }
+    return n;
+}
+
+static int compararCasos(const void *a, const void *b) {
+    return strcmp(((const Caso*) a)->nome, ((const Caso*) b)->nome);
+}
+
+static size_t bytesArena(const Arena *a) {
+    size_t total = 0;
+    for (const BlocoArena *b = a->blocos; b; b = b->prox) total += sizeof(BlocoArena) + b->cap;
+    return total;
+}
+
+/* Memória de um caso carregado: salas, textos e as estruturas da tabela */
+static size_t memoriaCaso(const Caso *c) {
+    const TabelaHash *t = &c->tabela;
+    size_t total = (size_t) c->nSalas * sizeof(Sala) + bytesArena(&c->textos) + bytesArena(&t->textos);
+    total += t->nSegmentos * SEGMENTO_ENTRADAS * sizeof(HashEntry) + t->capSegmentos * sizeof(HashEntry*);
+    total += t->nEntradas * sizeof(SalaRef);
+    total += (size_t) t->indice.nSlots * t->indice.largura + (size_t) t->filtro.nBlocos * 64;
+    total += (size_t) t->capSuspeitos * sizeof(SuspeitoIndice);
+    for (int i = 0; i < t->nSuspeitos; ++i) total += (size_t) t->suspeitos[i].capPistas * sizeof(int);
+    total += (size_t) c->fatos.capFatos * sizeof(FatoCaso) + (size_t) c->fatos.capSuspeitos * MAX_NOME;
+    total += (size_t) c->capPassagens * sizeof(Passagem);
+    if (t->trigramas) {
+        const IndiceTrigramas *g = t->trigramas;
+        total += (size_t) g->capPistas * 2 * sizeof(char*) + (size_t) g->nTrigramas * 2 * sizeof(uint32_t);
+        total += (size_t) (g->nTrigramas ? g->inicio[g->nTrigramas] : 0) * sizeof(int);
+        for (int i = 0; i < g->nPistas; ++i)
+            if (g->pistas[i]) total += strlen(g->pistas[i]) + strlen(g->normalizadas[i]) + 2;
+    }
+    return total;
+}
+
+Catalogo* abrirCatalogo(const char *arquivo, size_t limiteBytes) {
+    FILE *f = fopen(arquivo, "rb");
+    if (!f) return NULL;
+    Catalogo *cat = (Catalogo*) calloc(1, sizeof(Catalogo));
+    if (!cat) { fprintf(stderr, "Erro de alocacao catalogo.\n"); exit(EXIT_FAILURE); }
+    cat->arquivo = f;
+    cat->limiteBytes = limiteBytes;
+    cat->lru.anterior = cat->lru.proximo = &cat->lru;
+    pthread_mutex_init(&cat->trava, NULL);
+
+    /* só os cabeçalhos "caso|" são lidos agora; o resto fica no disco até o primeiro uso */
+    int cap = 0;
+    char *linha = NULL;
+    size_t capLinha = 0;
+    long pos = 0;
+    ssize_t n;
+    while ((n = getline(&linha, &capLinha, f)) > 0) {
+        if (strncmp(linha, "caso|", 5) == 0) {
+            if (cat->nCasos > 0) cat->casos[cat->nCasos - 1].fim = pos;
+            if (cat->nCasos == cap) {
+                cap = cap ? cap * 2 : 64;
+                cat->casos = (Caso*) realloc(cat->casos, (size_t) cap * sizeof(Caso));
+                if (!cat->casos) { fprintf(stderr, "Erro de alocacao catalogo.\n"); exit(EXIT_FAILURE); }
+            }
+            Caso *c = &cat->casos[cat->nCasos++];
+            memset(c, 0, sizeof(*c));
+            strip_newline(linha);
+            snprintf(c->nome, sizeof(c->nome), "%s", linha + 5);
+            c->inicio = pos + n;
+        }
+        pos += n;
+    }
+    free(linha);
+    if (cat->nCasos > 0) cat->casos[cat->nCasos - 1].fim = pos;
+    qsort(cat->casos, (size_t) cat->nCasos, sizeof(Caso), compararCasos);
+    for (int i = 1; i < cat->nCasos; ++i)
+        if (strcmp(cat->casos[i - 1].nome, cat->casos[i].nome) == 0)
+            fprintf(stderr, "Aviso: caso repetido no catalogo: %s\n", cat->casos[i].nome);
+    return cat;
+}
+
+static void descarregarCaso(Caso *c) {
+    liberarTabelaHash(&c->tabela);
+    liberarSalas(c->raiz);
+    liberarArena(&c->textos);
+    liberarBaseFatos(&c->fatos);
+    free(c->passagens);
+    c->passagens = NULL;
+    c->nPassagens = c->capPassagens = 0;
+    c->raiz = NULL;
+    c->nSalas = 0;
+    c->carregado = 0;
+    c->bytes = 0;
+}
+
+/* Lê o trecho do caso e monta mapa e tabela; retorna 0 (caso vazio) em erro de formato. */
+static int carregarCaso(Catalogo *cat, Caso *c) {
+    size_t tam = (size_t) (c->fim - c->inicio);
+    char *texto = (char*) malloc(tam + 1);
+    if (!texto) { fprintf(stderr, "Erro de alocacao catalogo.\n"); exit(EXIT_FAILURE); }
+    if (fseek(cat->arquivo, c->inicio, SEEK_SET) != 0 || fread(texto, 1, tam, cat->arquivo) != tam) {
+        free(texto);
+        fprintf(stderr, "Erro ao ler o caso %s.\n", c->nome);
+        return 0;
+    }
+    texto[tam] = '\0';
+
+    inicializarTabelaHash(&c->tabela);
+    iniciarBaseFatos(&c->fatos);
+    c->passagens = NULL;
+    c->nPassagens = c->capPassagens = 0;
+    c->textos.blocos = NULL;
+    c->raiz = NULL;
+    /* salas do caso em ordem de declaração, para achar o pai pelo nome */
+    Sala **salas = NULL;
+    int nSalas = 0, capSalas = 0, ok = 1, nLinha = 0;
+    char *campos[MAX_CAMPOS_CATALOGO];
+    for (char *linha = texto, *prox; ok && linha && *linha; linha = prox) {
+        prox = strchr(linha, '\n');
+        if (prox) *prox++ = '\0';
+        nLinha++;
+        if (linha[0] == '#' || linha[0] == '\0' || linha[0] == '\r') continue;
+        int n = separarCampos(linha, campos, MAX_CAMPOS_CATALOGO);
+        if (strcmp(campos[0], "mapa") == 0 && n == 3) {
+            inserirNaHash(&c->tabela, campos[1], campos[2]);
+        } else if (strcmp(campos[0], "sala") == 0 && n == 5) {
+            Sala *pai = NULL;
+            for (int i = 0; i < nSalas && campos[3][0]; ++i)
+                if (strcmp(textoStr(&salas[i]->nome), campos[3]) == 0) { pai = salas[i]; break; }
+            Sala **lado = !pai ? NULL : campos[4][0] == 'e' ? &pai->esquerda
+                        : campos[4][0] == 'd' ? &pai->direita : NULL;
+            if (c->raiz ? (!lado || *lado) : campos[3][0] != '\0') { ok = 0; break; }
+            if (nSalas == capSalas) {
+                capSalas = capSalas ? capSalas * 2 : 16;
+                salas = (Sala**) realloc(salas, (size_t) capSalas * sizeof(Sala*));
+                if (!salas) { fprintf(stderr, "Erro de alocacao catalogo.\n"); exit(EXIT_FAILURE); }
+            }
+            Sala *sala = criarSalaNaArena(&c->textos, campos[1], campos[2][0] ? campos[2] : NULL);
+            salas[nSalas++] = sala;
+            if (lado) *lado = sala;
+            else c->raiz = sala;
+        } else if (strcmp(campos[0], "fato") == 0 && (n == 4 || n == 5)) {
+            ok = adicionarFato(&c->fatos, campos[1], campos[2], campos[3], n == 5 ? campos[4] : NULL);
+        } else if (strcmp(campos[0], "passagem") == 0 && (n == 3 || n == 4)) {
+            Passagem p = { NULL, NULL, n == 4 ? atoi(campos[3]) : 1 };
+            for (int i = 0; i < nSalas; ++i) {
+                if (strcmp(textoStr(&salas[i]->nome), campos[1]) == 0) p.a = salas[i];
+                if (strcmp(textoStr(&salas[i]->nome), campos[2]) == 0) p.b = salas[i];
+            }
+            if (!p.a || !p.b || p.a == p.b || p.custo < 1) { ok = 0; break; }
+            if (c->nPassagens == c->capPassagens) {
+                c->capPassagens = c->capPassagens ? c->capPassagens * 2 : 8;
+                c->passagens = (Passagem*) realloc(c->passagens, (size_t) c->capPassagens * sizeof(Passagem));
+                if (!c->passagens) { fprintf(stderr, "Erro de alocacao catalogo.\n"); exit(EXIT_FAILURE); }
+            }
+            c->passagens[c->nPassagens++] = p;
+        } else if (strcmp(campos[0], "culpados") == 0 && n == 2 && atoi(campos[1]) > 0) {
+            c->fatos.maxCulpados = atoi(campos[1]);
+        } else {
+            ok = 0;
+        }
+    }
+    free(salas);
+    free(texto);
+    if (!ok || !c->raiz) {
+        fprintf(stderr, "Caso %s invalido (linha %d apos o cabecalho).\n", c->nome, nLinha);
+        descarregarCaso(c);
+        return 0;
+    }
+    vincularSalas(&c->tabela, c->raiz);
+    concluirMigracao(&c->tabela); /* sessões concorrentes só leem a tabela */
+    montarTrigramasDaTabela(&c->tabela);
+    for (int i = 0; i < c->tabela.nSuspeitos; ++i)
+        if (c->tabela.suspeitos[i].nPistas > 0) registrarSuspeitoFato(&c->fatos, c->tabela.suspeitos[i].nome);
+    c->nSalas = numerarSalas(c->raiz);
+    c->carregado = 1;
+    c->bytes = memoriaCaso(c);
+    return 1;
+}
+
+static void tirarDaFila(Caso *c) {
+    c->anterior->proximo = c->proximo;
+    c->proximo->anterior = c->anterior;
+    c->anterior = c->proximo = NULL;
+}
+
+/* Descarrega os casos soltos menos recentes até caber no limite (com a trava tomada) */
+static void aplicarLimite(Catalogo *cat) {
+    while (cat->bytesCarregados > cat->limiteBytes && cat->lru.anterior != &cat->lru) {
+        Caso *velho = cat->lru.anterior;
+        tirarDaFila(velho);
+        cat->bytesCarregados -= velho->bytes;
+        descarregarCaso(velho);
+        cat->descartes++;
+    }
+}
+
+/* obterCaso() – o carregamento acontece com a trava do catálogo tomada: os casos são
+   pequenos e isso mantém os pools de salas (que não são thread-safe) com um usuário só. */
+Caso* obterCaso(Catalogo *cat, const char *nome) {
+    Caso chave;
+    snprintf(chave.nome, sizeof(chave.nome), "%s", nome);
+    Caso *c = (Caso*) bsearch(&chave, cat->casos, (size_t) cat->nCasos, sizeof(Caso), compararCasos);
+    if (!c) return NULL;
+    pthread_mutex_lock(&cat->trava);
+    if (c->invalido) {
+        pthread_mutex_unlock(&cat->trava);
+        return NULL;
+    }
+    if (c->carregado) {
+        if (c->referencias == 0) tirarDaFila(c);
+        cat->acertos++;
+    } else if (carregarCaso(cat, c)) {
+        cat->carregamentos++;
+        cat->bytesCarregados += c->bytes;
+        if (cat->bytesCarregados > cat->picoBytes) cat->picoBytes = cat->bytesCarregados;
+    } else {
+        c->invalido = 1;
+        pthread_mutex_unlock(&cat->trava);
+        return NULL;
+    }
+    c->referencias++;
+    aplicarLimite(cat);
+    pthread_mutex_unlock(&cat->trava);
+    return c;
+}
+
+void soltarCaso(Catalogo *cat, Caso *c) {
+    if (!c) return;
+    pthread_mutex_lock(&cat->trava);
+    if (--c->referencias == 0) {
+        /* volta para a fila como o mais recente */
+        c->proximo = cat->lru.proximo;
+        c->anterior = &cat->lru;
+        cat->lru.proximo->anterior = c;
+        cat->lru.proximo = c;
+        aplicarLimite(cat);
+    }
+    pthread_mutex_unlock(&cat->trava);
+}
+
+/* fecharCatalogo() – descarrega tudo; nenhum caso pode estar em uso. */
+void fecharCatalogo(Catalogo *cat) {
+    if (!cat) return;
+    for (int i = 0; i < cat->nCasos; ++i)
+        if (cat->casos[i].carregado) descarregarCaso(&cat->casos[i]);
+    fclose(cat->arquivo);
+    pthread_mutex_destroy(&cat->trava);
+    free(cat->casos);
+    free(cat);
+}
+
+/* ---------------------------
+   Índice global do catálogo (pista/suspeito -> caso, sala)
+   --------------------------- */
+
+/* Ocorrência durante a construção; o texto aponta para a arena da construção */
+typedef struct ocorrenciaGlobal {
+    const char *texto;
+    int tipo;
+    int caso, sala;
+} OcorrenciaGlobal;
+
+static int compararOcorrencias(const void *a, const void *b) {
+    const OcorrenciaGlobal *x = (const OcorrenciaGlobal*) a, *y = (const OcorrenciaGlobal*) b;
+    if (x->tipo != y->tipo) return x->tipo - y->tipo;
+    int c = strcmp(x->texto, y->texto);
+    if (c) return c;
+    if (x->caso != y->caso) return x->caso < y->caso ? -1 : 1;
+    return (x->sala > y->sala) - (x->sala < y->sala);
+}
+
+typedef struct coletaGlobal {
+    OcorrenciaGlobal *v;
+    size_t n, cap;
+    Arena textos;
+} ColetaGlobal;
+
+static void anotarOcorrencia(ColetaGlobal *cg, int tipo, const char *texto, int caso, int sala) {
+    if (cg->n == cg->cap) {
+        cg->cap = cg->cap ? cg->cap * 2 : 1024;
+        cg->v = (OcorrenciaGlobal*) realloc(cg->v, cg->cap * sizeof(OcorrenciaGlobal));
+        if (!cg->v) { fprintf(stderr, "Erro de alocacao indice global.\n"); exit(EXIT_FAILURE); }
+    }
+    size_t n = strlen(texto);
+    char *copia = reservarNaArena(&cg->textos, n + 1);
+    memcpy(copia, texto, n + 1);
+    cg->v[cg->n++] = (OcorrenciaGlobal) { copia, tipo, caso, sala };
+}
+
+static void coletarOcorrencias(ColetaGlobal *cg, Caso *c, int idCaso, const Sala *s) {
+    if (!s) return;
+    if (s->pista.tam != 0) {
+        anotarOcorrencia(cg, TERMO_PISTA, textoStr(&s->pista), idCaso, s->id);
+        const HashEntry *e = buscarEntradaTexto(&c->tabela, &s->pista);
+        if (e) anotarOcorrencia(cg, TERMO_SUSPEITO, textoStr(&e->suspeito), idCaso, s->id);
+    }
+    coletarOcorrencias(cg, c, idCaso, s->esquerda);
+    coletarOcorrencias(cg, c, idCaso, s->direita);
+}
+
+/* Layout: "DQI1", nCasos, nomes dos casos, nTermos e, por termo (em ordem de tipo e
+   texto): tipo, texto, nº de ocorrências, bytes das ocorrências e as ocorrências.
+   O arquivo inteiro vai no contêiner DQZ1. */
+int construirIndiceGlobal(Catalogo *cat, const char *arquivo) {
+    ColetaGlobal cg = { NULL, 0, 0, { NULL } };
+    for (int i = 0; i < cat->nCasos; ++i) {
+        Caso *c = obterCaso(cat, cat->casos[i].nome);
+        if (!c) continue;
+        coletarOcorrencias(&cg, c, i, c->raiz);
+        soltarCaso(cat, c);
+    }
+    qsort(cg.v, cg.n, sizeof(OcorrenciaGlobal), compararOcorrencias);
+
+    Buffer b = { NULL, 0, 0 }, ocorr = { NULL, 0, 0 };
+    bufBytes(&b, INDICE_GLOBAL_MAGICO, 4);
+    bufVarint(&b, (uint32_t) cat->nCasos);
+    for (int i = 0; i < cat->nCasos; ++i) {
+        uint32_t L = (uint32_t) strlen(cat->casos[i].nome);
+        bufVarint(&b, L);
+        bufBytes(&b, cat->casos[i].nome, L);
+    }
+    uint32_t nTermos = 0;
+    for (size_t i = 0; i < cg.n; ++i)
+        if (i == 0 || cg.v[i].tipo != cg.v[i-1].tipo || strcmp(cg.v[i].texto, cg.v[i-1].texto) != 0) nTermos++;
+    bufVarint(&b, nTermos);
+    for (size_t i = 0, j; i < cg.n; i = j) {
+        ocorr.n = 0;
+        int casoAnt = 0, salaAnt = 0;
+        uint32_t n = 0;
+        for (j = i; j < cg.n && cg.v[j].tipo == cg.v[i].tipo && strcmp(cg.v[j].texto, cg.v[i].texto) == 0; ++j) {
+            const OcorrenciaGlobal *o = &cg.v[j];
+            if (n > 0 && o->caso == casoAnt && o->sala == salaAnt) continue; /* repetida */
+            bufVarint(&ocorr, (uint32_t) (o->caso - casoAnt));
+            bufVarint(&ocorr, (uint32_t) (n > 0 && o->caso == casoAnt ? o->sala - salaAnt : o->sala));
+            casoAnt = o->caso;
+            salaAnt = o->sala;
+            n++;
+        }
+        uint32_t L = (uint32_t) strlen(cg.v[i].texto);
+        bufVarint(&b, (uint32_t) cg.v[i].tipo);
+        bufVarint(&b, L);
+        bufBytes(&b, cg.v[i].texto, L);
+        bufVarint(&b, n);
+        bufVarint(&b, (uint32_t) ocorr.n);
+        bufBytes(&b, ocorr.d, ocorr.n);
+    }
+    free(ocorr.d);
+    free(cg.v);
+    liberarArena(&cg.textos);
+
+    Buffer z = { NULL, 0, 0 };
+    comprimirDados(b.d, b.n, &z);
+    free(b.d);
+    int ok = gravarTrocando(arquivo, z.d, z.n);
+    free(z.d);
+    return ok;
+}
+
+static char* copiarTextoLido(Leitor *l, Arena *a) {
+    uint32_t L = lerVarintLimitado(l);
+    if (l->erro || L > (size_t) (l->fim - l->p)) { l->erro = 1; return NULL; }
+    char *t = reservarNaArena(a, L + 1);
+    memcpy(t, l->p, L);
+    t[L] = '\0';
+    l->p += L;
+    return t;
+}
+
+int carregarIndiceGlobal(IndiceGlobal *ind, const char *arquivo) {
+    memset(ind, 0, sizeof(*ind));
+    size_t tam;
+    unsigned char *bruto = lerArquivoInteiro(arquivo, &tam);
+    if (!bruto) return 0;
+    ind->dados = descomprimirDados(bruto, tam, &tam);
+    free(bruto);
+    if (!ind->dados || tam < 4 || memcmp(ind->dados, INDICE_GLOBAL_MAGICO, 4) != 0) {
+        liberarIndiceGlobal(ind);
+        return 0;
+    }
+    Leitor l = { ind->dados + 4, ind->dados + tam, 0 };
+    uint32_t nCasos = lerVarintLimitado(&l);
+    if (!l.erro && nCasos <= (size_t) (l.fim - l.p)) {
+        ind->casos = (char**) malloc((nCasos ? nCasos : 1) * sizeof(char*));
+        if (!ind->casos) { fprintf(stderr, "Erro de alocacao indice global.\n"); exit(EXIT_FAILURE); }
+        for (; (uint32_t) ind->nCasos < nCasos && !l.erro; ind->nCasos++)
+            ind->casos[ind->nCasos] = copiarTextoLido(&l, &ind->textos);
+    } else {
+        l.erro = 1;
+    }
+    uint32_t nTermos = l.erro ? 0 : lerVarintLimitado(&l);
+    if (!l.erro && nTermos <= (size_t) (l.fim - l.p)) {
+        ind->termos = (TermoGlobal*) malloc((nTermos ? nTermos : 1) * sizeof(TermoGlobal));
+        if (!ind->termos) { fprintf(stderr, "Erro de alocacao indice global.\n"); exit(EXIT_FAILURE); }
+        for (uint32_t i = 0; i < nTermos && !l.erro; ++i) {
+            TermoGlobal *t = &ind->termos[i];
+            t->tipo = (int) lerVarintLimitado(&l);
+            t->texto = copiarTextoLido(&l, &ind->textos);
+            t->nOcorrencias = lerVarintLimitado(&l);
+            t->nBytes = lerVarintLimitado(&l);
+            if (l.erro || t->nBytes > (size_t) (l.fim - l.p)) { l.erro = 1; break; }
+            t->ocorrencias = l.p;
+            l.p += t->nBytes;
+            ind->nTermos++;
+        }
+    } else {
+        l.erro = 1;
+    }
+    if (l.erro || l.p != l.fim) {
+        liberarIndiceGlobal(ind);
+        return 0;
+    }
+    return 1;
+}
+
+const TermoGlobal* buscarTermoGlobal(const IndiceGlobal *ind, int tipo, const char *texto) {
+    int lo = 0, hi = ind->nTermos - 1;
+    while (lo <= hi) {
+        int meio = (lo + hi) / 2;
+        const TermoGlobal *t = &ind->termos[meio];
+        int c = t->tipo != tipo ? t->tipo - tipo : strcmp(t->texto, texto);
+        if (c == 0) return t;
+        if (c < 0) lo = meio + 1;
+        else hi = meio - 1;
+    }
+    return NULL;
+}
+
+void liberarIndiceGlobal(IndiceGlobal *ind) {
+    free(ind->dados);
+    free(ind->casos);
+    free(ind->termos);
+    liberarArena(&ind->textos);
+    memset(ind, 0, sizeof(*ind));
+}
+
+/* ---------------------------
+   Consultas sobre sessões arquivadas
+   --------------------------- */
+
+/* Consulta já traduzida para ids dos dicionários do arquivo */
+typedef struct planoConsulta {
+    int32_t acusado;            /* -1 = qualquer */
+    int veredicto;              /* -1 = qualquer */
+    int32_t pista;              /* -1 = qualquer */
+    int32_t sala;               /* -1 = qualquer */
+    const uint8_t *pistasContra;/* pistas aceitas por 'contra' (NULL = sem filtro) */
+    int agrupar;
+    int nGrupos;
+} PlanoConsulta;
+
+/* Fatia da varredura executada por uma thread, com agregados locais */
+typedef struct fatiaConsulta {
+    const PlanoConsulta *plano;
+    const TabelaSessoes *ts;    /* um lote lido do arquivo (ou o arquivo DQS1 inteiro) */
+    TabelaSessoes lote;
+    int inicio, fim;
+    long long total;
+    long long *grupos;
+    pthread_t thread;
+    int emThread;
+} FatiaConsulta;
+
+static int listaContem(const int32_t *ids, uint32_t ini, uint32_t fim, int32_t alvo) {
+    for (uint32_t i = ini; i < fim; ++i)
+        if (ids[i] == alvo) return 1;
+    return 0;
+}
+
+static void* varrerFatia(void *arg) {
+    FatiaConsulta *f = (FatiaConsulta*) arg;
+    const PlanoConsulta *p = f->plano;
+    const TabelaSessoes *ts = f->ts;
+    int n = f->fim - f->inicio;
+    uint8_t *mascara = (uint8_t*) malloc(n > 0 ? (size_t) n : 1);
+    int *visto = p->agrupar == AGRUPAR_SALA ? (int*) malloc((p->nGrupos ? p->nGrupos : 1) * sizeof(int)) : NULL;
+    if (!mascara || (p->agrupar == AGRUPAR_SALA && !visto)) {
+        fprintf(stderr, "Erro de alocacao consulta.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (visto) for (int i = 0; i < p->nGrupos; ++i) visto[i] = -1;
+
+    /* 1) colunas de largura fixa primeiro: laço vetorizável sobre acusado/veredicto
+          (sem filtro nelas, nem foram decodificadas) */
+    if (p->acusado < 0 && p->veredicto < 0) memset(mascara, 1, (size_t) n);
+    else filtrarFaixa(ts, f->inicio, f->fim, p->acusado, p->veredicto, mascara);
+
+    /* 2) só as sessões sobreviventes decodificam as listas de pistas e salas */
+    for (int k = 0; k < n; ++k) {
+        if (!mascara[k]) continue;
+        int s = f->inicio + k;
+        uint32_t pi = ts->inicioPistas[s], pf = ts->inicioPistas[s+1];
+        if (p->pista >= 0 && !listaContem(ts->pistas, pi, pf, p->pista)) continue;
+        if (p->pistasContra) {
+            int achou = 0;
+            for (uint32_t i = pi; i < pf && !achou; ++i) achou = p->pistasContra[ts->pistas[i]];
+            if (!achou) continue;
+        }
+        uint32_t ci = ts->inicioCaminho[s], cf = ts->inicioCaminho[s+1];
+        if (p->sala >= 0 && !listaContem(ts->caminho, ci, cf, p->sala)) continue;
+
+        f->total++;
+        if (p->agrupar == AGRUPAR_SUSPEITO) {
+            f->grupos[ts->acusado[s] + 1]++;   /* grupo 0 = sem acusação */
+        } else if (p->agrupar == AGRUPAR_SALA) {
+            for (uint32_t i = ci; i < cf; ++i) {
+                int sala = ts->caminho[i];
+                if (visto[sala] == s) continue; /* conta a sessão uma vez por sala */
+                visto[sala] = s;
+                f->grupos[sala]++;
+            }
+        }
+    }
+    free(mascara);
+    free(visto);
+    return NULL;
+}
+
+/* roda as fatias já preparadas: a 0 na própria thread chamadora, as outras em threads */
+static void varrerFatias(FatiaConsulta *fatias, int n) {
+    for (int t = 1; t < n; ++t) {
+        fatias[t].emThread = pthread_create(&fatias[t].thread, NULL, varrerFatia, &fatias[t]) == 0;
+        if (!fatias[t].emThread) varrerFatia(&fatias[t]);
+    }
+    varrerFatia(&fatias[0]);
+    for (int t = 1; t < n; ++t)
+        if (fatias[t].emThread) pthread_join(fatias[t].thread, NULL);
+}
+
+/* executarConsulta() – conta as sessões do arquivo que atendem à consulta e agrupa o
+   resultado. Nomes são traduzidos para ids com os dicionários do cabeçalho antes da
+   varredura; um nome ausente encerra a consulta sem decodificar nenhuma coluna (os
+   lotes só são pulados para contar as sessões). O arquivo é lido lote a lote, um
+   lote por thread, e de cada lote só se decodificam as colunas que a consulta usa.
+   O critério 'contra' usa o índice reverso da tabela do caso para saber quais pistas
+   apontam para o suspeito. Retorna o total encontrado, ou -1 se o arquivo for ilegível.
+*/
+long long executarConsulta(const char *arquivo, const ConsultaSessoes *c, const TabelaHash *tabela) {
+    Fluxo fx;
+    TabelaSessoes dic;          /* só os dicionários; no formato DQS1, o arquivo inteiro */
+    memset(&dic, 0, sizeof(dic));
+    if (!abrirFluxo(&fx, arquivo)) return -1;
+    int antigo = ehSessoesV1(&fx);
+    int ok;
+    if (antigo) {
+        fecharFluxo(&fx);
+        ok = carregarSessoes(&dic, arquivo);
+    } else {
+        ok = lerCabecalhoSessoes(&fx, &dic);
+    }
+    if (!ok) {
+        fecharFluxo(&fx);
+        liberarTabelaSessoes(&dic);
+        return -1;
+    }
+
+    PlanoConsulta p;
+    p.acusado = -1; p.pista = -1; p.sala = -1;
+    p.veredicto = c->veredicto;
+    p.pistasContra = NULL;
+    p.agrupar = c->agrupar;
+    p.nGrupos = c->agrupar == AGRUPAR_SUSPEITO ? dic.dicSuspeitos.n + 1
+              : c->agrupar == AGRUPAR_SALA ? dic.dicSalas.n : 0;
+
+    int vazio = 0;
+    if (c->acusou && (p.acusado = posicaoNoDicionario(&dic.dicSuspeitos, c->acusou)) < 0) vazio = 1;
+    if (c->coletou && (p.pista = posicaoNoDicionario(&dic.dicPistas, c->coletou)) < 0) vazio = 1;
+    if (c->visitou && (p.sala = posicaoNoDicionario(&dic.dicSalas, c->visitou)) < 0) vazio = 1;
+
+    uint8_t *contra = NULL;
+    if (!vazio && c->contra) {
+        const SuspeitoIndice *si = tabela ? buscarSuspeitoIndice(tabela, c->contra) : NULL;
+        contra = (uint8_t*) calloc(dic.dicPistas.n ? dic.dicPistas.n : 1, 1);
+        if (!contra) { fprintf(stderr, "Erro de alocacao consulta.\n"); exit(EXIT_FAILURE); }
+        int alguma = 0;
+        for (int i = 0; si && i < si->nPistas; ++i) {
+            int id = posicaoNoDicionario(&dic.dicPistas, textoStr(&entradaEm(tabela, si->pistas[i])->pista));
+            if (id >= 0) { contra[id] = 1; alguma = 1; }
         }
-        at = at->prox;
+        if (!alguma) vazio = 1;
+        p.pistasContra = contra;
     }
-    /* inserir no início da lista */
-    HashEntry *novo = (HashEntry*) malloc(sizeof(HashEntry));
-    if (!novo) { fprintf(stderr, "Erro de alocacao hash.\n"); exit(EXIT_FAILURE); }
-    strncpy(novo->pista, pista, MAX_PISTA-1);
-    novo->pista[MAX_PISTA-1] = '\0';
-    strncpy(novo->suspeito, suspeito, MAX_NOME-1);
-    novo->suspeito[MAX_NOME-1] = '\0';
-    novo->prox = tabela[h];
-    tabela[h] = novo;
-}
 
-/* encontrarSuspeito() – consulta o suspeito correspondente a uma pista. */
-const char* encontrarSuspeito(HashEntry *tabela[], const char *pista) {
-    if (!pista) return NULL;
-    unsigned long h = hash_string(pista) % HASH_SIZE;
-    HashEntry *at = tabela[h];
-    while (at) {
-        if (strcmp(at->pista, pista) == 0) return at->suspeito;
-        at = at->prox;
+    /* colunas que a varredura lê; as demais são puladas em cada lote */
+    int colunas = 0;
+    if (!vazio) {
+        if (p.acusado >= 0 || p.veredicto >= 0) colunas |= COLUNA_ACUSADO | COLUNA_VEREDICTO;
+        if (p.agrupar == AGRUPAR_SUSPEITO) colunas |= COLUNA_ACUSADO;
+        if (p.pista >= 0 || p.pistasContra) colunas |= COLUNA_PISTAS;
+        if (p.sala >= 0 || p.agrupar == AGRUPAR_SALA) colunas |= COLUNA_CAMINHO;
     }
-    return NULL;
-}
 
-/* liberar tabela hash */
-void liberarTabelaHash(HashEntry *tabela[]) {
-    for (int i = 0; i < HASH_SIZE; ++i) {
-        HashEntry *p = tabela[i];
-        while (p) {
-            HashEntry *tmp = p;
-            p = p->prox;
-            free(tmp);
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    int nThreads = (int) (nucleos > 0 ? nucleos : 1);
+    if (nThreads > MAX_THREADS_CONSULTA) nThreads = MAX_THREADS_CONSULTA;
+    FatiaConsulta fatias[MAX_THREADS_CONSULTA];
+    for (int t = 0; t < nThreads; ++t) {
+        FatiaConsulta *f = &fatias[t];
+        memset(f, 0, sizeof(*f));
+        f->plano = &p;
+        f->grupos = (long long*) calloc(p.nGrupos ? p.nGrupos : 1, sizeof(long long));
+        if (!f->grupos) { fprintf(stderr, "Erro de alocacao consulta.\n"); exit(EXIT_FAILURE); }
+    }
+
+    uint64_t nSessoes = 0;
+    if (antigo) {
+        /* DQS1 já está inteiro na memória: fatias contíguas dele */
+        nSessoes = (uint64_t) dic.nSessoes;
+        int usadas = (int) (dic.nSessoes / SESSOES_POR_THREAD) + 1;
+        if (usadas > nThreads) usadas = nThreads;
+        int passo = (dic.nSessoes + usadas - 1) / usadas;
+        for (int t = 0; t < usadas; ++t) {
+            FatiaConsulta *f = &fatias[t];
+            f->ts = &dic;
+            f->inicio = t * passo < dic.nSessoes ? t * passo : dic.nSessoes;
+            f->fim = f->inicio + passo < dic.nSessoes ? f->inicio + passo : dic.nSessoes;
+        }
+        if (!vazio) varrerFatias(fatias, usadas);
+    } else {
+        /* lê até nThreads fatias, varre-as em paralelo e repete até o fim do arquivo;
+           lotes pequenos (um por sessão acrescentada) são juntados na mesma fatia */
+        int r = 1;
+        while (r > 0) {
+            int lidos = 0;
+            while (lidos < nThreads) {
+                FatiaConsulta *f = &fatias[lidos];
+                esvaziarSessoes(&f->lote);
+                while (f->lote.nSessoes < SESSOES_POR_LOTE && (r = lerLoteSessoes(&fx, &f->lote, colunas, &dic)) > 0) {}
+                if (r < 0 || f->lote.nSessoes == 0) break;
+                f->ts = &f->lote;
+                f->inicio = 0;
+                f->fim = f->lote.nSessoes;
+                nSessoes += (uint64_t) f->lote.nSessoes;
+                lidos++;
+            }
+            if (r < 0) break;
+            if (!vazio && lidos > 0) varrerFatias(fatias, lidos);
+        }
+        ok = r == 0 && !fx.erro;
+    }
+
+    long long total = 0;
+    long long *grupos = (long long*) calloc(p.nGrupos ? p.nGrupos : 1, sizeof(long long));
+    if (!grupos) { fprintf(stderr, "Erro de alocacao consulta.\n"); exit(EXIT_FAILURE); }
+    for (int t = 0; t < nThreads; ++t) {
+        total += fatias[t].total;
+        for (int g = 0; g < p.nGrupos; ++g) grupos[g] += fatias[t].grupos[g];
+        free(fatias[t].grupos);
+        liberarTabelaSessoes(&fatias[t].lote);
+    }
+
+    if (ok) {
+        printf("Sessoes encontradas: %lld de %llu\n", total, (unsigned long long) nSessoes);
+        if (p.agrupar == AGRUPAR_SUSPEITO) {
+            for (int g = 0; g < p.nGrupos; ++g)
+                if (grupos[g]) printf(" - %-32s %lld\n", g == 0 ? "(sem acusacao)" : dic.dicSuspeitos.nomes[g-1], grupos[g]);
+        } else if (p.agrupar == AGRUPAR_SALA) {
+            for (int g = 0; g < p.nGrupos; ++g)
+                if (grupos[g]) printf(" - %-32s %lld\n", dic.dicSalas.nomes[g], grupos[g]);
         }
-        tabela[i] = NULL;
     }
+    free(grupos);
+    free(contra);
+    fecharFluxo(&fx);
+    liberarTabelaSessoes(&dic);
+    return ok ? total : -1;
 }
 
 /* remover \n de fgets */
@@ -208,26 +6026,60 @@ void limparEntradaRestante(void) {
 /* explorarSalas() – navega pela árvore e ativa o sistema de pistas.
    Ao entrar em uma sala exibe a pista (quando existir) e adiciona à BST de pistas.
 */
-void explorarSalas(Sala *raiz, PistaNode **raizPistas) {
+void explorarSalas(Sala *raiz, PistaNode **raizPistas, ContextoSessao *ctx) {
     Sala *atual = raiz;
+    Sala *anterior = NULL;
     char opc;
     while (atual) {
-        printf("\nVocê entrou na sala: %s\n", atual->nome);
-        if (atual->pista[0] != '\0') {
-            printf("  Pista encontrada: \"%s\"\n", atual->pista);
-            *raizPistas = inserirPista(*raizPistas, atual->pista);
+        /* estatísticas contam só a entrada na sala, não as opções inválidas */
+        int entrou = atual != anterior;
+        anterior = atual;
+        if (entrou && ctx && ctx->estatisticas)
+            registrarNoEsboco(&ctx->estatisticas->visitasSalas, textoStr(&atual->nome));
+        if (entrou && ctx && ctx->mapaCalor)
+            registrarVisita(ctx->mapaCalor, atual->id);
+        if (entrou && ctx && ctx->registro)
+            registrarPassoSessao(ctx->registro, atual);
+        if (entrou && ctx && ctx->diario)
+            registrarEventoDiario(ctx->diario, "entrada", textoStr(&atual->nome), NULL);
+
+        printf("\nVocê entrou na sala: %s\n", textoStr(&atual->nome));
+        if (atual->pista.tam != 0) {
+            printf("  Pista encontrada: \"%s\"\n", textoStr(&atual->pista));
+            *raizPistas = inserirPista(*raizPistas, &atual->pista);
+            if (entrou && ctx && ctx->estatisticas)
+                registrarNoEsboco(&ctx->estatisticas->coletasPistas, textoStr(&atual->pista));
+            if (entrou && ctx && ctx->mapaCalor && ctx->tabela) {
+                const HashEntry *e = buscarEntradaTexto(ctx->tabela, &atual->pista);
+                if (e) registrarColeta(ctx->mapaCalor, e->id);
+            }
+            if (entrou && ctx && ctx->diario)
+                registrarEventoDiario(ctx->diario, "pista", textoStr(&atual->nome), textoStr(&atual->pista));
+            if (entrou && ctx && ctx->wal && !confirmarWal(ctx->wal, anexarWal(ctx->wal, textoStr(&atual->pista))))
+                fprintf(stderr, "Aviso: pista nao gravada no WAL.\n");
+            if (entrou && ctx && ctx->fatos && ctx->fatos->nFatos > 0) {
+                Deducao d;
+                deduzirSuspeitos(ctx->fatos, *raizPistas, &d);
+                exibirDeducao(ctx->fatos, &d);
+            }
         } else {
             printf("  (Nenhuma pista nesta sala)\n");
         }
 
         /* Menu */
-        printf("\nEscolha: (e) esquerda  (d) direita  (s) sair\n");
+        int temProximas = ctx && ctx->distancias, temBusca = ctx && ctx->tabela;
+        printf("\nEscolha: (e) esquerda  (d) direita%s%s  (s) sair\n",
+               temProximas ? "  (p) pistas proximas" : "", temBusca ? "  (b) buscar pista" : "");
         printf("Opcao: ");
         if (scanf(" %c", &opc) != 1) {
             printf("Entrada inválida. Encerrando.\n");
             break;
         }
         limparEntradaRestante();
+        if (ctx && ctx->diario) {
+            char mov[2] = { opc, '\0' };
+            registrarEventoDiario(ctx->diario, "movimento", textoStr(&atual->nome), mov);
+        }
 
         if (opc == 'e' || opc == 'E') {
             if (atual->esquerda) atual = atual->esquerda;
@@ -238,8 +6090,21 @@ void explorarSalas(Sala *raiz, PistaNode **raizPistas) {
         } else if (opc == 's' || opc == 'S') {
             printf("Exploração encerrada pelo jogador.\n");
             break;
+        } else if ((opc == 'p' || opc == 'P') && temProximas) {
+            exibirPistasProximas(ctx->distancias, ctx->tabela, atual->id);
+        } else if ((opc == 'b' || opc == 'B') && temBusca) {
+            /* busca aproximada no índice de trigramas mantido pela própria tabela */
+            char texto[MAX_PISTA];
+            printf("Pista procurada: ");
+            if (!fgets(texto, sizeof(texto), stdin)) {
+                printf("Entrada inválida. Encerrando.\n");
+                break;
+            }
+            if (!strchr(texto, '\n')) limparEntradaRestante();
+            strip_newline(texto);
+            if (texto[0]) executarDica(ctx->tabela, texto, -1);
         } else {
-            printf("Opção inválida. Use e, d ou s.\n");
+            printf("Opção inválida. Use e, d%s%s ou s.\n", temProximas ? ", p" : "", temBusca ? ", b" : "");
         }
     }
 }
@@ -247,18 +6112,20 @@ void explorarSalas(Sala *raiz, PistaNode **raizPistas) {
 /* Função auxiliar que percorre BST e conta quantas pistas apontam para 'suspeitoAlvo'.
    Utiliza a tabela hash para mapear cada pista -> suspeito.
 */
-void contarPistasPorSuspeitoRec(PistaNode *raiz, HashEntry *tabela[], const char *suspeitoAlvo, int *contador) {
+void contarPistasPorSuspeitoRec(PistaNode *raiz, TabelaHash *tabela, const char *suspeitoAlvo, int *contador) {
     if (!raiz) return;
     contarPistasPorSuspeitoRec(raiz->esq, tabela, suspeitoAlvo, contador);
-    const char *s = encontrarSuspeito(tabela, raiz->pista);
-    if (s && strcmp(s, suspeitoAlvo) == 0) (*contador)++;
+    const HashEntry *e = buscarEntradaTexto(tabela, &raiz->pista);
+    if (e && strcmp(textoStr(&e->suspeito), suspeitoAlvo) == 0) (*contador)++;
     contarPistasPorSuspeitoRec(raiz->dir, tabela, suspeitoAlvo, contador);
 }
 
 /* verificarSuspeitoFinal() – conduz à fase de julgamento final.
    Lista pistas coletadas, pede o nome do suspeito e verifica se há >=2 pistas que o apontam.
+   Quando o caso tem fatos, a dedução decide antes: acusado inocentado nunca é culpado e
+   acusado que é o culpado em todas as soluções dispensa a contagem.
 */
-void verificarSuspeitoFinal(PistaNode *raizPistas, HashEntry *tabela[]) {
+void verificarSuspeitoFinal(PistaNode *raizPistas, TabelaHash *tabela, ContextoSessao *ctx) {
     printf("\n===== Pistas coletadas (ordem alfabética) =====\n");
     if (!raizPistas) {
         printf("Nenhuma pista coletada.\n");
@@ -285,17 +6152,1233 @@ void verificarSuspeitoFinal(PistaNode *raizPistas, HashEntry *tabela[]) {
     printf("\nAcusado: %s\n", acusado);
     printf("Pistas que apontam para %s: %d\n", acusado, cont);
 
-    if (cont >= 2) {
+    int culpado = cont >= 2;
+    if (ctx && ctx->fatos && ctx->fatos->nFatos > 0) {
+        Deducao d;
+        deduzirSuspeitos(ctx->fatos, raizPistas, &d);
+        int id = buscarSuspeitoFato(ctx->fatos, acusado);
+        if (!d.consistente) {
+            printf("Os fatos coletados se contradizem; vale a contagem de pistas.\n");
+        } else if (id >= 0 && !conjTem(&d.possiveis, id)) {
+            printf("Os fatos coletados inocentam %s.\n", acusado);
+            culpado = 0;
+        } else if (id >= 0 && conjTem(&d.certos, id)) {
+            printf("Os fatos coletados provam a culpa de %s.\n", acusado);
+            culpado = 1;
+        }
+    }
+
+    if (culpado) {
         printf("\nVEREDICTO: Há pistas suficientes! %s é considerado culpado.\n", acusado);
     } else {
         printf("\nVEREDICTO: Pistas insuficientes. %s não pode ser acusado com segurança.\n", acusado);
     }
+    if (ctx && ctx->diario)
+        registrarEventoDiario(ctx->diario, "veredicto", acusado, culpado ? "culpado" : "insuficiente");
+    if (ctx && ctx->registro) {
+        strcpy(ctx->registro->acusado, acusado);
+        ctx->registro->veredicto = culpado ? VEREDICTO_CULPADO : VEREDICTO_INSUFICIENTE;
+    }
+}
+
+/* executarBusca() – modo de edição: imprime as pistas que contêm todas as palavras. */
+void executarBusca(TabelaHash *tabela, const char *consulta) {
+    IndiceInvertido ind;
+    construirIndiceInvertido(&ind, tabela);
+
+    int *ids = (int*) malloc((ind.nPistas ? ind.nPistas : 1) * sizeof(int));
+    if (!ids) { fprintf(stderr, "Erro de alocacao busca.\n"); exit(EXIT_FAILURE); }
+    int n = buscarPistasPorPalavras(&ind, consulta, ids, ind.nPistas);
+
+    printf("Pistas que mencionam \"%s\": %d\n", consulta, n);
+    for (int i = 0; i < n; ++i) {
+        const char *s = encontrarSuspeito(tabela, ind.pistas[ids[i]]);
+        printf(" - %s (suspeito: %s)\n", ind.pistas[ids[i]], s ? s : "?");
+    }
+    free(ids);
+    liberarIndiceInvertido(&ind);
+}
+
+/* listarEvidencias() – imprime as pistas (e salas) que apontam para um suspeito. */
+void listarEvidencias(const TabelaHash *tabela, const char *suspeito) {
+    const SuspeitoIndice *si = buscarSuspeitoIndice(tabela, suspeito);
+    if (!si || si->nPistas == 0) {
+        printf("Nenhuma pista aponta para %s.\n", suspeito);
+        return;
+    }
+    printf("Pistas que apontam para %s: %d\n", si->nome, si->nPistas);
+    for (int i = 0; i < si->nPistas; ++i) {
+        const HashEntry *e = entradaEm(tabela, si->pistas[i]);
+        printf(" - %s", textoStr(&e->pista));
+        if (e->salas) {
+            printf(" (");
+            for (const SalaRef *r = e->salas; r; r = r->prox)
+                printf("%s%s", textoStr(&r->sala->nome), r->prox ? ", " : "");
+            printf(")");
+        }
+        printf("\n");
+    }
+}
+
+static void coletarNomesSalas(const Sala *s, const char *nomes[], int *n) {
+    if (!s || *n >= MAX_CANDIDATOS) return;
+    nomes[(*n)++] = textoStr(&s->nome);
+    coletarNomesSalas(s->esquerda, nomes, n);
+    coletarNomesSalas(s->direita, nomes, n);
+}
+
+/* exibirPopulares() – salas e pistas mais frequentes segundo as estatísticas. */
+void exibirPopulares(const Estatisticas *est, const Sala *raiz, const TabelaHash *tabela) {
+    const char **nomes = (const char**) malloc(MAX_CANDIDATOS * sizeof(char*));
+    if (!nomes) { fprintf(stderr, "Erro de alocacao estatisticas.\n"); exit(EXIT_FAILURE); }
+    int n = 0;
+    coletarNomesSalas(raiz, nomes, &n);
+    printf("Salas mais visitadas (%llu visitas no total):\n",
+           (unsigned long long) atomic_load(&est->visitasSalas.total));
+    listarMaisFrequentes(&est->visitasSalas, nomes, n, 10);
+
+    n = 0;
+    IteradorTabela it;
+    iniciarIterador(&it, tabela);
+    for (const HashEntry *at; n < MAX_CANDIDATOS && (at = proximaEntrada(&it)); )
+        nomes[n++] = textoStr(&at->pista);
+    printf("Pistas mais coletadas (%llu coletas no total):\n",
+           (unsigned long long) atomic_load(&est->coletasPistas.total));
+    listarMaisFrequentes(&est->coletasPistas, nomes, n, 10);
+    free(nomes);
+}
+
+static double segundosDesde(const struct timespec *inicio) {
+    struct timespec agora;
+    clock_gettime(CLOCK_MONOTONIC, &agora);
+    return (double) (agora.tv_sec - inicio->tv_sec) + (agora.tv_nsec - inicio->tv_nsec) / 1e9;
+}
+
+static uint64_t proximoAleatorio(uint64_t *estado) {
+    *estado ^= *estado << 13;
+    *estado ^= *estado >> 7;
+    *estado ^= *estado << 17;
+    return *estado;
+}
+
+/* Uma rodada do benchmark: monta as árvores em pools novos e mede buscas da raiz às folhas */
+static void rodadaBenchPaginas(long n, int paginasGrandes) {
+    PoolNos salvoSalas = poolSalas, salvoPistas = poolPistas;
+    PoolNos vazioSalas = { sizeof(Sala), paginasGrandes, NULL, NULL, 0, NULL, {0} };
+    PoolNos vazioPistas = { sizeof(PistaNode), paginasGrandes, NULL, NULL, 0, NULL, {0} };
+    poolSalas = vazioSalas;
+    poolPistas = vazioPistas;
+
+    /* ordem aleatória de inserção: nós vizinhos na árvore ficam longe na memória */
+    long *ordem = (long*) malloc(n * sizeof(long));
+    if (!ordem) { fprintf(stderr, "Erro de alocacao benchmark.\n"); exit(EXIT_FAILURE); }
+    uint64_t semente = 0x9E3779B97F4A7C15ULL;
+    for (long i = 0; i < n; ++i) ordem[i] = i;
+    for (long i = n - 1; i > 0; --i) {
+        long j = (long) (proximoAleatorio(&semente) % (uint64_t) (i + 1));
+        long t = ordem[i]; ordem[i] = ordem[j]; ordem[j] = t;
+    }
+
+    /* salas: BST pelo id (aleatória, altura ~ 2 ln n); pistas: a árvore AVL do jogo */
+    Sala *raiz = NULL;
+    PistaNode *pistas = NULL;
+    char nome[MAX_NOME];
+    for (long i = 0; i < n; ++i) {
+        snprintf(nome, sizeof(nome), "S%07ld", ordem[i]);
+        Sala *nova = criarSala(nome, NULL);
+        nova->id = (int) ordem[i];
+        Sala **elo = &raiz;
+        while (*elo) elo = nova->id < (*elo)->id ? &(*elo)->esquerda : &(*elo)->direita;
+        *elo = nova;
+        snprintf(nome, sizeof(nome), "P%07ld", ordem[i]);
+        Texto t = criarTexto(&arenaJogo, nome, MAX_PISTA);
+        pistas = inserirPista(pistas, &t);
+    }
+    free(ordem);
+
+    long buscas = 2 * n, achadas = 0;
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (long i = 0; i < buscas; ++i) {
+        int alvo = (int) (proximoAleatorio(&semente) % (uint64_t) n);
+        const Sala *at = raiz;
+        while (at && at->id != alvo) at = alvo < at->id ? at->esquerda : at->direita;
+        achadas += at != NULL;
+    }
+    double tSalas = segundosDesde(&inicio);
+
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (long i = 0; i < buscas; ++i) {
+        snprintf(nome, sizeof(nome), "P%07ld", (long) (proximoAleatorio(&semente) % (uint64_t) n));
+        const PistaNode *at = pistas;
+        int cmp;
+        while (at && (cmp = strcmp(nome, textoStr(&at->pista))) != 0) at = cmp < 0 ? at->esq : at->dir;
+        achadas += at != NULL;
+    }
+    double tPistas = segundosDesde(&inicio);
+
+    printf("%-16s salas %7.1f ns/busca  pistas %7.1f ns/busca  (%ld/%ld achadas)\n",
+           paginasGrandes ? "paginas grandes" : "paginas comuns",
+           tSalas * 1e9 / buscas, tPistas * 1e9 / buscas, achadas, 2 * buscas);
+    printf("%-16s regioes de 2 MB: hugetlb %d, thp %d, comuns %d, malloc %d\n", "",
+           poolSalas.nRegioes[PAGINAS_HUGETLB] + poolPistas.nRegioes[PAGINAS_HUGETLB],
+           poolSalas.nRegioes[PAGINAS_THP] + poolPistas.nRegioes[PAGINAS_THP],
+           poolSalas.nRegioes[PAGINAS_PEQUENAS] + poolPistas.nRegioes[PAGINAS_PEQUENAS],
+           poolSalas.nRegioes[PAGINAS_MALLOC] + poolPistas.nRegioes[PAGINAS_MALLOC]);
+
+    liberarPool(&poolSalas);
+    liberarPool(&poolPistas);
+    poolSalas = salvoSalas;
+    poolPistas = salvoPistas;
+}
+
+/* executarBenchPaginas() – mede percursos em árvores de n salas e n pistas, com e sem páginas grandes.
+   Cada rodada usa pools próprios; os do jogo não são tocados. */
+void executarBenchPaginas(long n) {
+    if (n < 1 || n > 100000000L) {
+        fprintf(stderr, "Numero de nos invalido: %ld\n", n);
+        return;
+    }
+    printf("Benchmark de paginas: %ld salas e %ld pistas, %ld buscas em cada arvore\n", n, n, 2 * n);
+    rodadaBenchPaginas(n, 0);
+    rodadaBenchPaginas(n, 1);
+}
+
+/* executarRoteiro() – sessão sem terminal: segue os movimentos (e/d) e acusa; retorna VEREDICTO_*.
+   Coleta as pistas como explorarSalas(); movimentos para onde não há sala são ignorados.
+   Só lê o mapa e a tabela (que não pode estar migrando), então serve aos processos do pré-fork.
+*/
+int executarRoteiro(const Sala *raiz, TabelaHash *tabela, const char *movimentos, const char *acusado) {
+    PistaNode *coletadas = NULL;
+    const Sala *atual = raiz;
+    for (const char *m = movimentos; atual; ++m) {
+        if (atual->pista.tam != 0) coletadas = inserirPista(coletadas, &atual->pista);
+        if (*m == '\0') break;
+        const Sala *prox = (*m == 'e' || *m == 'E') ? atual->esquerda
+                         : (*m == 'd' || *m == 'D') ? atual->direita : NULL;
+        if (prox) atual = prox;
+    }
+    int veredicto = VEREDICTO_SEM_ACUSACAO;
+    if (acusado && acusado[0] != '\0') {
+        int cont = 0;
+        contarPistasPorSuspeitoRec(coletadas, tabela, acusado, &cont);
+        veredicto = cont >= 2 ? VEREDICTO_CULPADO : VEREDICTO_INSUFICIENTE;
+    }
+    liberarPistas(coletadas);
+    return veredicto;
+}
+
+/* Memória só deste processo (kB), de /proc/self/smaps_rollup; -1 se indisponível */
+static long memoriaPrivadaKb(void) {
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+    if (!f) return -1;
+    char linha[256];
+    long total = -1, kb;
+    while (fgets(linha, sizeof(linha), f))
+        if (sscanf(linha, "Private_Dirty: %ld kB", &kb) == 1) total = kb;
+    fclose(f);
+    return total;
+}
+
+/* Corpo de um filho: joga as linhas i, i+n, i+2n, ... e sai sem liberar o que veio do pai */
+static void trabalharRoteiros(const Sala *raiz, TabelaHash *tabela, char **linhas, int nLinhas,
+                              int indice, int nProcessos) {
+    /* nada herdado pode ser escrito: nós e textos novos vão para regiões próprias do filho,
+       e os nós devolvidos pelo pai (que moram em páginas compartilhadas) são esquecidos */
+    poolPistas.restante = poolSalas.restante = 0;
+    poolPistas.devolvidos = poolSalas.devolvidos = NULL;
+    poolPistas.regioes = poolSalas.regioes = NULL;
+    arenaJogo.blocos = NULL;
+
+    int cont[3] = {0, 0, 0};
+    for (int i = indice; i < nLinhas; i += nProcessos) {
+        char acusado[MAX_NOME];
+        const char *sep = strchr(linhas[i], ';');
+        size_t n = sep ? (size_t) (sep - linhas[i]) : strlen(linhas[i]);
+        /* a linha é do pai (página compartilhada): os movimentos vão para uma cópia do filho,
+           do tamanho do roteiro, para que nenhum seja cortado */
+        char *movimentos = (char*) malloc(n + 1);
+        if (!movimentos) { fprintf(stderr, "Erro de alocacao roteiro.\n"); _exit(1); }
+        memcpy(movimentos, linhas[i], n);
+        movimentos[n] = '\0';
+        snprintf(acusado, sizeof(acusado), "%s", sep ? sep + 1 : "");
+        cont[executarRoteiro(raiz, tabela, movimentos, acusado)]++;
+        free(movimentos);
+    }
+    printf("[processo %d] sessoes %d: culpados %d, insuficientes %d, sem acusacao %d; memoria privada %ld kB\n",
+           indice, cont[VEREDICTO_CULPADO] + cont[VEREDICTO_INSUFICIENTE] + cont[VEREDICTO_SEM_ACUSACAO],
+           cont[VEREDICTO_CULPADO], cont[VEREDICTO_INSUFICIENTE], cont[VEREDICTO_SEM_ACUSACAO],
+           memoriaPrivadaKb());
+    fflush(stdout);
+    liberarPool(&poolPistas);
+    liberarArena(&arenaJogo);
+    _exit(0);
+}
+
+/* executarPrefork() – distribui as sessões do arquivo de roteiros entre nProcessos filhos.
+   O pai já montou o mapa e a tabela; depois do fork ninguém escreve neles (sem
+   contadores nem marcas em Sala/HashEntry), então as páginas continuam compartilhadas.
+   Retorna quantos filhos terminaram com sucesso.
+*/
+int executarPrefork(const Sala *raiz, TabelaHash *tabela, int nProcessos, const char *arquivo) {
+    if (nProcessos < 1 || nProcessos > 1024) {
+        fprintf(stderr, "Numero de processos invalido: %d\n", nProcessos);
+        return 0;
+    }
+    size_t tam;
+    char *texto = (char*) lerArquivoInteiro(arquivo, &tam);
+    if (!texto) { fprintf(stderr, "Nao foi possivel ler %s.\n", arquivo); return 0; }
+    texto[tam] = '\0'; /* lerArquivoInteiro sempre deixa folga no fim */
+
+    int nLinhas = 0, capLinhas = 0;
+    char **linhas = NULL;
+    for (char *p = texto; *p; ) {
+        char *fim = strchr(p, '\n');
+        if (fim) *fim = '\0';
+        size_t n = strlen(p);
+        if (n && p[n-1] == '\r') p[n-1] = '\0';
+        if (p[0] != '\0' && p[0] != '#') {
+            linhas = (char**) crescerVetor((void*) linhas, &capLinhas, nLinhas + 1, sizeof(char*));
+            linhas[nLinhas++] = p;
+        }
+        if (!fim) break;
+        p = fim + 1;
+    }
+
+    /* leituras nos filhos não podem migrar entradas: isso escreveria no índice */
+    concluirMigracao(tabela);
+    fflush(stdout);
+    printf("Pai: %d sessoes para %d processos; memoria privada %ld kB\n",
+           nLinhas, nProcessos, memoriaPrivadaKb());
+    fflush(stdout);
+
+    int criados = 0;
+    for (int i = 0; i < nProcessos; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) { perror("fork"); break; }
+        if (pid == 0) trabalharRoteiros(raiz, tabela, linhas, nLinhas, i, nProcessos); /* não retorna */
+        criados++;
+    }
+    int ok = 0, status;
+    while (criados-- > 0)
+        if (wait(&status) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) ok++;
+    free(linhas);
+    free(texto);
+    return ok;
+}
+
+void arquivarPistasColetadas(ArquivoCasos *a, const char *jogador, const PistaNode *raiz) {
+    if (!raiz) return;
+    arquivarPistasColetadas(a, jogador, raiz->esq);
+    arquivarPista(a, jogador, textoStr(&raiz->pista));
+    arquivarPistasColetadas(a, jogador, raiz->dir);
+}
+
+/* Decodifica e imprime as ocorrências, uma linha por caso; retorna quantos casos */
+static int listarOcorrencias(const IndiceGlobal *ind, const TermoGlobal *t) {
+    Leitor l = { t->ocorrencias, t->ocorrencias + t->nBytes, 0 };
+    uint32_t caso = 0, sala = 0;
+    int nCasos = 0;
+    for (uint32_t i = 0; i < t->nOcorrencias; ++i) {
+        uint32_t dc = lerVarintLimitado(&l), ds = lerVarintLimitado(&l);
+        if (l.erro) break;
+        if (i > 0 && dc == 0) { sala += ds; printf(", %u", sala); continue; }
+        /* delta que passaria do último caso: ocorrência corrompida, para aqui */
+        if (dc >= (uint32_t) ind->nCasos - caso) break;
+        caso += dc;
+        sala = ds;
+        printf("%s - %s: salas %u", nCasos ? "\n" : "", ind->casos[caso], sala);
+        nCasos++;
+    }
+    if (nCasos) printf("\n");
+    return nCasos;
+}
+
+void executarOndeAparece(const char *arquivoIndice, const char *texto) {
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    IndiceGlobal ind;
+    if (!carregarIndiceGlobal(&ind, arquivoIndice)) {
+        fprintf(stderr, "Nao foi possivel ler %s.\n", arquivoIndice);
+        return;
+    }
+    double tCarga = segundosDesde(&inicio);
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    const TermoGlobal *suspeito = buscarTermoGlobal(&ind, TERMO_SUSPEITO, texto);
+    const TermoGlobal *pista = buscarTermoGlobal(&ind, TERMO_PISTA, texto);
+    if (suspeito) {
+        printf("Suspeito %s implicado por pistas em %u salas:\n", texto, suspeito->nOcorrencias);
+        printf("(%d casos)\n", listarOcorrencias(&ind, suspeito));
+    }
+    if (pista) {
+        printf("Pista \"%s\" em %u salas:\n", texto, pista->nOcorrencias);
+        printf("(%d casos)\n", listarOcorrencias(&ind, pista));
+    }
+    if (!suspeito && !pista) printf("%s nao aparece em nenhum caso do indice.\n", texto);
+    printf("(indice carregado em %.2f ms, consulta em %.3f ms)\n", tCarga * 1e3, segundosDesde(&inicio) * 1e3);
+    liberarIndiceGlobal(&ind);
+}
+
+/* Edições toleradas quando o jogador não diz: cresce com o tamanho do texto */
+static int limiteAutomatico(const char *texto) {
+    size_t n = strlen(texto);
+    return n <= 4 ? 1 : n <= 12 ? 2 : n <= 24 ? 3 : 4;
+}
+
+void executarDica(TabelaHash *tabela, const char *texto, int k) {
+    IndiceTrigramas local;
+    const IndiceTrigramas *ind = tabela->trigramas;
+    if (!ind) { /* tabela montada sem índice: um só para esta dica, sem tocar na tabela */
+        preencherTrigramas(&local, tabela);
+        ind = &local;
+    }
+    if (k < 0) k = limiteAutomatico(texto);
+    SugestaoPista sug[MAX_SUGESTOES];
+    int achadas = buscarPistasAproximadas(ind, texto, k, sug, MAX_SUGESTOES);
+    if (achadas == 0) {
+        printf("Nenhuma pista a ate %d edicoes de \"%s\".\n", k, texto);
+    } else {
+        for (int i = 0; i < achadas && i < MAX_SUGESTOES; ++i) {
+            const char *pista = ind->pistas[sug[i].id];
+            const char *s = encontrarSuspeito(tabela, pista);
+            printf("%s \"%s\" (%d %s) -> suspeito: %s\n", i == 0 ? "Voce quis dizer" : "   ou",
+                   pista, sug[i].distancia, sug[i].distancia == 1 ? "edicao" : "edicoes", s ? s : "?");
+        }
+    }
+    if (ind == &local) liberarIndiceTrigramas(&local);
+}
+
+/* Aplica 'erros' edições aleatórias (troca, remoção ou inserção de letra) */
+static void digitarComErros(const char *orig, char *dst, int erros, uint64_t *semente) {
+    int n = (int) strlen(orig);
+    memcpy(dst, orig, (size_t) n + 1);
+    for (int e = 0; e < erros && n > 1; ++e) {
+        int pos = (int) (proximoAleatorio(semente) % (uint64_t) n);
+        char letra = (char) ('a' + proximoAleatorio(semente) % 26);
+        switch (proximoAleatorio(semente) % 3) {
+            case 0: dst[pos] = letra; break;
+            case 1: memmove(dst + pos, dst + pos + 1, (size_t) (n - pos)); n--; break;
+            default:
+                if (n + 1 >= MAX_PISTA) break;
+                memmove(dst + pos + 1, dst + pos, (size_t) (n - pos + 1));
+                dst[pos] = letra;
+                n++;
+        }
+    }
+}
+
+void executarBenchDica(int n) {
+    static const char *palavras[] = {
+        "pegada", "suja", "perfume", "feminino", "caro", "livro", "rasgado", "copo", "fragmento",
+        "esmalte", "filtro", "cigarro", "luva", "encharcada", "chave", "dourada", "bilhete",
+        "queimado", "lenço", "bordado", "relogio", "parado", "taça", "vinho", "janela", "aberta",
+        "botão", "casaco", "carta", "anonima", "vela", "apagada", "faca", "cozinha", "fio", "cabelo"
+    };
+    const int nPalavras = (int) (sizeof(palavras) / sizeof(palavras[0]));
+    if (n < 1) n = 1;
+    char **pistas = (char**) malloc((size_t) n * sizeof(char*));
+    if (!pistas) { fprintf(stderr, "Erro de alocacao dica.\n"); exit(EXIT_FAILURE); }
+    uint64_t semente = 0x2545F4914F6CDD1Dull;
+    for (int i = 0; i < n; ++i) {
+        char buf[MAX_PISTA];
+        int L = snprintf(buf, sizeof(buf), "%s", palavras[proximoAleatorio(&semente) % nPalavras]);
+        int nPal = 2 + (int) (proximoAleatorio(&semente) % 4);
+        for (int w = 1; w < nPal; ++w)
+            L += snprintf(buf + L, sizeof(buf) - (size_t) L, " %s", palavras[proximoAleatorio(&semente) % nPalavras]);
+        snprintf(buf + L, sizeof(buf) - (size_t) L, " %d", i); /* pistas distintas */
+        pistas[i] = duplicarTexto(buf);
+    }
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    IndiceTrigramas ind;
+    construirIndiceTrigramas(&ind, (const char *const *) pistas, n);
+    printf("%d pistas, %d trigramas, indice montado em %.1f ms\n", n, ind.nTrigramas, segundosDesde(&inicio) * 1e3);
+
+    const int consultas = 200, k = 2;
+    double tIndice = 0, tVarredura = 0;
+    int achouIndice = 0, concordam = 0;
+    SugestaoPista sug[MAX_SUGESTOES];
+    for (int c = 0; c < consultas; ++c) {
+        int alvo = (int) (proximoAleatorio(&semente) % (uint64_t) n);
+        char q[MAX_PISTA + 2];
+        digitarComErros(pistas[alvo], q, 1 + c % 2, &semente);
+
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        int nIndice = buscarPistasAproximadas(&ind, q, k, sug, MAX_SUGESTOES);
+        tIndice += segundosDesde(&inicio);
+        for (int i = 0; i < nIndice && i < MAX_SUGESTOES; ++i)
+            if (sug[i].id == alvo) { achouIndice++; break; }
+
+        /* varredura completa: distância de edição contra todas as pistas */
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        char nq[MAX_PISTA + 2];
+        int L = normalizarPista(q, nq, sizeof(nq));
+        uint64_t peq[256];
+        if (L <= 64) montarPeq(peq, (const unsigned char*) nq, L);
+        int nVarredura = 0;
+        for (int i = 0; i < n; ++i) {
+            const char *alvoNorm = ind.normalizadas[i];
+            if (distanciaNormalizada(peq, nq, L, alvoNorm, (int) strlen(alvoNorm), k) <= k) nVarredura++;
+        }
+        tVarredura += segundosDesde(&inicio);
+        if (nVarredura == nIndice) concordam++;
+    }
+    printf("consulta com ate %d edicoes: indice %.1f us, varredura completa %.1f us\n",
+           k, tIndice * 1e6 / consultas, tVarredura * 1e6 / consultas);
+    printf("pista original entre as sugestoes: %d de %d; mesmo total que a varredura: %d de %d\n",
+           achouIndice, consultas, concordam, consultas);
+    liberarIndiceTrigramas(&ind);
+    for (int i = 0; i < n; ++i) free(pistas[i]);
+    free(pistas);
+}
+
+void executarDeducao(const BaseFatos *b, const char *pistas) {
+    PistaNode *coletadas = NULL;
+    char lista[4096];
+    snprintf(lista, sizeof(lista), "%s", pistas);
+    for (char *p = lista, *fim; p; p = fim) {
+        if ((fim = strchr(p, ';'))) *fim++ = '\0';
+        if (!*p) continue;
+        Texto t = criarTexto(&arenaJogo, p, MAX_PISTA);
+        coletadas = inserirPista(coletadas, &t);
+    }
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    Deducao d;
+    deduzirSuspeitos(b, coletadas, &d);
+    double t = segundosDesde(&inicio);
+    printf("Fatos do caso: %d, suspeitos: %d, culpados no maximo: %d\n", b->nFatos, b->nSuspeitos, b->maxCulpados);
+    exibirDeducao(b, &d);
+    printf("(deducao em %.1f us, %llu nos de busca)\n", t * 1e6, d.nos);
+    liberarPistas(coletadas);
+}
+
+void executarBenchDeducao(int n) {
+    if (n < 2) n = 2;
+    if (n > MAX_SUSPEITOS_DEDUCAO) n = MAX_SUSPEITOS_DEDUCAO;
+    BaseFatos b;
+    iniciarBaseFatos(&b);
+    char nome[MAX_NOME], pista[MAX_PISTA], grupo[MAX_PISTA];
+    for (int i = 0; i < n; ++i) {
+        snprintf(nome, sizeof(nome), "Suspeito %d", i);
+        registrarSuspeitoFato(&b, nome);
+    }
+    /* fatos coerentes com um culpado sorteado: exonerações e álibis de inocentes e
+       grupos "um destes" que sempre o incluem */
+    uint64_t semente = 0x9E3779B97F4A7C15ull;
+    int culpado = (int) (proximoAleatorio(&semente) % (uint64_t) n);
+    for (int f = 0; f < n; ++f) {
+        snprintf(pista, sizeof(pista), "pista %d", f);
+        int s = (int) (proximoAleatorio(&semente) % (uint64_t) n);
+        if (s == culpado) s = (s + 1) % n;
+        int r = (int) (proximoAleatorio(&semente) % 10);
+        if (r < 4) {
+            adicionarFato(&b, pista, "exonera", b.suspeitos[s], NULL);
+        } else if (r < 8) {
+            int t = (int) (proximoAleatorio(&semente) % (uint64_t) n);
+            adicionarFato(&b, pista, "alibi", b.suspeitos[s], b.suspeitos[t]);
+        } else {
+            int L = snprintf(grupo, sizeof(grupo), "%s", b.suspeitos[culpado]);
+            int extras = 2 + (int) (proximoAleatorio(&semente) % 6);
+            for (int k = 0; k < extras; ++k)
+                L += snprintf(grupo + L, sizeof(grupo) - (size_t) L, ";%s",
+                              b.suspeitos[proximoAleatorio(&semente) % (uint64_t) n]);
+            adicionarFato(&b, pista, "um_de", grupo, NULL);
+        }
+    }
+    PistaNode *coletadas = NULL;
+    double total = 0, pior = 0;
+    unsigned long long nos = 0;
+    int erros = 0;
+    Deducao d;
+    for (int f = 0; f < b.nFatos; ++f) {
+        Texto t = criarTexto(&arenaJogo, b.fatos[f].pista, MAX_PISTA);
+        coletadas = inserirPista(coletadas, &t);
+        struct timespec inicio;
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        deduzirSuspeitos(&b, coletadas, &d);
+        double dt = segundosDesde(&inicio);
+        total += dt;
+        if (dt > pior) pior = dt;
+        nos += d.nos;
+        if (!d.consistente || !conjTem(&d.possiveis, culpado)) erros++;
+    }
+    printf("%d suspeitos, %d fatos: deducao a cada pista %.1f us em media (pior %.1f us), %.1f nos de busca\n",
+           n, b.nFatos, total * 1e6 / b.nFatos, pior * 1e6, (double) nos / b.nFatos);
+    printf("com todas as pistas: %d possiveis, %d certos; culpado sorteado: %s%s\n",
+           conjContar(&d.possiveis), conjContar(&d.certos), b.suspeitos[culpado],
+           erros ? " (ERRO: descartado em alguma deducao)" : "");
+    liberarPistas(coletadas);
+    liberarBaseFatos(&b);
+}
+
+void executarBenchGrafo(long n, int nThreads) {
+    if (n < 1) n = 1;
+    if (n > 100000000) n = 100000000;
+    int nPistas = (int) n, nSuspeitos = nPistas / 100 > 2 ? nPistas / 100 : 2;
+    /* cada pista aponta para um suspeito (os primeiros concentram mais pistas) e 30%
+       também citam de 1 a 3 outros */
+    uint64_t semente = 0xD1B54A32D192ED03ull;
+    int *arestas = NULL;
+    long long nArestas = 0, cap = 0;
+    for (int p = 0; p < nPistas; ++p) {
+        double u = (double) (proximoAleatorio(&semente) >> 11) / (double) (1ull << 53);
+        int ligados[4], nLigados = 0;
+        ligados[nLigados++] = (int) (u * u * nSuspeitos);
+        int extras = proximoAleatorio(&semente) % 10 < 3 ? 1 + (int) (proximoAleatorio(&semente) % 3) : 0;
+        for (int k = 0; k < extras; ++k) {
+            int s = (int) (proximoAleatorio(&semente) % (uint64_t) nSuspeitos), repetido = 0;
+            for (int j = 0; j < nLigados; ++j) repetido |= ligados[j] == s;
+            if (!repetido) ligados[nLigados++] = s;
+        }
+        for (int j = 0; j < nLigados; ++j) anexarAresta(&arestas, &nArestas, &cap, ligados[j], p);
+    }
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    GrafoEvidencias g;
+    construirGrafo(&g, nSuspeitos, nPistas, arestas, nArestas);
+    free(arestas);
+    printf("CSR montado em %.1f ms\n", segundosDesde(&inicio) * 1e3);
+
+    AnaliseGrafo um, varios;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    analisarGrafo(&g, &um, 1);
+    double tUm = segundosDesde(&inicio);
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    analisarGrafo(&g, &varios, nThreads);
+    double tVarios = segundosDesde(&inicio);
+    exibirAnaliseGrafo(&g, &varios);
+    int iguais = um.nComponentes == varios.nComponentes && um.maiorComponente == varios.maiorComponente
+              && um.nIdentificadoras == varios.nIdentificadoras
+              && memcmp(um.histSuspeitos, varios.histSuspeitos, sizeof(um.histSuspeitos)) == 0
+              && memcmp(um.histPistas, varios.histPistas, sizeof(um.histPistas)) == 0;
+    printf("analise: 1 thread %.1f ms, %d threads %.1f ms (%s)\n", tUm * 1e3, varios.nThreads, tVarios * 1e3,
+           iguais ? "mesmo resultado" : "ERRO: resultados diferentes");
+    liberarAnaliseGrafo(&um);
+    liberarAnaliseGrafo(&varios);
+    liberarGrafo(&g);
+}
+
+void executarProximas(const Sala *raiz, int nSalas, const TabelaHash *tabela, const char *sala) {
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    TabelaDistancias t;
+    construirDistancias(&t, raiz, nSalas, tabela);
+    double tMontagem = segundosDesde(&inicio);
+    int id = -1;
+    for (int i = 0; i < t.nSalas && id < 0; ++i)
+        if (strcmp(textoStr(&t.salas[i]->nome), sala) == 0) id = i;
+    if (id < 0) {
+        printf("Sala desconhecida: %s\n", sala);
+    } else {
+        printf("Pistas mais proximas de %s:\n", sala);
+        exibirPistasProximas(&t, tabela, id);
+    }
+    printf("(tabela de %d salas x %d suspeitos montada em %.2f ms, %zu bytes)\n", t.nSalas, t.nSuspeitos,
+           tMontagem * 1e3, (size_t) t.nSalas * t.nSuspeitos * sizeof(uint16_t));
+    liberarDistancias(&t);
+}
+
+/* A busca que a tabela substitui: BFS a partir da sala até uma pista do suspeito */
+static int buscarPistaMaisProxima(const TabelaDistancias *t, TabelaHash *tabela, const char *suspeito,
+                                  int origem, int *fila, int *marca, int carimbo) {
+    int ini = 0, fim = 0;
+    fila[fim++] = origem;
+    marca[origem] = carimbo;
+    for (int dist = 0; ini < fim; ++dist) {
+        for (int nivel = fim; ini < nivel; ++ini) {
+            const Sala *s = t->salas[fila[ini]];
+            if (s->pista.tam) {
+                const char *dono = encontrarSuspeito(tabela, textoStr(&s->pista));
+                if (dono && strcmp(dono, suspeito) == 0) return dist;
+            }
+            int vizinhos[3] = { t->vizinhos[s->id][0], s->esquerda ? s->esquerda->id : -1, s->direita ? s->direita->id : -1 };
+            for (int k = 0; k < 3; ++k)
+                if (vizinhos[k] >= 0 && marca[vizinhos[k]] != carimbo) {
+                    marca[vizinhos[k]] = carimbo;
+                    fila[fim++] = vizinhos[k];
+                }
+        }
+    }
+    return DISTANCIA_INFINITA;
+}
+
+void executarBenchProximas(long n) {
+    if (n < 2) n = 2;
+    if (n > 10000000) n = 10000000;
+    const int nSuspeitos = 64;
+    TabelaHash tabela;
+    inicializarTabelaHash(&tabela);
+    /* árvore aleatória (BST por uma chave sorteada) com pista em 1 de cada 10 salas */
+    uint64_t semente = 0x8CB92BA72F3D8DD7ull;
+    Sala *raiz = NULL;
+    char nome[MAX_NOME], pista[MAX_PISTA], suspeito[MAX_NOME];
+    for (long i = 0; i < n; ++i) {
+        snprintf(nome, sizeof(nome), "S%07ld", i);
+        int comPista = proximoAleatorio(&semente) % 10 == 0;
+        snprintf(pista, sizeof(pista), "P%07ld", i);
+        Sala *nova = criarSala(nome, comPista ? pista : NULL);
+        nova->id = (int) (proximoAleatorio(&semente) >> 33);
+        Sala **elo = &raiz;
+        while (*elo) elo = nova->id < (*elo)->id ? &(*elo)->esquerda : &(*elo)->direita;
+        *elo = nova;
+        if (comPista) {
+            snprintf(suspeito, sizeof(suspeito), "Suspeito %d", (int) (proximoAleatorio(&semente) % nSuspeitos));
+            inserirNaHash(&tabela, pista, suspeito);
+        }
+    }
+    int nSalas = numerarSalas(raiz);
+    vincularSalas(&tabela, raiz);
+
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    TabelaDistancias t;
+    construirDistancias(&t, raiz, nSalas, &tabela);
+    printf("%d salas, %d suspeitos: tabela montada em %.1f ms (%.1f MB)\n", nSalas, t.nSuspeitos,
+           segundosDesde(&inicio) * 1e3, (double) nSalas * t.nSuspeitos * sizeof(uint16_t) / (1 << 20));
+
+    const int consultas = 2000;
+    int *fila = (int*) malloc((size_t) nSalas * sizeof(int));
+    int *marca = (int*) calloc((size_t) nSalas, sizeof(int));
+    int *origens = (int*) malloc(consultas * sizeof(int));
+    int *alvos = (int*) malloc(consultas * sizeof(int));
+    if (!fila || !marca || !origens || !alvos) { fprintf(stderr, "Erro de alocacao benchmark.\n"); exit(EXIT_FAILURE); }
+    for (int c = 0; c < consultas; ++c) {
+        origens[c] = (int) (proximoAleatorio(&semente) % (uint64_t) nSalas);
+        alvos[c] = (int) (proximoAleatorio(&semente) % (uint64_t) t.nSuspeitos);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    unsigned long long soma = 0;
+    for (int c = 0; c < consultas; ++c) soma += distanciaPista(&t, alvos[c], origens[c]);
+    double tTabela = segundosDesde(&inicio);
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int concordam = 0;
+    for (int c = 0; c < consultas; ++c) {
+        int d = buscarPistaMaisProxima(&t, &tabela, tabela.suspeitos[alvos[c]].nome, origens[c], fila, marca, c + 1);
+        concordam += d == (int) distanciaPista(&t, alvos[c], origens[c]);
+    }
+    double tBusca = segundosDesde(&inicio);
+    printf("consulta: tabela %.3f us, BFS por consulta %.1f us; mesma distancia em %d de %d (soma %llu)\n",
+           tTabela * 1e6 / consultas, tBusca * 1e6 / consultas, concordam, consultas, soma);
+    free(fila); free(marca); free(origens); free(alvos);
+    liberarDistancias(&t);
+    liberarTabelaHash(&tabela);
+    liberarSalas(raiz);
+}
+
+static int salaPorNome(const MapaSalas *m, const char *nome) {
+    for (int i = 0; i < m->nSalas; ++i)
+        if (strcmp(textoStr(&m->salas[i]->nome), nome) == 0) return i;
+    return -1;
+}
+
+void executarRotas(const MapaSalas *m, const char *origem, const char *destino, int k,
+                   const char *const *evitar, int nEvitar, int exigirPista) {
+    int o = salaPorNome(m, origem), d = salaPorNome(m, destino);
+    if (o < 0 || d < 0) {
+        printf("Sala desconhecida: %s\n", o < 0 ? origem : destino);
+        return;
+    }
+    uint8_t *mascara = (uint8_t*) calloc((size_t) m->nSalas + 1, 1);
+    if (!mascara) { fprintf(stderr, "Erro de alocacao rotas.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < nEvitar; ++i) {
+        int s = salaPorNome(m, evitar[i]);
+        if (s < 0) printf("Sala desconhecida (ignorada): %s\n", evitar[i]);
+        else mascara[s] = 1;
+    }
+    BuscaRotas b;
+    iniciarBuscaRotas(&b, m);
+    Rota rotas[MAX_ROTAS];
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int n = buscarRotas(&b, o, d, k, mascara, exigirPista, rotas);
+    double t = segundosDesde(&inicio);
+    if (n == 0) printf("Nenhuma rota de %s a %s com essas restricoes.\n", origem, destino);
+    exibirRotas(m, rotas, n);
+    printf("(%d rotas em %.1f us, %llu buscas de caminho)\n", n, t * 1e6, b.nBuscas);
+    for (int i = 0; i < n; ++i) liberarRota(&rotas[i]);
+    liberarBuscaRotas(&b);
+    free(mascara);
+}
+
+void executarBenchRotas(long n, int k) {
+    if (n < 2) n = 2;
+    if (n > 10000000) n = 10000000;
+    if (k < 1) k = 1;
+    if (k > MAX_ROTAS) k = MAX_ROTAS;
+    /* árvore aleatória e n/20 passagens sorteadas, de custo 1 a 3 */
+    uint64_t semente = 0x5851F42D4C957F2Dull;
+    Sala *raiz = NULL;
+    Sala **todas = (Sala**) malloc((size_t) n * sizeof(Sala*));
+    if (!todas) { fprintf(stderr, "Erro de alocacao benchmark.\n"); exit(EXIT_FAILURE); }
+    char nome[MAX_NOME];
+    for (long i = 0; i < n; ++i) {
+        snprintf(nome, sizeof(nome), "S%07ld", i);
+        Sala *nova = criarSala(nome, proximoAleatorio(&semente) % 10 == 0 ? "pista" : NULL);
+        nova->id = (int) (proximoAleatorio(&semente) >> 33);
+        Sala **elo = &raiz;
+        while (*elo) elo = nova->id < (*elo)->id ? &(*elo)->esquerda : &(*elo)->direita;
+        *elo = nova;
+        todas[i] = nova;
+    }
+    int nSalas = numerarSalas(raiz);
+    int nPassagens = (int) (n / 20);
+    Passagem *passagens = (Passagem*) malloc(((size_t) nPassagens + 1) * sizeof(Passagem));
+    if (!passagens) { fprintf(stderr, "Erro de alocacao benchmark.\n"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < nPassagens; ++i) {
+        passagens[i].a = todas[proximoAleatorio(&semente) % (uint64_t) n];
+        do passagens[i].b = todas[proximoAleatorio(&semente) % (uint64_t) n]; while (passagens[i].b == passagens[i].a);
+        passagens[i].custo = 1 + (int) (proximoAleatorio(&semente) % 3);
+    }
+    MapaSalas m;
+    montarMapaSalas(&m, raiz, nSalas, passagens, nPassagens);
+    free(passagens);
+    free(todas);
+
+    const int consultas = 50;
+    BuscaRotas rapida, completa;
+    iniciarBuscaRotas(&rapida, &m);
+    iniciarBuscaRotas(&completa, &m);
+    completa.completo = 1;
+    double tRapida = 0, tCompleta = 0;
+    int concordam = 0, total = 0;
+    Rota a[MAX_ROTAS], b[MAX_ROTAS];
+    for (int c = 0; c < consultas; ++c) {
+        int o = (int) (proximoAleatorio(&semente) % (uint64_t) nSalas), d = (int) (proximoAleatorio(&semente) % (uint64_t) nSalas);
+        int via = c % 2;
+        struct timespec inicio;
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        int na = buscarRotas(&rapida, o, d, k, NULL, via, a);
+        tRapida += segundosDesde(&inicio);
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        int nb = buscarRotas(&completa, o, d, k, NULL, via, b);
+        tCompleta += segundosDesde(&inicio);
+        int iguais = na == nb;
+        for (int i = 0; i < na && iguais; ++i) iguais = a[i].custo == b[i].custo;
+        concordam += iguais;
+        total += na;
+        for (int i = 0; i < na; ++i) liberarRota(&a[i]);
+        for (int i = 0; i < nb; ++i) liberarRota(&b[i]);
+    }
+    printf("%d salas, %d ligacoes: %d consultas de ate %d rotas (%d encontradas)\n",
+           nSalas, m.nArestas / 2, consultas, k, total);
+    printf("Yen com desvios novos e estado reaproveitado: %.2f ms/consulta, %.1f buscas\n",
+           tRapida * 1e3 / consultas, (double) rapida.nBuscas / consultas);
+    printf("Yen completo, vetores zerados a cada busca:    %.2f ms/consulta, %.1f buscas\n",
+           tCompleta * 1e3 / consultas, (double) completa.nBuscas / consultas);
+    printf("mesmos custos em %d de %d consultas\n", concordam, consultas);
+    liberarBuscaRotas(&rapida);
+    liberarBuscaRotas(&completa);
+    liberarMapaSalas(&m);
+    liberarSalas(raiz);
+}
+
+void listarCasos(const char *arquivo) {
+    Catalogo *cat = abrirCatalogo(arquivo, 0);
+    if (!cat) { fprintf(stderr, "Nao foi possivel ler %s.\n", arquivo); return; }
+    printf("Casos no catalogo: %d\n", cat->nCasos);
+    for (int i = 0; i < cat->nCasos; ++i) printf(" - %s\n", cat->casos[i].nome);
+    fecharCatalogo(cat);
+}
+
+typedef struct tarefaCatalogo {
+    Catalogo *catalogo;
+    long sessoes;
+    uint64_t semente;
+    long pistasAchadas, indisponiveis;
+} TarefaCatalogo;
+
+/* Sessão simulada: percorre um caminho aleatório e consulta o suspeito de cada pista */
+static void* jogarCasosSorteados(void *arg) {
+    TarefaCatalogo *t = (TarefaCatalogo*) arg;
+    Catalogo *cat = t->catalogo;
+    for (long i = 0; i < t->sessoes; ++i) {
+        double u = (double) (proximoAleatorio(&t->semente) >> 11) / 9007199254740992.0;
+        Caso *c = obterCaso(cat, cat->casos[(int) (u * u * cat->nCasos)].nome);
+        if (!c) { t->indisponiveis++; continue; }
+        uint64_t caminho = proximoAleatorio(&t->semente);
+        for (const Sala *s = c->raiz; s; caminho >>= 1) {
+            if (s->pista.tam != 0 && buscarEntradaTexto(&c->tabela, &s->pista)) t->pistasAchadas++;
+            s = (caminho & 1) ? s->direita : s->esquerda;
+        }
+        soltarCaso(cat, c);
+    }
+    return NULL;
+}
+
+void executarBenchCatalogo(const char *arquivo, long sessoes, size_t limiteBytes) {
+    Catalogo *cat = abrirCatalogo(arquivo, limiteBytes);
+    if (!cat || cat->nCasos == 0) {
+        fprintf(stderr, "Catalogo %s vazio ou ilegivel.\n", arquivo);
+        fecharCatalogo(cat);
+        return;
+    }
+    TarefaCatalogo tarefas[THREADS_CATALOGO];
+    pthread_t th[THREADS_CATALOGO];
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int criadas = 0;
+    for (int i = 0; i < THREADS_CATALOGO; ++i) {
+        tarefas[i] = (TarefaCatalogo) { cat, sessoes / THREADS_CATALOGO, 0x9E3779B97F4A7C15ull * (uint64_t) (i + 1), 0, 0 };
+        if (pthread_create(&th[criadas], NULL, jogarCasosSorteados, &tarefas[i]) == 0) criadas++;
+    }
+    for (int i = 0; i < criadas; ++i) pthread_join(th[i], NULL);
+    double t = segundosDesde(&inicio);
+    long achadas = 0, indisponiveis = 0;
+    for (int i = 0; i < criadas; ++i) { achadas += tarefas[i].pistasAchadas; indisponiveis += tarefas[i].indisponiveis; }
+    unsigned long long total = cat->acertos + cat->carregamentos;
+    printf("%d casos, %ld sessoes em %.3f s (%d threads), %ld pistas consultadas, %ld indisponiveis\n",
+           cat->nCasos, sessoes / THREADS_CATALOGO * criadas, t, criadas, achadas, indisponiveis);
+    printf("cache: %llu acertos (%.1f%%), %llu carregamentos, %llu descartes\n", cat->acertos,
+           total ? 100.0 * cat->acertos / total : 0.0, cat->carregamentos, cat->descartes);
+    printf("memoria dos casos: limite %zu kB, pico %zu kB, final %zu kB\n",
+           cat->limiteBytes / 1024, cat->picoBytes / 1024, cat->bytesCarregados / 1024);
+    fecharCatalogo(cat);
+}
+
+typedef struct tarefaWal {
+    Wal *wal;
+    long n;
+} TarefaWal;
+
+static void* gravarPistasWal(void *arg) {
+    TarefaWal *t = (TarefaWal*) arg;
+    for (long i = 0; i < t->n; ++i)
+        if (!confirmarWal(t->wal, anexarWal(t->wal, "Pegada suja"))) break;
+    return NULL;
+}
+
+void executarBenchWal(const char *arquivo, int nThreads, long n) {
+    if (nThreads < 1) nThreads = 1;
+    if (nThreads > MAX_THREADS_CONSULTA) nThreads = MAX_THREADS_CONSULTA;
+    Wal *w = abrirWal(arquivo);
+    if (!w) { fprintf(stderr, "Nao foi possivel abrir o WAL %s.\n", arquivo); return; }
+    pthread_t th[MAX_THREADS_CONSULTA];
+    TarefaWal tarefa = { w, n };
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    int criadas = 0;
+    while (criadas < nThreads && pthread_create(&th[criadas], NULL, gravarPistasWal, &tarefa) == 0) criadas++;
+    for (int i = 0; i < criadas; ++i) pthread_join(th[i], NULL);
+    double t = segundosDesde(&inicio);
+    printf("%d threads, %llu registros confirmados em %.3f s (%.0f/s)\n",
+           criadas, w->registros, t, t > 0 ? w->registros / t : 0.0);
+    printf("fdatasync: %llu (%.1f registros por sincronizacao)\n", w->sincronizacoes,
+           w->sincronizacoes ? (double) w->registros / w->sincronizacoes : 0.0);
+    fecharWal(w, 1);
+}
+
+/* executarCompressao() – comprime (ou descomprime) um arquivo no formato DQZ1.
+   Ao comprimir, confere a ida e volta e mede a descompressão repetindo-a por ~0,2 s.
+   Retorna 0 em erro.
+*/
+int executarCompressao(const char *origem, const char *destino, int descomprimir) {
+    size_t tam;
+    unsigned char *dados = lerArquivoInteiro(origem, &tam);
+    if (!dados) { fprintf(stderr, "Nao foi possivel ler %s.\n", origem); return 0; }
+    unsigned char *saida;
+    size_t tamSaida;
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    if (descomprimir) {
+        saida = descomprimirDados(dados, tam, &tamSaida);
+        if (!saida) { fprintf(stderr, "%s nao e um arquivo DQZ1 valido.\n", origem); free(dados); return 0; }
+    } else {
+        Buffer b = { NULL, 0, 0 };
+        comprimirDados(dados, tam, &b);
+        saida = b.d;
+        tamSaida = b.n;
+    }
+    double t = segundosDesde(&inicio);
+
+    FILE *f = fopen(destino, "wb");
+    int ok = f && fwrite(saida, 1, tamSaida, f) == tamSaida;
+    if (f) ok = (fclose(f) == 0) && ok;
+    if (!ok) fprintf(stderr, "Erro ao gravar %s.\n", destino);
+
+    if (ok && !descomprimir) {
+        double mb = tam / 1e6;
+        printf("%zu -> %zu bytes (%.1f%%), compressao %.0f MB/s\n",
+               tam, tamSaida, tam ? 100.0 * tamSaida / tam : 0.0, t > 0 ? mb / t : 0.0);
+        int rodadas = 0;
+        size_t tamVolta = 0;
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        do {
+            unsigned char *volta = descomprimirDados(saida, tamSaida, &tamVolta);
+            ok = volta && tamVolta == tam && memcmp(volta, dados, tam) == 0;
+            free(volta);
+            rodadas++;
+        } while (ok && segundosDesde(&inicio) < 0.2);
+        t = segundosDesde(&inicio);
+        if (ok) printf("descompressao %.0f MB/s (%d rodadas)\n", t > 0 ? mb * rodadas / t : 0.0, rodadas);
+        else fprintf(stderr, "Falha ao conferir a descompressao.\n");
+    }
+    free(dados);
+    free(saida);
+    return ok;
+}
+
+/* ---------------------------
+   Autoteste
+   --------------------------- */
+
+static int conferirAutoteste(int ok, const char *descricao, int *falhas) {
+    printf("%s %s\n", ok ? "ok   " : "FALHA", descricao);
+    if (!ok) (*falhas)++;
+    return ok;
+}
+
+/* A tabela tem exatamente as chaves "pista i" com suspeitoDe[i] >= 0 (suspeito "S<n>"),
+   o índice reverso aponta só para entradas vivas do próprio suspeito e o iterador
+   devolve as entradas em ordem de inserção */
+static int tabelaConfere(TabelaHash *t, const int *suspeitoDe, int n) {
+    char pista[32], suspeito[16];
+    size_t vivas = 0;
+    for (int i = 0; i < n; ++i) {
+        snprintf(pista, sizeof(pista), "pista %d", i);
+        const HashEntry *e = buscarEntrada(t, pista);
+        if (!e != (suspeitoDe[i] < 0)) return 0;
+        if (!e) continue;
+        snprintf(suspeito, sizeof(suspeito), "S%d", suspeitoDe[i]);
+        if (strcmp(textoStr(&e->suspeito), suspeito) != 0) return 0;
+        vivas++;
+    }
+    if (vivas != t->nEntradas) return 0;
+    size_t noReverso = 0;
+    for (int s = 0; s < t->nSuspeitos; ++s) {
+        const SuspeitoIndice *si = &t->suspeitos[s];
+        for (int k = 0; k < si->nPistas; ++k)
+            if (entradaEm(t, (size_t) si->pistas[k])->idSuspeito != s) return 0;
+        noReverso += (size_t) si->nPistas;
+    }
+    if (noReverso != vivas) return 0;
+    IteradorTabela it;
+    iniciarIterador(&it, t);
+    int ultimoId = -1;
+    size_t percorridas = 0;
+    for (const HashEntry *e; (e = proximaEntrada(&it)); ++percorridas) {
+        if (e->id <= ultimoId) return 0;
+        ultimoId = e->id;
+    }
+    return percorridas == vivas;
+}
+
+static void autotesteTabela(int *falhas) {
+    enum { N = 6000 };
+    static int suspeitoDe[N];
+    char pista[32], suspeito[16];
+    uint64_t semente = 42;
+    TabelaHash t;
+    inicializarTabelaHash(&t);
+    int n = 0;
+    /* até começar um crescimento com alguns milhares de entradas */
+    while (n < 2000 || !t.antigo.slots) {
+        snprintf(pista, sizeof(pista), "pista %d", n);
+        snprintf(suspeito, sizeof(suspeito), "S%d", n % 7);
+        inserirNaHash(&t, pista, suspeito);
+        suspeitoDe[n] = n % 7;
+        n++;
+    }
+    /* inserções, remoções e trocas de suspeito com a migração em andamento */
+    for (int op = 0; op < 300 && n < N; ++op) {
+        int i = (int) (proximoAleatorio(&semente) % (uint64_t) n);
+        snprintf(pista, sizeof(pista), "pista %d", i);
+        switch (op % 3) {
+        case 0:
+            snprintf(pista, sizeof(pista), "pista %d", n);
+            snprintf(suspeito, sizeof(suspeito), "S%d", n % 7);
+            inserirNaHash(&t, pista, suspeito);
+            suspeitoDe[n] = n % 7;
+            n++;
+            break;
+        case 1:
+            if (removerDaHash(&t, pista) != (suspeitoDe[i] >= 0)) (*falhas)++;
+            suspeitoDe[i] = -1;
+            break;
+        default:
+            snprintf(suspeito, sizeof(suspeito), "S%d", 7 + i % 3);
+            inserirNaHash(&t, pista, suspeito);
+            suspeitoDe[i] = 7 + i % 3;
+        }
+    }
+    conferirAutoteste(t.antigo.slots != NULL, "tabela: migracao ainda em andamento", falhas);
+    conferirAutoteste(tabelaConfere(&t, suspeitoDe, n), "tabela: insercao, remocao e busca durante a migracao", falhas);
+    concluirMigracao(&t);
+    conferirAutoteste(tabelaConfere(&t, suspeitoDe, n), "tabela: migracao concluida", falhas);
+
+    /* remover 3/4 das vivas deixa mais buracos que entradas: compacta no mesmo tamanho */
+    size_t slots = t.indice.nSlots, usadas = t.nUsadas;
+    for (int i = 0; i < n; ++i) {
+        if (suspeitoDe[i] < 0 || i % 4 == 0) continue;
+        snprintf(pista, sizeof(pista), "pista %d", i);
+        removerDaHash(&t, pista);
+        suspeitoDe[i] = -1;
+    }
+    concluirMigracao(&t);
+    conferirAutoteste(t.indice.nSlots == slots && t.nUsadas < usadas && t.nUsadas < 2 * t.nEntradas,
+                      "tabela: buracos compactados sem crescer o indice", falhas);
+    conferirAutoteste(tabelaConfere(&t, suspeitoDe, n), "tabela: conteudo apos a compactacao", falhas);
+    liberarTabelaHash(&t);
+}
+
+/* mesmas sessões, comparadas pelos nomes (os ids dependem da ordem dos dicionários) */
+static int sessoesIguais(const TabelaSessoes *a, const TabelaSessoes *b) {
+    if (a->nSessoes != b->nSessoes) return 0;
+    for (int s = 0; s < a->nSessoes; ++s) {
+        if (a->veredicto[s] != b->veredicto[s] || (a->acusado[s] < 0) != (b->acusado[s] < 0)) return 0;
+        if (a->acusado[s] >= 0 && strcmp(a->dicSuspeitos.nomes[a->acusado[s]], b->dicSuspeitos.nomes[b->acusado[s]]) != 0)
+            return 0;
+        uint32_t na = a->inicioCaminho[s + 1] - a->inicioCaminho[s], nb = b->inicioCaminho[s + 1] - b->inicioCaminho[s];
+        if (na != nb) return 0;
+        for (uint32_t k = 0; k < na; ++k)
+            if (strcmp(a->dicSalas.nomes[a->caminho[a->inicioCaminho[s] + k]],
+                       b->dicSalas.nomes[b->caminho[b->inicioCaminho[s] + k]]) != 0) return 0;
+        na = a->inicioPistas[s + 1] - a->inicioPistas[s];
+        nb = b->inicioPistas[s + 1] - b->inicioPistas[s];
+        if (na != nb) return 0;
+        for (uint32_t k = 0; k < na; ++k)
+            if (strcmp(a->dicPistas.nomes[a->pistas[a->inicioPistas[s] + k]],
+                       b->dicPistas.nomes[b->pistas[b->inicioPistas[s] + k]]) != 0) return 0;
+    }
+    return 1;
+}
+
+/* o arquivo tem exatamente as sessões de 'esperado'? */
+static int arquivoTemSessoes(const char *arquivo, const TabelaSessoes *esperado) {
+    TabelaSessoes lida;
+    if (!carregarSessoes(&lida, arquivo)) return 0;
+    int ok = sessoesIguais(esperado, &lida);
+    liberarTabelaSessoes(&lida);
+    return ok;
+}
+
+static int gravarArquivo(const char *arquivo, const unsigned char *d, size_t n) {
+    FILE *f = fopen(arquivo, "wb");
+    int ok = f && (n == 0 || fwrite(d, 1, n, f) == n);
+    if (f) ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+static void autotesteSessoes(const char *arquivo, const char *cru, int *falhas) {
+    static const char *caminhos[3][3] = {
+        { "Hall", "Cozinha", "Porao" }, { "Hall", "Jardim", NULL }, { "Hall", NULL, NULL } };
+    static const char *coletas[3][2] = { { "faca", "luva" }, { "copo", NULL }, { NULL, NULL } };
+    RegistroSessao r[3];
+    for (int i = 0; i < 3; ++i) {
+        memset(&r[i], 0, sizeof(r[i]));
+        r[i].salas = caminhos[i];
+        r[i].nSalas = 3 - i;
+        r[i].pistas = coletas[i];
+        r[i].nPistas = 2 - i;
+        r[i].veredicto = i == 2 ? VEREDICTO_SEM_ACUSACAO : VEREDICTO_CULPADO;
+        if (i < 2) snprintf(r[i].acusado, MAX_NOME, "%s", i == 0 ? "Ana" : "Bruno");
+    }
+    TabelaSessoes ts;
+    memset(&ts, 0, sizeof(ts));
+    for (int i = 0; i < 3; ++i) anexarSessao(&ts, &r[i]);
+    conferirAutoteste(salvarSessoes(&ts, arquivo) && arquivoTemSessoes(arquivo, &ts),
+                      "sessoes: DQS2 gravado e lido de volta", falhas);
+
+    /* nomes já conhecidos: vira um lote no fim, sem regravar o começo do arquivo */
+    size_t tamAntes, tamDepois;
+    unsigned char *antes = lerArquivoInteiro(arquivo, &tamAntes);
+    anexarSessao(&ts, &r[1]);
+    int ok = acrescentarSessao(arquivo, &r[1]) == 1;
+    unsigned char *depois = lerArquivoInteiro(arquivo, &tamDepois);
+    ok = ok && antes && depois && tamDepois > tamAntes && memcmp(antes, depois, tamAntes) == 0;
+    conferirAutoteste(ok && arquivoTemSessoes(arquivo, &ts), "sessoes: lote acrescentado ao DQZ1 sem regravar", falhas);
+    free(depois);
+
+    /* o mesmo sobre o DQS2 sem compressão */
+    size_t tamCru;
+    unsigned char *dqs2 = antes ? descomprimirDados(antes, tamAntes, &tamCru) : NULL;
+    ok = dqs2 && gravarArquivo(cru, dqs2, tamCru) && acrescentarSessao(cru, &r[1]) == 1;
+    conferirAutoteste(ok && arquivoTemSessoes(cru, &ts), "sessoes: lote acrescentado ao DQS2 cru", falhas);
+    free(dqs2);
+    free(antes);
+
+    /* sala nova: os dicionários mudam e o arquivo é regravado */
+    RegistroSessao novo = r[0];
+    const char *outroCaminho[2] = { "Hall", "Sotao" };
+    novo.salas = outroCaminho;
+    novo.nSalas = 2;
+    anexarSessao(&ts, &novo);
+    conferirAutoteste(acrescentarSessao(arquivo, &novo) == 1 && arquivoTemSessoes(arquivo, &ts),
+                      "sessoes: nome novo regrava o arquivo", falhas);
+    liberarTabelaSessoes(&ts);
+
+    /* arquivo vazio: não é um arquivo de sessões, mas recebe a primeira */
+    TabelaSessoes vazia;
+    ok = gravarArquivo(arquivo, NULL, 0) && !carregarSessoes(&vazia, arquivo);
+    conferirAutoteste(ok, "sessoes: arquivo vazio rejeitado na leitura", falhas);
+    memset(&ts, 0, sizeof(ts));
+    anexarSessao(&ts, &r[2]);
+    conferirAutoteste(acrescentarSessao(arquivo, &r[2]) == 1 && arquivoTemSessoes(arquivo, &ts),
+                      "sessoes: primeira sessao num arquivo vazio", falhas);
+    liberarTabelaSessoes(&ts);
+}
+
+static void autotesteCompressao(const char *arquivo, int *falhas) {
+    size_t tams[4] = { 0, 1, 3 * LZ_BLOCO + 17, 100000 };
+    uint64_t semente = 7;
+    int ok = 1;
+    for (int c = 0; c < 4; ++c) {
+        unsigned char *dados = (unsigned char*) malloc(tams[c] + 1);
+        if (!dados) { fprintf(stderr, "Erro de alocacao autoteste.\n"); exit(EXIT_FAILURE); }
+        for (size_t i = 0; i < tams[c]; ++i) /* repetitivo nos blocos grandes, aleatório no último */
+            dados[i] = c == 3 ? (unsigned char) proximoAleatorio(&semente) : (unsigned char) "detective "[i % 10];
+        Buffer z = { NULL, 0, 0 };
+        comprimirDados(dados, tams[c], &z);
+        size_t tam = 0;
+        unsigned char *volta = descomprimirDados(z.d, z.n, &tam);
+        ok = ok && volta && tam == tams[c] && (tam == 0 || memcmp(volta, dados, tam) == 0);
+        free(volta);
+        free(z.d);
+        free(dados);
+    }
+    conferirAutoteste(ok, "DQZ1: ida e volta (vazio, 1 byte, varios blocos, incompressivel)", falhas);
+
+    /* leitura em fluxo de um contêiner sem blocos e de um arquivo vazio */
+    Fluxo fx;
+    ok = gravarArquivo(arquivo, (const unsigned char*) LZ_MAGICO, 4) && abrirFluxo(&fx, arquivo);
+    if (ok) {
+        ok = fx.comprimido && encherFluxo(&fx, 1) == 0 && !fx.erro;
+        fecharFluxo(&fx);
+    }
+    int okVazio = gravarArquivo(arquivo, NULL, 0) && abrirFluxo(&fx, arquivo);
+    if (okVazio) {
+        okVazio = !fx.comprimido && encherFluxo(&fx, 1) == 0 && !fx.erro;
+        fecharFluxo(&fx);
+    }
+    conferirAutoteste(ok && okVazio, "DQZ1: fluxo sobre contêiner sem blocos e arquivo vazio", falhas);
+}
+
+/* executarAutoteste() – confere a tabela hash (migração e compactação), o arquivo de
+   sessões (DQS2: gravação, lote acrescentado, arquivo vazio) e o contêiner DQZ1.
+   Os arquivos temporários ficam em $TMPDIR (ou /tmp). Retorna 1 se tudo passou. */
+int executarAutoteste(void) {
+    const char *dir = getenv("TMPDIR");
+    char arquivo[512], cru[512];
+    snprintf(arquivo, sizeof(arquivo), "%s/detective-autoteste-%d.dqs", dir && *dir ? dir : "/tmp", (int) getpid());
+    snprintf(cru, sizeof(cru), "%s/detective-autoteste-%d-cru.dqs", dir && *dir ? dir : "/tmp", (int) getpid());
+    int falhas = 0;
+    autotesteTabela(&falhas);
+    autotesteSessoes(arquivo, cru, &falhas);
+    autotesteCompressao(arquivo, &falhas);
+    remove(arquivo);
+    remove(cru);
+    if (falhas) printf("%d verificacao(oes) falharam.\n", falhas);
+    else printf("Todas as verificacoes passaram.\n");
+    return falhas == 0;
 }
 
 /* ---------------------------
    MAIN: monta mapa, tabela hash e executa jogo
    --------------------------- */
-int main(void) {
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--paginas-grandes") == 0) usarPaginasGrandes(1);
+
     /* Montagem do mapa (árvore binária de salas) - fixo */
     Sala *hall = criarSala("Hall de Entrada", "Pegada suja");
     Sala *estar = criarSala("Sala de Estar", "Perfume feminino caro");
@@ -314,32 +7397,286 @@ int main(void) {
     biblioteca->direita = porao;
 
     /* Preparar tabela hash (inicializa com NULL) */
-    HashEntry *tabela[HASH_SIZE];
-    for (int i = 0; i < HASH_SIZE; ++i) tabela[i] = NULL;
+    TabelaHash tabela;
+    inicializarTabelaHash(&tabela);
 
     /* Inserir associações pista -> suspeito (pré-definido) */
-    inserirNaHash(tabela, "Pegada suja", "Carlos");
-    inserirNaHash(tabela, "Perfume feminino caro", "Dona Beatriz");
-    inserirNaHash(tabela, "Livro rasgado", "Professor Otávio");
-    inserirNaHash(tabela, "Copo com fragmento de esmalte", "Dona Beatriz");
-    inserirNaHash(tabela, "Filtro de cigarro", "Carlos");
-    inserirNaHash(tabela, "Luva encharcada", "Professor Otávio");
+    inserirNaHash(&tabela, "Pegada suja", "Carlos");
+    inserirNaHash(&tabela, "Perfume feminino caro", "Dona Beatriz");
+    inserirNaHash(&tabela, "Livro rasgado", "Professor Otávio");
+    inserirNaHash(&tabela, "Copo com fragmento de esmalte", "Dona Beatriz");
+    inserirNaHash(&tabela, "Filtro de cigarro", "Carlos");
+    inserirNaHash(&tabela, "Luva encharcada", "Professor Otávio");
+
+    /* índice reverso: salas onde cada pista aparece */
+    vincularSalas(&tabela, hall);
+    montarTrigramasDaTabela(&tabela);
+    int nSalas = numerarSalas(hall);
+
+    /* um caso do catálogo substitui a mansão fixa */
+    const char *arqCatalogo = NULL, *nomeCaso = NULL;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--catalogo") == 0) arqCatalogo = argv[i+1];
+        else if (strcmp(argv[i], "--caso") == 0) nomeCaso = argv[i+1];
+    }
+    Sala *mapa = hall;
+    TabelaHash *tab = &tabela;
+    Catalogo *catalogo = NULL;
+    Caso *caso = NULL;
+    if (arqCatalogo && nomeCaso) {
+        if (!(catalogo = abrirCatalogo(arqCatalogo, SIZE_MAX))) {
+            fprintf(stderr, "Nao foi possivel ler %s.\n", arqCatalogo);
+            exit(EXIT_FAILURE);
+        }
+        if (!(caso = obterCaso(catalogo, nomeCaso))) {
+            fprintf(stderr, "Caso %s indisponivel em %s.\n", nomeCaso, arqCatalogo);
+            exit(EXIT_FAILURE);
+        }
+        mapa = caso->raiz;
+        tab = &caso->tabela;
+        nSalas = caso->nSalas;
+    }
+
+    /* fatos do caso; a mansão fixa não tem nenhum e decide só pela contagem de pistas */
+    BaseFatos fatosMansao;
+    iniciarBaseFatos(&fatosMansao);
+    for (int i = 0; i < tabela.nSuspeitos; ++i) registrarSuspeitoFato(&fatosMansao, tabela.suspeitos[i].nome);
+    const BaseFatos *fatos = caso ? &caso->fatos : &fatosMansao;
 
     /* Árvore BST de pistas coletadas (inicialmente vazia) */
     PistaNode *raizPistas = NULL;
 
-    printf("=== Detective Quest: Investigacao Final ===\n");
-    printf("Explore a mansão e colete pistas. Quando terminar, acuse o suspeito.\n");
+    /* opções da sessão de jogo */
+    const char *arqEstatisticas = NULL, *arqMapaCalor = NULL, *arqSessoes = NULL, *arqDiario = NULL;
+    const char *arqWal = NULL, *arqCasos = NULL, *jogador = "anonimo";
+    for (int i = 1; i + 1 < argc; ++i)
+        if (strcmp(argv[i], "--retirar") == 0 && !retirarPista(tab, mapa, &raizPistas, argv[i+1]))
+            fprintf(stderr, "Pista desconhecida: %s\n", argv[i+1]);
+    for (int i = 1; i < argc; ++i)
+        if (strcmp(argv[i], "--replicar-numa") == 0)
+            printf("Replicas NUMA da tabela: %d\n", replicarTabelaPorNo(tab));
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--estatisticas") == 0) arqEstatisticas = argv[i+1];
+        else if (strcmp(argv[i], "--mapa-calor") == 0) arqMapaCalor = argv[i+1];
+        else if (strcmp(argv[i], "--exportar-sessao") == 0) arqSessoes = argv[i+1];
+        else if (strcmp(argv[i], "--diario") == 0) arqDiario = argv[i+1];
+        else if (strcmp(argv[i], "--wal") == 0) arqWal = argv[i+1];
+        else if (strcmp(argv[i], "--arquivo-casos") == 0) arqCasos = argv[i+1];
+        else if (strcmp(argv[i], "--jogador") == 0) jogador = argv[i+1];
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--autoteste") == 0) {
+        if (!executarAutoteste()) exit(EXIT_FAILURE);
+    } else if (argc >= 3 && strcmp(argv[1], "--bench-paginas") == 0) {
+        executarBenchPaginas(atol(argv[2]));
+    } else if (argc >= 4 && (strcmp(argv[1], "--comprimir") == 0 || strcmp(argv[1], "--descomprimir") == 0)) {
+        executarCompressao(argv[2], argv[3], strcmp(argv[1], "--descomprimir") == 0);
+    } else if (argc >= 5 && strcmp(argv[1], "--bench-wal") == 0) {
+        executarBenchWal(argv[2], atoi(argv[3]), atol(argv[4]));
+    } else if (argc >= 3 && strcmp(argv[1], "--historico") == 0) {
+        ArquivoCasos *arq = abrirArquivoCasos(argv[2], QUADROS_ARQUIVO, 0);
+        if (arq) {
+            listarHistorico(arq, argc >= 4 && argv[3][0] != '-' ? argv[3] : NULL);
+            fecharArquivoCasos(arq);
+        } else {
+            fprintf(stderr, "Nao foi possivel ler %s.\n", argv[2]);
+        }
+    } else if (argc >= 4 && strcmp(argv[1], "--indexar-catalogo") == 0) {
+        Catalogo *cat = abrirCatalogo(argv[2], (size_t) 64 << 20);
+        if (!cat) fprintf(stderr, "Nao foi possivel ler %s.\n", argv[2]);
+        else if (!construirIndiceGlobal(cat, argv[3])) fprintf(stderr, "Erro ao gravar %s.\n", argv[3]);
+        else printf("Indice de %d casos gravado em %s.\n", cat->nCasos, argv[3]);
+        fecharCatalogo(cat);
+    } else if (argc >= 4 && strcmp(argv[1], "--onde-aparece") == 0) {
+        executarOndeAparece(argv[2], argv[3]);
+    } else if (argc >= 3 && strcmp(argv[1], "--dica") == 0) {
+        executarDica(tab, argv[2], argc >= 4 && argv[3][0] != '-' ? atoi(argv[3]) : -1);
+    } else if (argc >= 3 && strcmp(argv[1], "--bench-dica") == 0) {
+        executarBenchDica(atoi(argv[2]));
+    } else if (argc >= 3 && strcmp(argv[1], "--deduzir") == 0) {
+        executarDeducao(fatos, argv[2]);
+    } else if (argc >= 3 && strcmp(argv[1], "--bench-deducao") == 0) {
+        executarBenchDeducao(atoi(argv[2]));
+    } else if (argc >= 2 && strcmp(argv[1], "--grafo") == 0) {
+        GrafoEvidencias g;
+        AnaliseGrafo a;
+        montarGrafoDoCaso(&g, tab, fatos);
+        analisarGrafo(&g, &a, 0);
+        exibirAnaliseGrafo(&g, &a);
+        liberarAnaliseGrafo(&a);
+        liberarGrafo(&g);
+    } else if (argc >= 3 && strcmp(argv[1], "--bench-grafo") == 0) {
+        executarBenchGrafo(atol(argv[2]), argc >= 4 && argv[3][0] != '-' ? atoi(argv[3]) : 4);
+    } else if (argc >= 3 && strcmp(argv[1], "--proximas") == 0) {
+        executarProximas(mapa, nSalas, tab, argv[2]);
+    } else if (argc >= 3 && strcmp(argv[1], "--bench-proximas") == 0) {
+        executarBenchProximas(atol(argv[2]));
+    } else if (argc >= 4 && strcmp(argv[1], "--rotas") == 0) {
+        const char *evitar[MAX_ROTAS * 4];
+        int nEvitar = 0, exigirPista = 0;
+        for (int i = 4; i < argc; ++i) {
+            if (strcmp(argv[i], "--via-pista") == 0) exigirPista = 1;
+            else if (strcmp(argv[i], "--evitar") == 0 && i + 1 < argc) {
+                if (nEvitar == MAX_ROTAS * 4) {
+                    fprintf(stderr, "Erro: no maximo %d salas em --evitar.\n", MAX_ROTAS * 4);
+                    exit(EXIT_FAILURE);
+                }
+                evitar[nEvitar++] = argv[++i];
+            }
+        }
+        MapaSalas m;
+        montarMapaSalas(&m, mapa, nSalas, caso ? caso->passagens : NULL, caso ? caso->nPassagens : 0);
+        executarRotas(&m, argv[2], argv[3], argc >= 5 && argv[4][0] != '-' ? atoi(argv[4]) : 3,
+                      evitar, nEvitar, exigirPista);
+        liberarMapaSalas(&m);
+    } else if (argc >= 3 && strcmp(argv[1], "--bench-rotas") == 0) {
+        executarBenchRotas(atol(argv[2]), argc >= 4 && argv[3][0] != '-' ? atoi(argv[3]) : 4);
+    } else if (argc >= 3 && strcmp(argv[1], "--casos") == 0) {
+        listarCasos(argv[2]);
+    } else if (argc >= 5 && strcmp(argv[1], "--bench-catalogo") == 0) {
+        executarBenchCatalogo(argv[2], atol(argv[3]), (size_t) atol(argv[4]) * 1024);
+    } else if (argc >= 4 && strcmp(argv[1], "--prefork") == 0) {
+        int n = atoi(argv[2]);
+        printf("Processos concluidos: %d de %d\n", executarPrefork(mapa, tab, n, argv[3]), n);
+    } else if (argc >= 3 && strcmp(argv[1], "--buscar") == 0) {
+        executarBusca(tab, argv[2]);
+    } else if (argc >= 3 && strcmp(argv[1], "--evidencias") == 0) {
+        listarEvidencias(tab, argv[2]);
+    } else if (argc >= 3 && strcmp(argv[1], "--populares") == 0) {
+        Estatisticas *est = criarEstatisticas();
+        if (carregarEstatisticas(est, argv[2])) exibirPopulares(est, mapa, tab);
+        else fprintf(stderr, "Nao foi possivel ler %s.\n", argv[2]);
+        free(est);
+    } else if (argc >= 3 && strcmp(argv[1], "--analisar-sessoes") == 0) {
+        TabelaSessoes ts;
+        if (carregarSessoes(&ts, argv[2])) {
+            analisarSessoes(&ts);
+            liberarTabelaSessoes(&ts);
+        } else {
+            fprintf(stderr, "Nao foi possivel ler %s.\n", argv[2]);
+        }
+    } else if (argc >= 3 && strcmp(argv[1], "--consultar") == 0) {
+        ConsultaSessoes c = { NULL, NULL, NULL, NULL, -1, AGRUPAR_NADA };
+        int valida = 1;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            const char *op = argv[i], *val = argv[i+1];
+            if (strcmp(op, "--coletou") == 0) c.coletou = val;
+            else if (strcmp(op, "--contra") == 0) c.contra = val;
+            else if (strcmp(op, "--acusou") == 0) c.acusou = val;
+            else if (strcmp(op, "--visitou") == 0) c.visitou = val;
+            else if (strcmp(op, "--veredicto") == 0) {
+                if (strcmp(val, "culpado") == 0) c.veredicto = VEREDICTO_CULPADO;
+                else if (strcmp(val, "insuficiente") == 0) c.veredicto = VEREDICTO_INSUFICIENTE;
+                else if (strcmp(val, "sem") == 0) c.veredicto = VEREDICTO_SEM_ACUSACAO;
+                else { fprintf(stderr, "Veredicto desconhecido: %s\n", val); valida = 0; }
+            } else if (strcmp(op, "--agrupar") == 0) {
+                if (strcmp(val, "suspeito") == 0) c.agrupar = AGRUPAR_SUSPEITO;
+                else if (strcmp(val, "sala") == 0) c.agrupar = AGRUPAR_SALA;
+                else { fprintf(stderr, "Agrupamento desconhecido: %s\n", val); valida = 0; }
+            } else {
+                fprintf(stderr, "Opcao desconhecida: %s\n", op);
+                valida = 0;
+            }
+        }
+        if (valida && executarConsulta(argv[2], &c, tab) < 0)
+            fprintf(stderr, "Nao foi possivel ler %s.\n", argv[2]);
+    } else if (argc >= 4 && strcmp(argv[1], "--mesclar-estatisticas") == 0) {
+        /* acumula os arquivos de outros processos no destino (argv[2]) */
+        Estatisticas *dest = criarEstatisticas();
+        Estatisticas *orig = criarEstatisticas();
+        carregarEstatisticas(dest, argv[2]);
+        for (int i = 3; i < argc; ++i) {
+            if (!carregarEstatisticas(orig, argv[i])) {
+                fprintf(stderr, "Ignorando %s (arquivo invalido).\n", argv[i]);
+                continue;
+            }
+            mesclarEsbocos(&dest->visitasSalas, &orig->visitasSalas);
+            mesclarEsbocos(&dest->coletasPistas, &orig->coletasPistas);
+        }
+        if (!salvarEstatisticas(dest, argv[2])) fprintf(stderr, "Erro ao gravar %s.\n", argv[2]);
+        free(dest); free(orig);
+    } else {
+        ContextoSessao ctx = { tab, NULL, NULL, NULL, NULL, NULL, fatos, NULL };
+        RegistroSessao registro;
+        memset(&registro, 0, sizeof(registro));
+        registro.veredicto = VEREDICTO_SEM_ACUSACAO;
+        if (arqEstatisticas) ctx.estatisticas = criarEstatisticas();
+        if (arqMapaCalor) ctx.mapaCalor = criarMapaCalor(nSalas, tab->proximoId, 1000);
+        if (arqSessoes) ctx.registro = &registro;
+        if (arqDiario && !(ctx.diario = abrirDiario(arqDiario)))
+            fprintf(stderr, "Nao foi possivel abrir o diario %s.\n", arqDiario);
+        if (arqWal) {
+            int recuperadas = reaplicarWal(arqWal, tab, &raizPistas);
+            if (recuperadas > 0) printf("Pistas recuperadas da sessao interrompida: %d\n", recuperadas);
+            if (!(ctx.wal = abrirWal(arqWal))) fprintf(stderr, "Nao foi possivel abrir o WAL %s.\n", arqWal);
+        }
+
+        TabelaDistancias distancias;
+        construirDistancias(&distancias, mapa, nSalas, tab);
+        ctx.distancias = &distancias;
 
-    explorarSalas(hall, &raizPistas);
+        printf("=== Detective Quest: Investigacao Final ===\n");
+        printf("Explore a mansão e colete pistas. Quando terminar, acuse o suspeito.\n");
 
-    verificarSuspeitoFinal(raizPistas, tabela);
+        explorarSalas(mapa, &raizPistas, &ctx);
+
+        verificarSuspeitoFinal(raizPistas, tab, &ctx);
+        fecharDiario(ctx.diario);
+        if (arqCasos) {
+            ArquivoCasos *arq = abrirArquivoCasos(arqCasos, QUADROS_ARQUIVO, 1);
+            if (!arq) fprintf(stderr, "Nao foi possivel abrir o arquivo de casos %s.\n", arqCasos);
+            else {
+                arquivarPistasColetadas(arq, jogador, raizPistas);
+                if (!fecharArquivoCasos(arq)) fprintf(stderr, "Erro ao gravar %s.\n", arqCasos);
+            }
+        }
+        /* só depois de arquivadas as pistas a sessão deixa de precisar do WAL */
+        fecharWal(ctx.wal, 1);
+        liberarDistancias(&distancias);
+
+        if (ctx.estatisticas) {
+            /* soma esta sessão ao histórico gravado */
+            Estatisticas *anteriores = criarEstatisticas();
+            if (carregarEstatisticas(anteriores, arqEstatisticas)) {
+                mesclarEsbocos(&ctx.estatisticas->visitasSalas, &anteriores->visitasSalas);
+                mesclarEsbocos(&ctx.estatisticas->coletasPistas, &anteriores->coletasPistas);
+            }
+            if (!salvarEstatisticas(ctx.estatisticas, arqEstatisticas))
+                fprintf(stderr, "Erro ao gravar %s.\n", arqEstatisticas);
+            free(anteriores);
+            free(ctx.estatisticas);
+        }
+        if (ctx.mapaCalor) {
+            mesclarMapaCalor(ctx.mapaCalor);
+            if (!exportarMapaCalor(ctx.mapaCalor, arqMapaCalor, mapa, tab))
+                fprintf(stderr, "Erro ao gravar %s.\n", arqMapaCalor);
+            liberarMapaCalor(ctx.mapaCalor);
+        }
+        if (ctx.registro) {
+            /* acrescenta a sessão às já gravadas (arquivo novo se ainda não existir) */
+            int r = acrescentarSessao(arqSessoes, &registro);
+            liberarRegistroSessao(&registro);
+            /* um arquivo corrompido não é regravado: apagaria as sessões dele */
+            if (r < 0) {
+                fprintf(stderr, "Erro: %s ilegivel ou corrompido; a sessao nao foi gravada.\n", arqSessoes);
+                exit(EXIT_FAILURE);
+            }
+            if (r == 0) fprintf(stderr, "Erro ao gravar %s.\n", arqSessoes);
+        }
+
+        printf("\nObrigado por jogar Detective Quest!\n");
+    }
 
     /* liberar memória */
     liberarPistas(raizPistas);
-    liberarTabelaHash(tabela);
-    free(hall); free(estar); free(biblioteca); free(cozinha); free(jardim); free(porao);
+    soltarCaso(catalogo, caso);
+    fecharCatalogo(catalogo);
+    liberarBaseFatos(&fatosMansao);
+    liberarTabelaHash(&tabela);
+    liberarSalas(hall);
+    liberarPool(&poolSalas);
+    liberarPool(&poolPistas);
+    liberarArena(&arenaJogo);
 
-    printf("\nObrigado por jogar Detective Quest!\n");
     return 0;
 }